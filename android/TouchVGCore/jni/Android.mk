@@ -39,6 +39,7 @@ geom_files := $(core_src)/geom/mgbase.cpp \
 
 graph_files := $(core_src)/graph/gigraph.cpp \
               $(core_src)/graph/gipath.cpp \
+              $(core_src)/graph/githread.cpp \
               $(core_src)/graph/gixform.cpp
 
 json_files := $(core_src)/jsonstorage/mgjsonstorage.cpp
@@ -54,6 +55,8 @@ shape_files := $(core_src)/shape/mgcomposite.cpp \
               $(core_src)/shape/mgshapes.cpp \
               $(core_src)/shape/mgsplines.cpp \
               $(core_src)/shape/mgpathsp.cpp \
+              $(core_src)/shape/mgsymbol.cpp \
+              $(core_src)/shape/mgpool.cpp \
               $(core_src)/shape/nanosvg.cpp \
               $(core_src)/shape/mgbasicspreg.cpp
 
@@ -62,6 +65,7 @@ doc_files  := $(core_src)/shapedoc/mgshapedoc.cpp \
               $(core_src)/shapedoc/spfactoryimpl.cpp
 
 test_files := $(core_src)/test/testcanvas.cpp \
+              $(core_src)/test/testconcurrent.cpp \
               $(core_src)/test/RandomShape.cpp
 
 base_files := $(core_src)/cmdbase/mgcmddraw.cpp \
@@ -95,8 +99,10 @@ view_files := $(core_src)/view/GcGraphView.cpp \
               $(core_src)/view/GcShapeDoc.cpp \
               $(core_src)/view/gicoreview.cpp \
               $(core_src)/view/gicorerecord.cpp \
+              $(core_src)/view/gibatchrender.cpp \
               $(core_src)/export/svgcanvas.cpp \
               $(core_src)/export/girecordcanvas.cpp \
+              $(core_src)/export/girastercanvas.cpp \
               $(core_src)/record/recordshapes.cpp
 
 include $(CLEAR_VARS)
@@ -137,6 +137,22 @@ public:
     virtual void clearCachedBitmap(bool clearAll = false) {}
 #endif
 
+    //! Redirect the following drawing to an offscreen raster of the layer.
+    /*! The raster is as large as the view (w x h points) and is cleared to transparent.
+        \param layer Layer index, which identifies the raster.
+        \return false if offscreen layer rasters are not supported, then shapes are drawn directly.
+     */
+    virtual bool beginLayerCache(int layer, float w, float h) { return false; }
+    
+    //! Stop drawing to the layer raster and restore the original drawing target.
+    virtual void endLayerCache(int layer) {}
+    
+    //! Draw the cached raster of the layer, scaled and then translated.
+    /*! A point (x, y) of the raster is displayed at (x * scale + dx, y * scale + dy).
+        \return false if the raster does not exist.
+     */
+    virtual bool drawCachedLayer(int layer, float scale, float dx, float dy) { return false; }
+    
     //! Ready to draw a shape.
     virtual bool beginShape(int type, int sid, int version,
                             float x, float y, float w, float h) { return true; }
@@ -34,6 +34,14 @@ public:
     virtual bool gatherShapes(const MgMotion* sender, MgShapes* shapes) { //!< 得到动态图形
         return !sender && !shapes; }    // 实现且图完整则返回true，否则将用 draw() 生成临时图形
     
+    //! 得到自上次调用后新增的笔迹，用于徒手绘图时增量显示
+    /*! \param newInk 添加新增的已稳定的笔迹图形，由视图保留显示，不再重新提交
+        \param shapes 添加未稳定的尾部和预测段等临时图形，每帧重新提交
+        \return 0 表示不使用增量笔迹，此时用 gatherShapes 或 draw 生成全部动态图形；
+            1 表示新增笔迹接在已显示的笔迹后；2 表示先清除已显示的笔迹再重新开始
+     */
+    virtual int gatherInk(const MgMotion* sender, MgShapes* newInk, MgShapes* shapes) { return 0; }
+    
     virtual bool click(const MgMotion* sender) {    //!< 点击
         return sender->view->useFinger() && longPress(sender); }
     virtual bool doubleClick(const MgMotion* sender) { return !sender; } //!< 双击
@@ -46,6 +54,7 @@ public:
     
     virtual bool isDrawingCommand() { return false; }       //!< 是否为绘图命令
     virtual bool isFloatingCommand() { return false; }      //!< 是否可嵌套在其他命令中
+    virtual bool isStrokeCommand() { return false; }        //!< 是否逐点记录笔迹，需要合并前的全部移动点
     virtual bool doContextAction(const MgMotion* sender, int action) {
         return !sender && !action; }                        //!< 执行上下文动作
     
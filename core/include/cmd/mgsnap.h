@@ -57,6 +57,19 @@ struct MgSnap {
     
     //! 得到捕捉到的图形、控制点序号、源图形上匹配的控制点序号
     virtual bool getSnappedHandle(int& shapeid, int& handleIndex, int& handleIndexSrc) = 0;
+    
+    //! 得到框选矩形内的图形，按显示次序排列
+    /*! 与捕捉共用当前图层的空间索引。连续拖动框选矩形时由上次结果增量更新，
+        只对范围跨越新旧矩形之差的图形做精确检查。
+        \param sender 当前操作的视图，在其当前图形列表中查找
+        \param box 框选矩形，模型坐标
+        \param intersect 为true时取与矩形相交(hitTestBox)的图形，否则取范围在矩形内的图形
+        \param count 最多获取多少个图形，为0时返回实际个数
+        \param shapes 填充框选到的图形对象
+        \return 获取多少个图形，或实际个数
+    */
+    virtual int getShapesInBox(const MgMotion* sender, const Box2d& box, bool intersect,
+                               int count, const MgShape** shapes) = 0;
 #endif
 };
 
@@ -68,6 +68,7 @@ struct MgView
     
     virtual void regenAll(bool changed) = 0;                    //!< 标记视图待重新构建显示
     virtual void regenAppend(int sid, long playh = 0) = 0;      //!< 标记视图待追加显示新图形
+    virtual void regenShape(const MgShape* shape) = 0;          //!< 标记视图待重新显示图形所在区域
     virtual void redraw(bool changed = true) = 0;               //!< 标记视图待更新显示
     
     virtual bool useFinger() = 0;                               //!< 使用手指或鼠标交互
@@ -84,6 +85,12 @@ struct MgView
     virtual bool shapeCanUnlock(const MgShape* shape) = 0;      //!< 通知是否能对图形解锁
     virtual bool shapeCanUngroup(const MgShape* shape) = 0;     //!< 通知是否能对成组图形解散
     virtual void shapeMoved(MgShape* shape, int segment) = 0;   //!< 通知图形已拖动
+    virtual void shapeChanged(const MgShape* shape) = 0;        //!< 通知已修改图形，由视图重新显示其区域
+    
+    //! 开始批量修改图形，在 commitBatch() 前累积图形ID和待显示区域，可嵌套
+    virtual void beginBatch() = 0;
+    //! 结束批量修改图形，统一发出一次图形改变通知并重新显示累积区域
+    virtual void commitBatch() = 0;
     virtual bool shapeWillChanged(MgShape* shape, const MgShape* oldsp) = 0;  //!< 通知将修改图形
     
     //! 图形点击的通知，返回false继续显示上下文按钮
@@ -149,6 +156,15 @@ public:
     float displayMmToModel(float mm, GiGraphics*) const { return d2mgs * mm; }
     //! 返回屏幕毫米长度对应的模型长度
     float displayMmToModel(float mm) const { return d2m * mm; }
+    
+    //! 按移动速度预测 ms 毫秒后的位置，模型坐标，预测距离不超过 maxMm 屏幕毫米
+    Point2d predictPointM(float ms, float maxMm) const {
+        Vector2d vec(velocity * (ms * 1e-3f) * view->xform()->displayToModel());
+        float maxlen = displayMmToModel(maxMm);
+        if (vec.length() > maxlen)
+            vec.setLength(maxlen);
+        return pointM + vec;
+    }
 };
 
 #ifndef SWIG
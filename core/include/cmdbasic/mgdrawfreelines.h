@@ -7,10 +7,14 @@
 #define TOUCHVG_CMD_DRAW_FREELINES_H_
 
 #include "mgcmddraw.h"
+#include "mgfitcurve.h"
 
 //! 自由折线绘图命令类
-/*! \ingroup CORE_COMMAND
-    \see MgLines
+/*! 命令参数 smooth 为 true 时将笔迹增量拟合为光滑曲线，生成 MgSplines 图形。
+    视图启用笔迹层时，不透明实线在绘制中只提交新增的笔迹(gatherInk)，
+    命令参数 predict 为按移动速度预测延长的毫秒数。
+    \ingroup CORE_COMMAND
+    \see MgLines, MgSplines, MgCurveFitter
 */
 class MgCmdDrawFreeLines : public MgCommandDraw
 {
@@ -19,18 +23,34 @@ public:
     static MgCommand* Create() { return new MgCmdDrawFreeLines; }
     
 private:
-    MgCmdDrawFreeLines() : MgCommandDraw(Name()) {}
+    MgCmdDrawFreeLines() : MgCommandDraw(Name()), m_smooth(false), m_fitted(NULL)
+        , m_fittedFixed(0), m_inkCount(-1), m_predict(0) {}
+    virtual ~MgCmdDrawFreeLines();
     virtual void release() { delete this; }
     
     virtual bool initialize(const MgMotion* sender, MgStorage* s);
     virtual bool backStep(const MgMotion* sender);
     virtual bool draw(const MgMotion* sender, GiGraphics* gs);
+    virtual bool gatherShapes(const MgMotion* sender, MgShapes* shapes);
+    virtual int gatherInk(const MgMotion* sender, MgShapes* newInk, MgShapes* shapes);
     virtual bool touchBegan(const MgMotion* sender);
     virtual bool touchMoved(const MgMotion* sender);
     virtual bool touchEnded(const MgMotion* sender);
+    virtual bool isStrokeCommand() { return true; }
     
 private:
     bool canAddPoint(const MgMotion* sender, bool ended);
+    void updateFitted();
+    void addLines(MgShapes* shapes, int from, int to);
+    void addBeziers(MgShapes* shapes, int from, int to);
+    
+private:
+    bool            m_smooth;       // 是否将笔迹光滑拟合为曲线
+    MgCurveFitter   m_fitter;       // 增量拟合器，每加一点只重新拟合尾部
+    MgShape*        m_fitted;       // 拟合出的曲线图形
+    int             m_fittedFixed;  // 拟合曲线图形中不再改变的段数
+    int             m_inkCount;     // 已提交的稳定点数(光滑时为贝塞尔段数)，-1表示需重新开始
+    int             m_predict;      // 预测延长的毫秒数，0表示不预测
 };
 
 #endif // TOUCHVG_CMD_DRAW_FREELINES_H_
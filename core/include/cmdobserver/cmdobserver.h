@@ -55,6 +55,11 @@ struct CmdObserver {
     virtual void onSelectTouchEnded(const MgMotion* sender, int shapeid,
         int handleIndex, int snapid, int snapHandle,
         int count, const int* ids) = 0;
+    
+    //! 批量修改图形后的通知，ids 依次为已添加、已修改、已删除的图形ID
+    /*! 批量修改中仍逐个发出 onShapeAdded 和 onShapeDeleted，本通知在 commitBatch 时汇总发出一次 */
+    virtual void onShapesChanged(const MgMotion* sender, int addedCount,
+        int changedCount, int deletedCount, const int* ids) = 0;
 #endif
 
     virtual bool onShapeWillAdded(const MgMotion* sender, MgShape* sp) = 0;    //!< 通知将添加图形
@@ -108,6 +113,7 @@ public:
     virtual int addShapeActions(const MgMotion* sender,mgvector<int>&,int n, const MgShape*) { return n; }
 #ifndef SWIG
     virtual void onSelectTouchEnded(const MgMotion*,int,int,int,int,int,const int*) {}
+    virtual void onShapesChanged(const MgMotion*,int,int,int,const int*) {}
 #endif
     virtual bool onPreGesture(MgMotion* sender) { return true; }
     virtual void onPostGesture(const MgMotion* sender) {}
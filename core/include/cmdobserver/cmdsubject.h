@@ -7,14 +7,55 @@
 
 #include "cmdobserver.h"
 
+//! 命令扩展事件，用于按事件注册观察者，每位对应 CmdObserver 的一个通知函数
+typedef enum {
+    kCmdEventDocLoaded          = 1 << 0,   //!< onDocLoaded
+    kCmdEventEnterSelect        = 1 << 1,   //!< onEnterSelectCommand
+    kCmdEventUnloadCommands     = 1 << 2,   //!< onUnloadCommands
+    kCmdEventActionsNeedHided   = 1 << 3,   //!< selectActionsNeedHided
+    kCmdEventAddShapeActions    = 1 << 4,   //!< addShapeActions
+    kCmdEventDoAction           = 1 << 5,   //!< doAction
+    kCmdEventDoEndAction        = 1 << 6,   //!< doEndAction
+    kCmdEventDrawInShapeCmd     = 1 << 7,   //!< drawInShapeCommand
+    kCmdEventDrawInSelectCmd    = 1 << 8,   //!< drawInSelectCommand
+    kCmdEventSelectTouchEnded   = 1 << 9,   //!< onSelectTouchEnded
+    kCmdEventShapesChanged      = 1 << 10,  //!< onShapesChanged
+    kCmdEventShapeWillAdded     = 1 << 11,  //!< onShapeWillAdded
+    kCmdEventShapeAdded         = 1 << 12,  //!< onShapeAdded
+    kCmdEventShapeWillDeleted   = 1 << 13,  //!< onShapeWillDeleted
+    kCmdEventShapeDeleted       = 1 << 14,  //!< onShapeDeleted
+    kCmdEventShapeCanRotated    = 1 << 15,  //!< onShapeCanRotated
+    kCmdEventShapeCanTransform  = 1 << 16,  //!< onShapeCanTransform
+    kCmdEventShapeCanUnlock     = 1 << 17,  //!< onShapeCanUnlock
+    kCmdEventShapeCanUngroup    = 1 << 18,  //!< onShapeCanUngroup
+    kCmdEventShapeMoved         = 1 << 19,  //!< onShapeMoved
+    kCmdEventShapeWillChanged   = 1 << 20,  //!< onShapeWillChanged
+    kCmdEventCreateShape        = 1 << 21,  //!< createShape
+    kCmdEventCreateCommand      = 1 << 22,  //!< createCommand
+    kCmdEventPreGesture         = 1 << 23,  //!< onPreGesture
+    kCmdEventPostGesture        = 1 << 24,  //!< onPostGesture
+    kCmdEventAll                = (1 << 25) - 1,    //!< 所有事件
+} CmdEventMask;
+
 //! 命令扩展目标接口
-/*! \ingroup CORE_COMMAND
+/*! 每个事件各有观察者列表，通知时只调用注册了该事件的观察者，没有观察者时不做任何调用。
+    \ingroup CORE_COMMAND
  */
 struct CmdSubject : public CmdObserver {
-    //! 注册观察者
+    //! 注册观察者，接收所有事件
     virtual void registerObserver(CmdObserver* observer) = 0;
+    //! 注册观察者，只接收 events 中的事件，events 为 CmdEventMask 的组合，已注册时替换其事件
+    virtual void registerObserver(CmdObserver* observer, int events) = 0;
     //! 注销观察者
     virtual void unregisterObserver(CmdObserver* observer) = 0;
+    //! 返回 events 中是否有事件已注册观察者，可在批量通知前检查以免准备参数
+    virtual bool hasObserver(int events) const = 0;
+
+#ifndef SWIG
+    //! 批量通知多个图形已移动，对每个图形调用观察者的 onShapeMoved
+    virtual void onShapesMoved(const MgMotion* sender, int count,
+                               MgShape* const* shapes, int segment) = 0;
+#endif
 };
 
 #endif // TOUCHVG_CMDSUBJECT_H_
@@ -0,0 +1,57 @@
+//! \file girastercanvas.h
+//! \brief 定义输出到像素缓冲区的画布适配器类 GiRasterCanvas
+// Copyright (c) 2013-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_CORE_RASTERCANVAS_H_
+#define TOUCHVG_CORE_RASTERCANVAS_H_
+
+#include "gicanvas.h"
+
+//! 输出到像素缓冲区的画布适配器类，用于无界面环境下生成缩略图和预览图
+/*! 以扫描线累积覆盖率的方式反走样填充和描边，像素为 RGBA 字节顺序、预乘 alpha。
+    不支持文字和图像，drawTextAt 和 drawBitmap 不显示内容。
+    \ingroup CORE_STORAGE
+ */
+class GiRasterCanvas : public GiCanvas
+{
+public:
+    GiRasterCanvas();
+    virtual ~GiRasterCanvas();
+
+    //! 设置绘图目标缓冲区，由调用者分配，stride 为每行字节数，为0则取 width*4
+    bool attach(unsigned char* pixels, int width, int height, int stride = 0);
+    void detach();                          //!< 断开绘图目标缓冲区
+    void clear(int argb);                   //!< 用指定颜色填充整个缓冲区
+    int width() const;                      //!< 返回缓冲区的像素宽度
+    int height() const;                     //!< 返回缓冲区的像素高度
+
+private:
+    virtual void setPen(int argb, float width, int style, float phase, float orgw);
+    virtual void setBrush(int argb, int style);
+    virtual void clearRect(float x, float y, float w, float h);
+    virtual void drawRect(float x, float y, float w, float h, bool stroke, bool fill);
+    virtual void drawLine(float x1, float y1, float x2, float y2);
+    virtual void drawEllipse(float x, float y, float w, float h, bool stroke, bool fill);
+    virtual void beginPath();
+    virtual void moveTo(float x, float y);
+    virtual void lineTo(float x, float y);
+    virtual void bezierTo(float c1x, float c1y, float c2x, float c2y, float x, float y);
+    virtual void quadTo(float cpx, float cpy, float x, float y);
+    virtual void closePath();
+    virtual void drawPath(bool stroke, bool fill);
+    virtual void saveClip();
+    virtual void restoreClip();
+    virtual bool clipRect(float x, float y, float w, float h);
+    virtual bool clipPath();
+    virtual bool drawHandle(float x, float y, int type);
+    virtual bool drawBitmap(const char* name, float xc, float yc, 
+                            float w, float h, float angle);
+    virtual float drawTextAt(const char* text, float x, float y, float h, int align);
+
+private:
+    struct Impl;
+    Impl*   im;
+};
+
+#endif // TOUCHVG_CORE_RASTERCANVAS_H_
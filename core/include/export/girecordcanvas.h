@@ -6,8 +6,8 @@
 #define TOUCHVG_CORE_GIRECORDCANVAS_H
 
 #include "gicanvas.h"
+#include "girecordshape.h"
 
-class MgRecordShape;
 class MgShape;
 class MgShapes;
 class GiTransform;
@@ -49,7 +49,9 @@ private:
     virtual float drawTextAt(const char* text, float x, float y, float h, int align);
     
 private:
-    const Matrix2d d2w() const;
+    MgRecordShape::Cell* addItem(int type, int n, const char* text = (const char*)0);
+    MgRecordShape::Cell* addRect(int type, float x, float y, float w, float h, int n);
+    MgRecordShape::Cell* addPoints(int type, int count, const float* xy, int extra = 0);
 
 private:
     MgShapes*       _shapes;
@@ -57,6 +59,12 @@ private:
     MgRecordShape*  _sp;
     const GiTransform* _xf;
     int             _ignoreId;
+    Matrix2d        _d2w;
+    Matrix2d        _w2m;
+    MgRecordShape::Cell _pen[5];    // last pen, written again at the start of each record
+    MgRecordShape::Cell _brush[2];  // last brush
+    int             _known;         // 1: _pen is set, 2: _brush is set
+    int             _pending;       // pen (1) and brush (2) not yet written in the current record
 };
 
 #endif // TOUCHVG_CORE_GIRECORDCANVAS_H
@@ -6,7 +6,6 @@
 #define TOUCHVG_CORE_GIRECORDSHAPE_H
 
 #include "mgshape.h"
-#include <vector>
 
 //! The shape class to record drawing.
 /*! \ingroup CORE_SHAPE
@@ -14,22 +13,29 @@
 class MgRecordShape : public MgBaseShape
 {
 public:
-    MgRecordShape() : _sid(0) {}
-    virtual ~MgRecordShape() { _clear(); }
+    MgRecordShape();
+    virtual ~MgRecordShape();
     
-    //! Interface of recording items.
-    struct ICmd {
-        virtual ~ICmd() {}
-        virtual int type() const = 0;
-        virtual void copy(const ICmd& src) = 0;
-        virtual bool save(MgStorage* s) const = 0;
-        virtual bool load(MgStorage* s) = 0;
-        virtual void draw(GiGraphics& gs, const Matrix2d& w2d) const = 0;
-        virtual Box2d getExtentW() const { return Box2d(0, 0, 1, 1); }
+    //! Cell of the recording buffer, which is a command tag or an int/float argument.
+    union Cell {
+        float   f;
+        int     i;
     };
+    struct Buffer;      //!< Pooled buffer of cells.
+    
+    //! Command types of recording items.
+    enum { kSetPen = 1, kSetBrush, kClearRect, kDrawRect, kDrawLine, kDrawEllipse,
+        kBeginPath, kMoveTo, kLineTo, kBezierTo, kQuadTo, kClosePath, kDrawPath,
+        kDrawHandle, kDrawBitmap, kDrawTextAt, kClipPath, kClipRect };
+    
+    int getCount() const { return _count; }
+    
+    //! Append a command with n argument cells and optional text, return the arguments to fill.
+    Cell* addItem(int type, int n, const char* text = (const char*)0);
+    
+    //! Expand the extent with a box in world coordinates.
+    void addExtent(const Matrix2d& w2m, const Box2d& rectW);
     
-    int getCount() const { return (int)_items.size(); }
-    void addItem(const Matrix2d& w2m, ICmd* p);
     void setRefID(int sid) { _sid = sid; }
     
     static MgRecordShape* create() { return new MgRecordShape(); }
@@ -56,10 +62,12 @@ public:
     
 private:
     void _clear();
-    ICmd* createItem(int type) const;
+    void drawItem(GiCanvas* canvas, const Matrix2d& w2d, int type, const Cell* args) const;
+    bool saveItem(MgStorage* s, int type, const Cell* args) const;
+    bool loadItem(MgStorage* s, int type);
     
-    typedef std::vector<ICmd*>  ITEMS;
-    ITEMS   _items;
+    Buffer* _buf;       // tagged commands with inline arguments, reused across frames
+    int     _count;
     int     _sid;
 };
 
@@ -0,0 +1,50 @@
+﻿//! \file mgfitcurve.h
+//! \brief 定义增量式曲线拟合类 MgCurveFitter
+// Copyright (c) 2004-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_CURVEFITTER_H_
+#define TOUCHVG_CURVEFITTER_H_
+
+#include "mgpnt.h"
+
+//! 增量式曲线拟合类，将陆续输入的数据点光滑拟合为三次贝塞尔曲线
+/*! 已确定的贝塞尔段保持不变，每加入一点只重新拟合尾部窗口内的数据点，
+    窗口点数有上限，因此每点的拟合计算量是常数。
+    \ingroup GEOMAPI
+    \see mgcurv::fitCurve
+*/
+class MgCurveFitter
+{
+public:
+    //! 构造拟合器，maxWindow 为尾部窗口的最多点数
+    MgCurveFitter(int maxWindow = 64);
+    ~MgCurveFitter();
+    
+    //! 清除数据点和拟合结果，开始新的曲线
+    void clear();
+    
+    //! 设置拟合曲线与数据点的最大允许距离
+    void setTolerance(float tol);
+    
+    //! 加入一个数据点并重新拟合尾部，返回已确定的贝塞尔段是否有增加
+    bool addPoint(const Point2d& pt);
+    
+    //! 返回贝塞尔段数，含已确定的段和尾部的段
+    int getSegmentCount() const;
+    
+    //! 返回已确定的贝塞尔段数，这些段在后续加点时不再改变
+    int getFixedCount() const;
+    
+    //! 返回贝塞尔曲线控制点，共 1 + 3 * getSegmentCount() 个点
+    const Point2d* getControlPoints() const;
+    
+private:
+    MgCurveFitter(const MgCurveFitter&);
+    void operator=(const MgCurveFitter&);
+    
+    struct Impl;
+    Impl* im;
+};
+
+#endif // TOUCHVG_CURVEFITTER_H_
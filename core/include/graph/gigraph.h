@@ -52,6 +52,9 @@ public:
 public:
     //! 复制指定对象到本对象
     void copy(const GiGraphics& src);
+    
+    //! 返回坐标系和显示属性改变的次数，用于判断复制的对象是否已过时
+    long getVersion() const;
 
     //! 返回坐标系管理对象
     const GiTransform& xf() const;
@@ -132,8 +135,11 @@ public:
     */
     void setMaxPenWidth(float pixels, float minw = 1);
     
-    //! 设置像素线宽的放大系数
-    static void setPenWidthFactor(float factor);
+    //! 设置像素线宽的放大系数，随坐标系参数一起复制
+    void setPenWidthFactor(float factor);
+    
+    //! 返回像素线宽的放大系数
+    float getPenWidthFactor() const;
     
 public:
     //! 绘制直线段，模型坐标或世界坐标
@@ -0,0 +1,33 @@
+﻿//! \file githread.h
+//! \brief 定义常驻工作线程池 GiThreadPool 和线程让步函数 giYieldThread
+// Copyright (c) 2012-2014, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_GITHREAD_H_
+#define TOUCHVG_GITHREAD_H_
+
+#ifndef SWIG
+
+//! 让出当前线程的时间片，用于等待其他线程释放自旋锁
+void giYieldThread();
+
+//! 返回处理器个数，至少为1
+int giGetProcessorCount();
+
+//! 常驻工作线程池，批量图形任务、批量显示和并发测试共用
+/*! 工作线程在需要时创建，空闲时等待新任务，不随任务结束而退出。
+    run() 让多个线程同时执行同一个任务函数，由任务函数自己领取工作项（例如原子递增序号）。
+    调用线程也执行任务函数，没有空闲的工作线程时任务就在调用线程中完成，
+    因此可在多个线程中同时调用，也可在任务函数中嵌套调用。
+    \ingroup GRAPH_INTERFACE
+ */
+struct GiThreadPool {
+    enum { kMaxThreads = 16 };      //!< 工作线程的最大个数
+    
+    typedef void (*Task)(void* data);
+    
+    //! 用至多 threads 个线程（含调用线程）执行 task(data)，各线程都执行完后返回
+    static void run(Task task, void* data, int threads);
+};
+
+#endif // SWIG
+#endif // TOUCHVG_GITHREAD_H_
@@ -0,0 +1,33 @@
+﻿//! \file gitick.h
+//! \brief 定义毫秒计时函数 giGetTickCount
+// Copyright (c) 2012-2014, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_GITICK_H_
+#define TOUCHVG_GITICK_H_
+
+#ifndef SWIG
+#if defined(__WINDOWS__) || defined(WIN32)
+    #ifndef _WINDOWS_
+        #define WIN32_LEAN_AND_MEAN
+        #include <windows.h>
+    #endif
+#else
+    #include <sys/time.h>
+#endif
+
+//! 返回毫秒计数，约49天回绕一次，只用于无符号相减计算耗时
+/*! 例如 giGetTickCount() - start >= (unsigned)budget，回绕后相减仍得到正确的耗时
+ */
+inline unsigned giGetTickCount()
+{
+#if defined(__WINDOWS__) || defined(WIN32)
+    return (unsigned)GetTickCount();
+#else
+    struct timeval tv;
+    gettimeofday(&tv, (struct timezone*)0);
+    return (unsigned)tv.tv_sec * 1000u + (unsigned)(tv.tv_usec / 1000);
+#endif
+}
+#endif // SWIG
+
+#endif // TOUCHVG_GITICK_H_
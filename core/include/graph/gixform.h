@@ -260,6 +260,9 @@ public:
 
     //! 返回放缩结果改变的次数，供图形系统等观察者作比较使用
     long getZoomTimes() const;
+    
+    //! 返回坐标系参数改变的次数，含放缩、窗口大小、分辨率和显示范围等改变
+    long getVersion() const;
 
 private:
     GiTransformImpl*    m_impl;
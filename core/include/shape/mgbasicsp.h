@@ -293,6 +293,18 @@ public:
     //! 返回坐标数组
     Point2d* getPoints() { return _points; }
     const Point2d* getPoints() const { return _points; }
+    
+    //! 返回边数，闭合时含首末连接边，曲线则为贝塞尔段数
+    int getSegmentCount() const { return _count < 2 ? 0 : (isClosed() ? _count : _count - 1); }
+    
+    //! 遍历包络框与矩形相交的边，返回遍历过的边数
+    /*! 第 i 条边从第 i 点到下一点，曲线则为第 i 个贝塞尔段。
+        边数较多时延迟建立各边包络框的层次索引，查找代价与边数成对数关系。
+        \param rect 查找矩形，模型坐标
+        \param c 回调函数，参数为边序号和自定义数据，返回false时停止遍历
+        \param d 回调函数的自定义数据
+     */
+    virtual int traverseSegments(const Box2d& rect, bool (*c)(int, void*), void* d) const;
 #endif
 
 protected:
@@ -308,16 +320,29 @@ protected:
     void _update();
     void _transform(const Matrix2d& mat);
     void _clear();
+    void _clearCachedData();
     bool _setHandlePoint(int index, const Point2d& pt, float tol);
     float _hitTest(const Point2d& pt, float tol, MgHitResult& res) const;
     bool _hitTestBox(const Box2d& rect) const;
     bool _save(MgStorage* s) const;
     bool _load(MgShapeFactory* factory, MgStorage* s);
+    
+    //! 在各边包络框中查找，boxes 为NULL时由顶点计算各边包络框
+    int traverseSegmentTree(const Box2d& rect, const Box2d* boxes,
+                            bool (*c)(int, void*), void* d) const;
+    void freeSegmentTree(bool wait = true);     //!< wait 为 false 时不释放正在使用的索引
 
 protected:
     Point2d*    _points;
     int      _maxCount;
     int      _count;
+    
+private:
+    bool buildSegmentTree(const Box2d* boxes) const;    // 返回 true 时须 mgUnpinCache
+    
+    Box2d*      _segtree;   // 每组相邻边的包络框逐层合并的层次索引，延迟生成
+    int         _segcount;  // 建立索引时的边数
+    volatile long _segstate; // 0:无索引, 1:正在生成或释放, 2:索引有效, >2:正在读取
 };
 
 //! 折线图形类
@@ -352,13 +377,34 @@ public:
     
     bool smooth(const Matrix2d& m2d, float tol);
     int smoothForPoints(int count, const Point2d* points, const Matrix2d& m2d, float tol);
+    
+    //! 由三次贝塞尔曲线控制点设置型值点和切矢量，count 为 1 + 3 * 段数
+    /*! 连接点两侧的控制边长度可以不同，曲线与给定的贝塞尔段完全相同。
+     */
+    bool setBeziers(int count, const Point2d* points);
+    
+    //! 保留前 from 段，其后替换为给定的贝塞尔段，用于逐段增加的曲线
+    /*! points[0] 为第 from 个型值点，count 为 1 + 3 * 新段数。
+        from 大于0时只计算新的段，图形范围只并入新型值点，不用再调用 update()。
+     */
+    bool setTailBeziers(int from, int count, const Point2d* points);
+    
+    //! 得到第 segment 个三次贝塞尔段的控制点，没有切矢量(二次样条)时返回false
+    bool getBezier(int segment, Point2d points[4]) const;
+    
     void clearVectors();
+    
+#ifndef SWIG
+    virtual int traverseSegments(const Box2d& rect, bool (*c)(int, void*), void* d) const;
+#endif
 
 protected:
     void _copy(const MgSplines& src);
     bool _equals(const MgSplines& src) const;
+    void _update();
     void _transform(const Matrix2d& mat);
     void _clear();
+    void _clearCachedData();
     void _setPoint(int index, const Point2d& pt);
     float _hitTest(const Point2d& pt, float tol, MgHitResult& res) const;
     bool _hitTestBox(const Box2d& rect) const;
@@ -367,6 +413,19 @@ protected:
     bool _load(MgShapeFactory* factory, MgStorage* s);
     
     Vector2d*   _knotvs;
+    Vector2d*   _knotins;   // 进入型值点的控制边，为NULL时与 _knotvs 相同
+    
+private:
+    void bezierAt(int i, Point2d points[4]) const;
+    void reserveVectors(int oldMax);
+    void getBeziers(Point2d* points) const;
+    bool buildBeziers() const;  // 返回 true 时缓存已加读取计数，读完须 mgUnpinCache
+    void freeBeziers(bool wait = true);
+    
+    Point2d*    _bzpts;     // 由型值点和切矢量展开的贝塞尔控制点缓存，延迟生成
+    Box2d*      _bzboxes;   // 各贝塞尔段的包络框缓存
+    int         _bzcount;   // 缓存的贝塞尔段数，闭合时含首末连接段
+    volatile long _bzstate; // 0:无缓存, 1:正在生成或释放, 2:缓存有效, >2:正在读取
 };
 
 //! 平行四边形图形基类
@@ -26,6 +26,14 @@ public:
     
     //! 返回拥有者图形对象
     const MgShape* getOwnerShape() const { return _owner; }
+    
+#ifndef SWIG
+    //! 按显示次序遍历包络框与矩形相交的子图形，回调返回false则停止，返回回调的次数
+    /*! 子图形的包络框索引在 update() 时增量更新，整组不相交的相邻子图形一次跳过。
+        子图形列表改变后尚未 update() 时逐个比较包络框。
+     */
+    int traverseChildren(const Box2d& rect, bool (*c)(const MgShape*, void*), void* d) const;
+#endif
 
     //! 返回是否可以单独移动一个子图形，在 offset() 中调用
     virtual bool canOffsetShapeAlone(MgShape* shape) { return !!shape; }
@@ -53,6 +61,7 @@ protected:
     void _transform(const Matrix2d& mat);
     void _clear();
     float _hitTest(const Point2d& pt, float tol, MgHitResult& res) const;
+    bool _hitTestBox(const Box2d& rect) const;
     bool _offset(const Vector2d& vec, int segment);
     bool _draw(int mode, GiGraphics& gs, const GiContext& ctx, int segment) const;
     void _output(GiPath& path) const;
@@ -60,6 +69,10 @@ protected:
 protected:
     MgShape*    _owner;
     MgShapes*   _shapes;
+    
+private:
+    struct ChildIndex;
+    ChildIndex* _index;     // 子图形的包络框和控制点序号索引
 };
 
 //! 成组图形类
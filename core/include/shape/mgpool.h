@@ -0,0 +1,31 @@
+﻿//! \file mgpool.h
+//! \brief 定义小块内存分配器 MgPool
+// Copyright (c) 2004-2013, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_MGPOOL_H_
+#define TOUCHVG_MGPOOL_H_
+
+#include <stddef.h>
+
+//! 小块内存分配器，用于图形对象和顶点数组
+/*! 按16字节分级，每级从整块内存中切分出等长的内存块，释放的内存块放回本级的空闲链表供再次分配。
+    大量图形加载或销毁时不必逐个向系统申请和释放，同类图形在内存中也相邻。
+    大于 kMaxSize 的内存直接使用 new 分配。可在多线程中使用。
+    整块内存在 trim() 中才归还系统，文档释放时会调用。
+    \ingroup CORE_SHAPE
+ */
+struct MgPool {
+    enum { kMaxSize = 1024 };       //!< 分级管理的最大字节数
+
+    //! 分配指定字节数的内存，不初始化
+    static void* allocate(size_t size);
+
+    //! 释放由 allocate 分配的内存，size 为分配时的字节数
+    static void deallocate(void* p, size_t size);
+    
+    //! 归还全部内存块都已空闲的整块内存，空闲的内存块不多时直接返回
+    static void trim();
+};
+
+#endif // TOUCHVG_MGPOOL_H_
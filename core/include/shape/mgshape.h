@@ -129,11 +129,17 @@ public:
     //! 返回本对象的类型
     static int Type() { return 3; }
     
-    //! 返回确实小容差，用于计算包络框等
-    static Tol& minTol() {
-        static Tol tol;
-        return tol;
+    //! 返回确实小容差，用于计算包络框等，按坐标的量级确定，不随视图改变
+    /*! \param ext 坐标范围，容差为其中最大坐标绝对值的十万分之一，量级小于1时按1计算
+     */
+    static Tol minTol(const Box2d& ext) {
+        float m = mgMax(mgMax(fabsf(ext.xmin), fabsf(ext.xmax)),
+                        mgMax(fabsf(ext.ymin), fabsf(ext.ymax)));
+        return Tol(mgMax(m, 1.f) * 1e-5f);
     }
+    
+    //! 返回本图形的确实小容差，由图形范围的坐标量级确定
+    Tol minTol() const { return minTol(_extent); }
 
     //! 复制出一个新图形对象
     MgBaseShape* cloneShape() const { return (MgBaseShape*)clone(); }
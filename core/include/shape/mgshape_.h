@@ -7,6 +7,7 @@
 #define TOUCHVG_MGSHAPEIMPL_H_
 
 #include "mgstorage.h"
+#include "gilock.h"
 
 #define MG_IMPLEMENT_CREATE(Cls)                                \
     Cls* Cls::create() { return new Cls(); }                    \
@@ -53,4 +54,41 @@
     bool Cls::offset(const Vector2d& vec, int segment)          \
         { return _offset(vec, segment); }
 
+// 图形的延迟生成缓存可被共享显示的多个线程同时读取，state 为缓存状态:
+// 0:无缓存, 1:正在生成或释放, 2:缓存有效, 大于2时多出的为正在读取的线程数
+
+//! 缓存有效时增加读取计数，返回 true 时读完须调用 mgUnpinCache
+inline bool mgPinCache(const volatile long* cstate)
+{
+    volatile long* state = const_cast<volatile long*>(cstate);  // 缓存状态不影响图形内容
+    for (;;) {
+        long s = *state;
+        if (s < 2)
+            return false;
+        if (giAtomicCompareAndSwap(state, s + 1, s))
+            return true;
+    }
+}
+
+//! 读完缓存后减少读取计数
+inline void mgUnpinCache(const volatile long* state)
+{
+    giAtomicDecrement(const_cast<volatile long*>(state));
+}
+
+//! 开始释放缓存，返回 true 时释放后须将 state 置为0
+/*! wait 为 true 时等其他线程生成或读完后再释放，用于修改图形前；
+    为 false 时缓存正在使用则不释放，用于只是清理内存时。
+ */
+inline bool mgLockCacheForFree(volatile long* state, bool wait)
+{
+    for (;;) {
+        long s = *state;
+        if (s == 0 || (!wait && s != 2))
+            return false;
+        if (s == 2 && giAtomicCompareAndSwap(state, 1, 2))
+            return true;
+    }
+}
+
 #endif // TOUCHVG_MGSHAPEIMPL_H_
@@ -8,6 +8,8 @@
 
 #include "mgshape.h"
 
+class MgSymbol;
+
 //! 图形列表类
 /*! \ingroup CORE_SHAPE
     \see MgShapeIterator
@@ -94,9 +96,15 @@ public:
     //! 复制出一个新图形对象
     MgShape* cloneShape(int sid) const;
     
-    //! 对每个图形进行变形
+    //! 对每个图形进行变形，图形较多时由多个线程克隆并变形，再按原顺序一次换入
     void transform(const Matrix2d& mat);
     
+    //! 平移每个图形
+    void offset(const Vector2d& vec);
+    
+    //! 设置每个图形的绘图属性，mask 为 GiContext::kCopyAll 等值的组合
+    void setContext(const GiContext& ctx, int mask);
+    
     //! 移除一个图形
     bool removeShape(int sid);
 
@@ -118,6 +126,14 @@ public:
     //! 返回图层序号
     int getIndex() const;
     
+    //! 返回改变计数，增删改图形后增加，浅拷贝和复制图形时取源图形列表的计数
+    long getChangeCount() const;
+    
+#ifndef SWIG
+    //! 按名称查找图元定义，复合图形中的图形列表向上一级查找，图层在所属文档中查找
+    virtual MgSymbol* findSymbol(const char* name) const;
+#endif
+    
     static MgShapes* fromHandle(long h) { MgShapes* p; *(long*)&p = h; return p; } //!< 转为对象
     long toHandle() { long h; *(MgShapes**)&h = this; return h; }   //!< 得到句柄，用于跨库转换
     
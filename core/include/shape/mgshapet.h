@@ -7,10 +7,12 @@
 #define TOUCHVG_MGSHAPE_TEMPL_H_
 
 #include "mgshape.h"
+#include "mgpool.h"
 
 //! 矢量图形模板类
 /*! \ingroup CORE_SHAPE
     使用 MgShapeT<ShapeClass>::registerCreator() 登记图形种类;
+    图形对象由 MgPool 分配，create()、clone() 和图形列表添加图形时都不单独向系统申请内存。
  */
 template <class ShapeT, class ContextT = GiContext>
 class MgShapeT : public MgShape
@@ -34,6 +36,16 @@ public:
     virtual ~MgShapeT() {
     }
     
+#ifndef SWIG
+    static void* operator new(size_t size) {
+        return MgPool::allocate(size);
+    }
+    
+    static void operator delete(void* p, size_t size) {
+        MgPool::deallocate(p, size);
+    }
+#endif
+    
     const GiContext& context() const {
         return _context;
     }
@@ -38,6 +38,7 @@ typedef enum {
     kMgShapeRecord = 30,        //!< 录制, MgRecordShape
     kMgShapeDot = 31,           //!< 点, MgDot
     kMgShapePath = 32,          //!< 路径, MgPathShape
+    kMgShapeSymbol = 33,        //!< 图元引用, MgSymbolShape
 } MgShapeType;
 
 #endif // TOUCHVG_SHAPETYPE_H_
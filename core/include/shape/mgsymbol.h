@@ -0,0 +1,112 @@
+﻿//! \file mgsymbol.h
+//! \brief 定义图元定义类 MgSymbol 和图元引用图形类 MgSymbolShape
+// Copyright (c) 2004-2013, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_SYMBOL_SHAPE_H_
+#define TOUCHVG_SYMBOL_SHAPE_H_
+
+#include "mgbasicsp.h"
+
+class MgShapes;
+
+//! 图元定义，由多个图元引用图形共享其图形
+/*! 定义中的图形使用定义自身的坐标系，图元引用图形(MgSymbolShape)通过变换矩阵放置。
+    定义使用引用计数，由图形文档、文档副本和引用图形共同持有。新建的定义在 editShapes()
+    中添加图形后调用 update()，添加到文档后即冻结不可再修改，以便显示线程和撤销快照安全共享。
+    修改文档中的定义时先用 clone() 复制，修改副本后调用 MgShapeDoc::replaceSymbol 替换。
+    \ingroup CORE_SHAPE
+    \see MgSymbolShape, MgShapeDoc::addSymbol
+*/
+class MgSymbol
+{
+public:
+    //! 创建指定名称的空定义
+    static MgSymbol* create(const char* name);
+
+    //! 复制出未冻结的定义，图形也都复制，嵌套引用的定义仍共享
+    MgSymbol* clone() const;
+
+    void addRef();                          //!< 添加引用计数
+    void release();                         //!< 释放引用计数，为0时销毁对象
+
+    const char* getName() const;            //!< 返回定义名称
+    void setName(const char* name);         //!< 设置定义名称，冻结后不能再改名
+    const MgShapes* shapes() const;         //!< 返回定义中的图形
+    MgShapes* editShapes();                 //!< 返回可修改的图形列表，冻结后返回NULL
+    bool isFrozen() const;                  //!< 返回是否已冻结，冻结后不可再修改
+    void freeze();                          //!< 冻结定义，由 MgShapeDoc 在添加定义时调用
+    int getShapeCount() const;              //!< 返回定义中的图形数
+    Box2d getExtent() const;                //!< 返回定义坐标系中的图形范围
+    long getChangeCount() const;            //!< 返回改变计数，update() 后增加
+
+    //! 修改图形后重新计算范围和显示缓存，冻结后不再计算
+    /*! 图形都是同一绘图属性的简单图形时合并为一个路径缓存起来，正常显示时一次画出。
+     */
+    void update();
+
+    //! 在当前模型坐标系下显示定义中的图形
+    /*! \param mode 显示模式，同 MgShape::draw
+        \param gs 图形显示对象
+        \param ctx 覆盖图形自身绘图属性的参数，NULL 表示按各图形自身的属性显示
+     */
+    bool draw(int mode, GiGraphics& gs, const GiContext* ctx) const;
+
+#ifndef SWIG
+    //! 保存定义名称和图形
+    bool save(MgStorage* s) const;
+
+    //! 加载图形，lookup 用于查找嵌套引用的其他定义，冻结后返回false
+    bool load(MgShapeFactory* factory, MgStorage* s, const MgShapes* lookup);
+#endif
+
+private:
+    MgSymbol(const char* name);
+    ~MgSymbol();
+
+    struct Impl;
+    Impl*   im;
+};
+
+//! 图元引用图形类
+/*! 只保存所引用的定义和放置矩阵，显示、选中、范围和保存都通过共享的定义进行。
+    四个角点为定义的范围经放置矩阵变换后的位置，可像矩形一样移动、缩放和旋转，不保留错切和镜像。
+    与复合图形一样按定义中各图形的属性显示，显示时传入的绘图属性(如选中状态)覆盖定义中图形的属性。
+    \ingroup CORE_SHAPE
+    \see MgSymbol
+*/
+class MgSymbolShape : public MgBaseRect
+{
+    MG_INHERIT_CREATE(MgSymbolShape, MgBaseRect, 33)
+public:
+    //! 返回所引用的定义
+    MgSymbol* getSymbol() const { return _symbol; }
+
+    //! 设置所引用的定义和放置矩阵，需再调用 update()
+    void setSymbol(MgSymbol* symbol, const Matrix2d& mat = Matrix2d::kIdentity());
+
+    //! 返回从定义坐标系到图形坐标系的放置矩阵
+    const Matrix2d& getMatrix() const { return _mat; }
+
+    virtual void setOwner(MgShape* owner) { _owner = owner; }
+
+protected:
+    void _copy(const MgSymbolShape& src);
+    bool _equals(const MgSymbolShape& src) const;
+    void _update();
+    void _transform(const Matrix2d& mat);
+    void _clear();
+    float _hitTest(const Point2d& pt, float tol, MgHitResult& res) const;
+    bool _hitTestBox(const Box2d& rect) const;
+    void _output(GiPath& path) const;
+    bool _save(MgStorage* s) const;
+    bool _load(MgShapeFactory* factory, MgStorage* s);
+
+private:
+    MgSymbol*   _symbol;
+    Matrix2d    _mat;
+    long        _symbolChange;      // 按此定义改变计数放置的角点
+    MgShape*    _owner;
+};
+
+#endif // TOUCHVG_SYMBOL_SHAPE_H_
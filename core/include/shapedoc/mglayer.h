@@ -32,6 +32,10 @@ public:
     bool isLocked() const { return !!_bits.locked; }        //!< 返回图层是否锁定
     void setLocked(bool locked) { _bits.locked = locked; }  //!< 设置图层是否锁定
     
+#ifndef SWIG
+    virtual MgSymbol* findSymbol(const char* name) const;   //!< 在所属文档中查找图元定义
+#endif
+    
 public:
     virtual MgObject* clone() const;
     virtual void copy(const MgObject& src);
@@ -55,6 +55,21 @@ public:
     
     //! 动态显示所有图形
     int dyndraw(int mode, GiGraphics& gs) const;
+    
+    //! 在时限内按图层和图形的层次次序显示，未显示完的可在后续帧中继续显示
+    /*! 续显示时不清除画布，视图放缩或文档改变后应清除画布并传入0重新开始，
+        传入旧游标时也从头显示。边遍历边显示，每次的耗时不随图形总数增长。
+        只显示与剪裁框相交的图形，显示完后的结果与 dyndraw 相同。
+        \param mode 显示模式，同 dyndraw
+        \param gs 图形显示对象
+        \param cursor 显示游标，开始新的显示时为0，未显示完时输出新游标，显示完则置为0
+        \param budget 本次显示的时限，毫秒
+        \return 本次显示的图形个数
+     */
+    int dyndraw(int mode, GiGraphics& gs, long& cursor, int budget) const;
+    
+    //! 释放未显示完的显示游标
+    static void releaseDrawCursor(long cursor);
 
     //! 返回图形范围
     Box2d getExtent() const;
@@ -82,6 +97,34 @@ public:
 
     //! 得到图层数量
     int getLayerCount() const;
+    
+    //! 得到指定序号的图层
+    const MgLayer* getLayer(int index) const;
+    
+#ifndef SWIG
+    //! 按名称查找图元定义，没有则返回NULL
+    MgSymbol* findSymbol(const char* name) const;
+    
+    //! 添加图元定义并添加其引用，返回文档中的定义，添加后的定义被冻结
+    /*! 文档中的定义名称各不相同，引用图形按名称保存，因此不替换同名的定义。
+        与已有的定义重名时添加名为“原名_序号”的副本，原定义可能还被其他文档使用，新建引用图形时应使用返回的定义。
+        添加方式加载文档时，文件中与已有定义重名的定义也同样改名，新加载的引用图形使用改名后的定义。
+     */
+    MgSymbol* addSymbol(MgSymbol* symbol);
+    
+    //! 用未冻结的新定义替换文档中的定义，新定义沿用原名
+    /*! 用于修改定义：先 clone() 原定义，修改副本后调用本函数。
+        引用了原定义的图形和其他定义都复制后改为引用新定义，其他文档和撤销快照仍使用原定义。
+        \return 原定义不在本文档中或新定义已冻结时返回false
+     */
+    bool replaceSymbol(MgSymbol* oldsym, MgSymbol* newsym);
+    
+    //! 得到图元定义的个数
+    int getSymbolCount() const;
+    
+    //! 得到指定序号的图元定义
+    MgSymbol* getSymbol(int index) const;
+#endif
 
     //! 返回新图形的图形属性
     GiContext* context();
@@ -89,6 +132,23 @@ public:
     //! 模型变换矩阵
     Matrix2d& modelTransform();
 
+    //! 返回文档原点的X坐标，图形坐标是相对于文档原点的单精度坐标
+    double getOriginX() const;
+    
+    //! 返回文档原点的Y坐标
+    double getOriginY() const;
+    
+    //! 设置文档原点，以便在远离原点的大范围绝对坐标(如公里级测绘坐标)下保持单精度图形坐标的精度
+    /*!
+        \param x 文档原点的绝对X坐标
+        \param y 文档原点的绝对Y坐标
+        \param moveShapes 是否平移已有图形，使其绝对坐标保持不变
+     */
+    void setOrigin(double x, double y, bool moveShapes = false);
+    
+    //! 将绝对坐标转换为相对于文档原点的图形坐标
+    Point2d toLocal(double x, double y) const;
+    
     //! 得到页面范围的世界坐标
     const Box2d& getPageRectW() const;
 
@@ -0,0 +1,21 @@
+//! \file testconcurrent.h
+//! \brief Define the stress testing class: TestConcurrentViews.
+// Copyright (c) 2012-2014, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_TESTCONCURRENT_H
+#define TOUCHVG_TESTCONCURRENT_H
+
+//! Stress test that drives several GiCoreView instances on parallel threads.
+/*! The views run on the threads of GiThreadPool, one view per thread while the pool
+    has enough threads. Each view has its own display DPI, adds shapes, draws a line
+    with gestures, submits and renders the document into a pixel buffer.
+    After all threads finish, every view is rendered again on the calling thread,
+    and the pixels must be the same as the last frame drawn concurrently.
+    \ingroup CORE_VIEW
+ */
+struct TestConcurrentViews {
+    //! Run the test with the given count of views (threads), returns the count of failed views.
+    static int run(int views = 8, int rounds = 20);
+};
+
+#endif // TOUCHVG_TESTCONCURRENT_H
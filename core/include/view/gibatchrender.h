@@ -0,0 +1,68 @@
+﻿//! \file gibatchrender.h
+//! \brief 定义批量显示图形文件的类 GiBatchRenderer
+// Copyright (c) 2012-2014, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_CORE_BATCHRENDER_H
+#define TOUCHVG_CORE_BATCHRENDER_H
+
+class GiCanvas;
+struct MgShapeFactory;
+
+//! 批量显示用的画布工厂接口
+/*! 各方法可能在多个线程中同时调用
+    \ingroup CORE_VIEW
+ */
+struct GiBatchCanvasFactory {
+    virtual ~GiBatchCanvasFactory() {}
+    
+    //! 为第 index 个文件创建指定像素宽高的画布，返回NULL则跳过该文件
+    virtual GiCanvas* createCanvas(int index, const char* vgfile, int width, int height) = 0;
+    
+    //! 显示完成后交回画布，可在此保存图像并释放画布
+    virtual void releaseCanvas(int index, GiCanvas* canvas, bool ok) = 0;
+};
+
+//! 批量显示图形文件，用于生成缩略图和预览图
+/*! 不需要视图和命令管理器，每个文件单独加载、放缩到图形范围、显示后立即释放文档。
+    先用 addFile 添加全部文件，再调用 run 用多个线程显示，或在调用者自己的各线程中循环调用 renderNext。
+    同时加载的文档数不超过显示线程数。
+    \ingroup CORE_VIEW
+ */
+class GiBatchRenderer
+{
+public:
+    GiBatchRenderer(GiBatchCanvasFactory* factory);
+    ~GiBatchRenderer();
+    
+    //! 返回图形工厂，可在显示前注册自定义图形类型
+    MgShapeFactory* getShapeFactory();
+    
+    //! 设置图形范围到画布边缘的留空像素数，默认为4
+    void setMargin(int margin);
+    
+    //! 添加一个待显示的图形文件及其输出像素宽高，返回文件序号
+    int addFile(const char* vgfile, int width, int height);
+    
+    int getCount() const;                   //!< 返回已添加的文件数
+    void reset();                           //!< 清除各文件的显示结果，以便重新显示
+    
+    //! 取下一个未显示的文件并显示，可在多个线程中同时调用，没有待显示的文件则返回false
+    bool renderNext();
+    
+    //! 用指定个数的线程显示全部文件，线程数小于2则在当前线程中显示，返回成功显示的文件数
+    int run(int threads);
+    
+    //! 返回文件的显示结果，0: 未显示, 1: 已显示, -1: 加载失败, -2: 未创建画布
+    int getState(int index) const;
+    int getShapeCount(int index) const;     //!< 返回文件中的图形数
+    long getLoadTime(int index) const;      //!< 返回加载文件所用的毫秒数
+    long getDrawTime(int index) const;      //!< 返回显示图形所用的毫秒数
+    
+private:
+    void render(int index);
+    
+    struct Impl;
+    Impl* impl;
+};
+
+#endif // TOUCHVG_CORE_BATCHRENDER_H
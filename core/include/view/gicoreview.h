@@ -27,6 +27,11 @@ public:
     
     long acquireGraphics(GiView* view);                             //!< 获取前端 GiGraphics 的句柄
     void releaseGraphics(long gs);                                  //!< 释放 GiGraphics 句柄
+    //! 返回前端 GiGraphics 对象池的统计值
+    /*! \param type 0: 池中对象数, 1: 坐标系未变而免复制的次数, 2: 复制坐标系后复用的次数,
+            3: 新建对象的次数, 4: 争用同一空闲对象失败的次数
+     */
+    long getGraphicsStats(int type);
     int acquireFrontDocs(mgvector<long>& docs);                     //!< 获取前端图形文档的句柄
     static void releaseDocs(const mgvector<long>& docs);            //!< 释放文档句柄
     int acquireDynamicShapesArray(mgvector<long>& shapes);          //!< 获取前端图形列表的句柄
@@ -34,16 +39,47 @@ public:
     
     int drawAll(long doc, long gs, GiCanvas* canvas);               //!< 显示所有图形
     int drawAll(const mgvector<long>& docs, long gs, GiCanvas* canvas);  //!< 显示所有图形
+    //! 在时限(毫秒)内显示图形，返回未显示完的游标以便下一帧继续显示，显示完则返回0
+    long drawAll(long doc, long gs, GiCanvas* canvas, long cursor, int budget);
+    static void releaseDrawCursor(long cursor);                     //!< 释放未显示完的游标
     int drawAppend(long doc, long gs, GiCanvas* canvas, int sid);   //!< 显示新图形
+    int drawRegion(long doc, long gs, GiCanvas* canvas,
+                   float x, float y, float w, float h);             //!< 显示局部区域(显示坐标)内的图形
     int dynDraw(long shapes, long gs, GiCanvas* canvas);            //!< 显示动态图形
     int dynDraw(const mgvector<long>& shapes, long gs, GiCanvas* canvas); //!< 显示动态图形
     
     int drawAll(GiView* view, GiCanvas* canvas);                    //!< 显示所有图形，主线程中用
     int drawAppend(GiView* view, GiCanvas* canvas, int sid);        //!< 显示新图形，主线程中用
+    int drawRegion(GiView* view, GiCanvas* canvas,
+                   float x, float y, float w, float h);             //!< 显示局部区域内的图形，主线程中用
     int dynDraw(GiView* view, GiCanvas* canvas);                    //!< 显示动态图形，主线程中用
     
+    //! 设置宿主是否有保留内容的笔迹层，默认没有，此时 dynDraw 显示全部动态图形
+    /*! 启用后才使用增量笔迹，宿主需在每次 dynDraw 时也调用 drawNewInk，应在未绘图时设置
+     */
+    void setInkLayerEnabled(bool enabled);
+    
+    //! 获取笔迹层的笔迹句柄，需要并发保护，用完后调用 releaseNewInk
+    /*! 启用笔迹层后，徒手绘图时命令只提交新增的笔迹段，dynDraw 只显示未稳定的尾部和预测段。
+        句柄含当前笔迹已提交的各帧，提交后不再改变，可在显示线程中使用。
+     */
+    long acquireNewInk();
+    static void releaseNewInk(long ink);                            //!< 释放笔迹句柄
+    static long getInkSequence(long ink);                           //!< 返回笔迹句柄的帧序号
+    
+    //! 在保留内容的笔迹层上只显示序号大于 drawnSeq 的新笔迹
+    /*! 每帧的显示量与笔迹长度无关。各笔迹层分别记下已显示到的序号(getInkSequence)，初始为0，
+        因此多个视图或线程可显示同一笔迹。笔迹在 drawnSeq 之后重新开始或已结束时先清除笔迹层。
+        \return 新显示的图形数，-1 表示当前没有增量笔迹
+     */
+    int drawNewInk(long ink, long gs, GiCanvas* canvas, long drawnSeq);
+    
+    //! 在视图的笔迹层上显示新增的笔迹，主线程中用，已显示到的序号由各视图记录
+    int drawNewInk(GiView* view, GiCanvas* canvas);
+    
     int setBkColor(GiView* view, int argb);                         //!< 设置背景颜色
-    static void setScreenDpi(int dpi, float factor = 1.f);          //!< 设置屏幕的点密度和UI放缩系数
+    static void setScreenDpi(int dpi, float factor = 1.f);          //!< 设置新建视图的屏幕点密度和UI放缩系数
+    void setDisplayDpi(int dpi, float factor = 1.f);                //!< 设置本视图的屏幕点密度和UI放缩系数
     void onSize(GiView* view, int w, int h);                        //!< 设置视图的宽高
     void setViewScaleRange(GiView* view, float minScale, float maxScale);   //!< 设置显示比例范围
     void setPenWidthRange(GiView* view, float minw, float maxw);    //!< 设置画笔宽度范围
@@ -52,6 +88,15 @@ public:
     //! 传递单指触摸手势消息
     bool onGesture(GiView* view, GiGestureType type,
             GiGestureState state, float x, float y, bool switchGesture = false);
+    //! 传递一批带时间戳的单指触摸点，用于高采样率的触笔
+    /*! 整批点只显示一次。需要全部点的笔迹命令逐点处理，其余命令只处理按下点和批中最后一点，
+        以免每个采样点都做捕捉、拖动等计算。移动速度由各点的时间间隔算出，不必再调用 setGestureVelocity。
+        \param samples 依次为各点的 x, y 显示坐标和距上一点(含上一批的点)的毫秒间隔，
+            用间隔而不是绝对时间戳，以免 float 表示长时间的时间戳时丢失精度
+        \param state 整批的手势状态，开始时第一点为按下点，结束时最后一点为抬起点
+     */
+    bool onGestureSamples(GiView* view, GiGestureType type, GiGestureState state,
+                          const mgvector<float>& samples, bool switchGesture = false);
     //! 传递双指移动手势(可放缩旋转)
     bool twoFingersMove(GiView* view, GiGestureState state,
             float x1, float y1, float x2, float y2, bool switchGesture = false);
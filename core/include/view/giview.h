@@ -23,6 +23,9 @@ public:
 
     //! 标记视图待追加显示新图形
     virtual void regenAppend(int sid, long playh) {}
+    
+    //! 标记视图待重新显示局部区域(显示坐标)，可用 GiCoreView::drawRegion 只重绘此区域
+    virtual void regenRect(float x, float y, float w, float h) { regenAll(true); }
 
     //! 标记视图待更新显示
     virtual void redraw(bool changed) {}
@@ -47,6 +50,12 @@ public:
     virtual void viewChanged(GiView* oldview) {}    //!< 当前视图改变的通知
     virtual void shapeDeleted(int sid) {}   //!< 删除图形的通知
     
+    //! 批量删除多个图形的通知，默认逐个调用 shapeDeleted
+    virtual void shapesDeleted(const mgvector<int>& ids) {
+        for (int i = 0; i < ids.count(); i++)
+            shapeDeleted(ids.get(i));
+    }
+    
     //! 图形点击的通知，返回false继续显示上下文按钮
     virtual bool shapeClicked(int sid, int tag, float x, float y) { return false; }
     virtual void showMessage(const char* text) {}   //!< 显示提示文字
@@ -6,24 +6,41 @@
 #include <algorithm>
 #include <functional>
 #include "mgaction.h"
+#include "mgsnap.h"
+#include "mgstorage.h"
+#include "mgbasicsp.h"
 #include "mglocal.h"
 
 bool MgCmdErase::cancel(const MgMotion* sender)
 {
     m_boxsel = false;
+    m_cuts.clear();
     bool ret = backStep(sender);
     ret = backStep(sender) || ret;
     return backStep(sender) || ret;
 }
 
-bool MgCmdErase::initialize(const MgMotion*, MgStorage*)
+bool MgCmdErase::initialize(const MgMotion*, MgStorage* s)
 {
+    bool params = s && s->readNode("", -1, false);     // 命令参数在根节点中
+    
+    m_stroke = params && s->readBool("stroke", false);
+    m_radius = params ? s->readFloat("radius", 2.f) : 2.f;
+    if (params) {
+        s->readNode("", -1, true);
+    }
     m_boxsel = false;
+    m_cuts.clear();
     return true;
 }
 
 bool MgCmdErase::backStep(const MgMotion* sender)
 {
+    if (!m_cuts.empty()) {
+        m_cuts.clear();
+        sender->view->redraw();
+        return true;
+    }
     if (!m_delIds.empty()) {
         m_delIds.pop_back();
         sender->view->redraw();
@@ -53,6 +70,9 @@ bool MgCmdErase::draw(const MgMotion* sender, GiGraphics* gs)
             shape->draw(1, *gs, &ctx, -1);
         }
     }
+    if (m_stroke) {
+        drawStrokes(sender, gs, ctx);
+    }
     
     return true;
 }
@@ -66,10 +86,17 @@ const MgShape* MgCmdErase::hitTest(const MgMotion* sender)
 
 bool MgCmdErase::click(const MgMotion* sender)
 {
+    if (m_stroke) {
+        m_cuts.clear();
+        eraseStroke(sender, sender->pointM, sender->pointM);
+        applyStrokes(sender);
+        m_cuts.clear();
+        return true;
+    }
+    
     const MgShape* shape = hitTest(sender);
     if (shape && sender->view->shapeWillDeleted(shape)) {
         if (sender->view->removeShape(shape)) {
-            sender->view->regenAll(true);
             sender->view->showMessage("@shape1_deleted");
         }
     }
@@ -85,7 +112,13 @@ bool MgCmdErase::longPress(const MgMotion* sender)
 
 bool MgCmdErase::touchBegan(const MgMotion* sender)
 {
-    m_boxsel = true;
+    if (m_stroke) {
+        m_cuts.clear();
+        eraseStroke(sender, sender->startPtM, sender->pointM);
+    }
+    else {
+        m_boxsel = true;
+    }
     sender->view->redraw();
     return true;
 }
@@ -99,15 +132,21 @@ bool MgCmdErase::isIntersectMode(const MgMotion*)
 
 bool MgCmdErase::touchMoved(const MgMotion* sender)
 {
+    if (m_stroke) {
+        eraseStroke(sender, sender->lastPtM, sender->pointM);
+        sender->view->redraw();
+        return true;
+    }
+    
     Box2d snap(sender->startPtM, sender->pointM);
-    MgShapeIterator it(m_boxsel ? sender->view->shapes() : NULL);
+    bool intersect = isIntersectMode(sender);
+    int n = m_boxsel ? sender->view->getSnap()->getShapesInBox(sender, snap, intersect, 0, NULL) : 0;
+    std::vector<const MgShape*> shapes(n);
     
+    n = n > 0 ? sender->view->getSnap()->getShapesInBox(sender, snap, intersect, n, &shapes.front()) : 0;
     m_delIds.clear();
-    while (const MgShape* shape = it.getNext()) {
-        if (isIntersectMode(sender) ? shape->shapec()->hitTestBox(snap)
-            : snap.contains(shape->shapec()->getExtent())) {
-            m_delIds.push_back(shape->getID());
-        }
+    for (int i = 0; i < n; i++) {
+        m_delIds.push_back(shapes[i]->getID());
     }
     sender->view->redraw();
     
@@ -118,19 +157,25 @@ bool MgCmdErase::touchEnded(const MgMotion* sender)
 {
     MgShapes* s = sender->view->shapes();
     
+    if (m_stroke) {
+        eraseStroke(sender, sender->lastPtM, sender->pointM);
+        applyStrokes(sender);
+        m_cuts.clear();
+    }
     if (!m_delIds.empty()
         && sender->view->shapeWillDeleted(s->findShape(m_delIds.front()))) {
         int count = 0;
         std::vector<int>::iterator it = m_delIds.begin();
         
+        sender->view->beginBatch();
         for (; it != m_delIds.end(); ++it) {
             const MgShape* shape = s->findShape(*it);
             if (shape && sender->view->removeShape(shape)) {
                 count++;
             }
         }
-        if (count > 0) {
-            sender->view->regenAll(true);
+        sender->view->commitBatch();
+        if (count > 0) {                // removeShape 已标记重新显示所删图形的区域
             char buf[31];
             MgLocalized::formatString(buf, sizeof(buf), sender->view, "@shape_n_deleted", count);
             sender->view->showMessage(buf);
@@ -143,3 +188,418 @@ bool MgCmdErase::touchEnded(const MgMotion* sender)
     
     return true;
 }
+
+// 笔迹橡皮擦：橡皮擦每次移动扫过以移动线段为轴、半径为 r 的胶囊形区域，
+// 累积各折线或曲线被扫过的参数范围，结束时将剩余部分拆分为新图形。
+//
+
+enum { kSplitWhole, kSplitLines, kSplitBeziers };
+
+// 有切矢量的三次样条曲线按贝塞尔段拆分，折线和两点曲线按边拆分，二次样条曲线只能整体删除
+static int splitMode(const MgBaseShape* sp)
+{
+    Point2d bz[4];
+    
+    if (!sp->isKindOf(MgSplines::Type()) || sp->getPointCount() < 3)
+        return kSplitLines;
+    return ((const MgSplines*)sp)->getBezier(0, bz) ? kSplitBeziers : kSplitWhole;
+}
+
+// 求线段 pq 上离线段 ab 不超过 r 的部分的参数范围，即与胶囊形区域相交的部分
+static bool capsuleRange(const Point2d& p, const Point2d& q, const Point2d& a,
+                         const Point2d& b, float r, float& t0, float& t1)
+{
+    Vector2d d(q - p);
+    float dd = d.lengthSquare();
+    Point2d nearpt;
+    
+    if (dd < _MGZERO) {                         // 边退化为点
+        t0 = 0.f;
+        t1 = 1.f;
+        return mglnrel::ptToLine(a, b, p, nearpt) <= r;
+    }
+    
+    float lo = _FLT_MAX, hi = -_FLT_MAX;
+    const Point2d* ends[] = { &a, &b };
+    
+    for (int k = 0; k < 2; k++) {               // 与两端的圆求交
+        Vector2d v(p - *ends[k]);
+        float bh = d.dotProduct(v);
+        float disc = bh * bh - dd * (v.lengthSquare() - r * r);
+        if (disc >= 0.f) {
+            disc = sqrtf(disc);
+            lo = mgMin(lo, (-bh - disc) / dd);
+            hi = mgMax(hi, (-bh + disc) / dd);
+        }
+    }
+    
+    float len = a.distanceTo(b);
+    
+    if (len > _MGZERO) {                        // 与 ab 两侧宽为 r 的矩形带求交
+        Vector2d u((b - a) * (1.f / len));
+        Vector2d n(u.perpVector());
+        Vector2d v(p - a);
+        const float f0[] = { v.dotProduct(u), v.dotProduct(n) };
+        const float f1[] = { d.dotProduct(u), d.dotProduct(n) };
+        const float fmin[] = { 0.f, -r }, fmax[] = { len, r };
+        float s0 = -_FLT_MAX, s1 = _FLT_MAX;
+        bool inside = true;
+        
+        for (int k = 0; k < 2 && inside; k++) {
+            if (fabsf(f1[k]) < _MGZERO) {
+                inside = (f0[k] >= fmin[k] && f0[k] <= fmax[k]);
+            }
+            else {
+                float ta = (fmin[k] - f0[k]) / f1[k];
+                float tb = (fmax[k] - f0[k]) / f1[k];
+                s0 = mgMax(s0, mgMin(ta, tb));
+                s1 = mgMin(s1, mgMax(ta, tb));
+                inside = s0 <= s1;
+            }
+        }
+        if (inside) {
+            lo = mgMin(lo, s0);
+            hi = mgMax(hi, s1);
+        }
+    }
+    
+    t0 = mgMax(lo, 0.f);
+    t1 = mgMin(hi, 1.f);
+    return t0 < t1;
+}
+
+// 得到二次样条曲线的第 j 段二次贝塞尔曲线的控制点，与 GiGraphics::drawQuadSplines 一致
+static bool quadPiece(const MgBaseLines* lines, int j, Point2d q[3])
+{
+    const Point2d* pts = lines->getPoints();
+    int n = lines->getPointCount();
+    bool closed = lines->isClosed();
+    
+    if (closed) {
+        j = (j + n) % n;
+    }
+    else if (j < 0 || j > n - 3) {
+        return false;
+    }
+    q[0] = (!closed && j == 0) ? pts[0] : (pts[j] + pts[(j + 1) % n]) / 2;
+    q[1] = pts[(j + 1) % n];
+    q[2] = (!closed && j + 3 >= n) ? pts[j + 2] : (pts[(j + 1) % n] + pts[(j + 2) % n]) / 2;
+    return true;
+}
+
+struct StrokeEraser {
+    const MgBaseLines*  lines;
+    const MgSplines*    splines;    // 按贝塞尔段拆分的曲线，否则为NULL
+    bool                quad;       // 二次样条曲线，按展开的曲线求交，只能整体删除
+    Point2d             a, b;       // 橡皮擦本次移动的起止点
+    float               r;          // 橡皮擦半径
+    std::vector<float>* cuts;
+};
+
+static bool eraseSegment(int i, void* data)
+{
+    StrokeEraser* e = (StrokeEraser*)data;
+    float t0, t1;
+    
+    if (e->quad) {                              // 第 i 条控制边只影响第 i-1 和第 i 段曲线
+        Point2d q[3], p, pt;
+        
+        for (int k = i - 1; k <= i; k++) {
+            if (!quadPiece(e->lines, k, q))
+                continue;
+            float len = q[0].distanceTo(q[1]) + q[1].distanceTo(q[2]);
+            int m = mgMax(1, mgMin(64, (int)ceilf(2 * len / e->r)));   // 按半径的一半展开为折线
+            
+            p = q[0];
+            for (int j = 1; j <= m; j++, p = pt) {
+                float t = (float)j / m, s = 1.f - t;
+                pt = q[0] * (s * s) + q[1] * (2 * s * t) + q[2] * (t * t);
+                if (capsuleRange(p, pt, e->a, e->b, e->r, t0, t1)) {
+                    e->cuts->push_back((float)i);
+                    e->cuts->push_back(i + 1.f);
+                    return true;
+                }
+            }
+        }
+    }
+    else if (!e->splines) {
+        const Point2d* pts = e->lines->getPoints();
+        int n = e->lines->getPointCount();
+        
+        if (capsuleRange(pts[i], pts[(i + 1) % n], e->a, e->b, e->r, t0, t1)) {
+            e->cuts->push_back(i + t0);
+            e->cuts->push_back(i + t1);
+        }
+    }
+    else {
+        Point2d bz[4], p, q;
+        
+        e->splines->getBezier(i, bz);
+        float len = bz[0].distanceTo(bz[1]) + bz[1].distanceTo(bz[2]) + bz[2].distanceTo(bz[3]);
+        int m = mgMax(1, mgMin(64, (int)ceilf(2 * len / e->r)));   // 按半径的一半展开为折线求交
+        
+        p = bz[0];
+        for (int j = 1; j <= m; j++, p = q) {
+            mgcurv::fitBezier(bz, (float)j / m, q);
+            if (capsuleRange(p, q, e->a, e->b, e->r, t0, t1)) {
+                e->cuts->push_back(i + (j - 1 + t0) / m);
+                e->cuts->push_back(i + (j - 1 + t1) / m);
+            }
+        }
+    }
+    return true;
+}
+
+// 将参数范围排序并合并重叠部分
+static void mergeRanges(std::vector<float>& cuts)
+{
+    std::vector<std::pair<float, float> > ranges;
+    size_t i, n = 0;
+    
+    for (i = 0; i + 1 < cuts.size(); i += 2) {
+        ranges.push_back(std::pair<float, float>(cuts[i], cuts[i + 1]));
+    }
+    std::sort(ranges.begin(), ranges.end());
+    for (i = 0; i < ranges.size(); i++) {
+        if (n > 0 && ranges[i].first <= ranges[n - 1].second)
+            ranges[n - 1].second = mgMax(ranges[n - 1].second, ranges[i].second);
+        else
+            ranges[n++] = ranges[i];
+    }
+    cuts.resize(2 * n);
+    for (i = 0; i < n; i++) {
+        cuts[2 * i] = ranges[i].first;
+        cuts[2 * i + 1] = ranges[i].second;
+    }
+}
+
+// 由擦除范围得到剩余范围，闭合图形首尾相接的两段合为一段，其结束参数超过边数
+static void remainRanges(const std::vector<float>& cuts, int n, bool closed, std::vector<float>& pieces)
+{
+    float from = 0.f;
+    
+    for (size_t i = 0; i + 1 < cuts.size(); i += 2) {
+        if (cuts[i] > from) {
+            pieces.push_back(from);
+            pieces.push_back(cuts[i]);
+        }
+        from = mgMax(from, cuts[i + 1]);
+    }
+    if (from < n) {
+        pieces.push_back(from);
+        pieces.push_back((float)n);
+    }
+    if (closed && pieces.size() >= 4 && pieces.front() == 0.f && pieces.back() == (float)n) {
+        pieces.back() = n + pieces[1];
+        pieces.erase(pieces.begin(), pieces.begin() + 2);
+    }
+}
+
+// 得到参数范围内的折线顶点或贝塞尔控制点
+static void rangeGeometry(const MgBaseLines* lines, const MgSplines* splines,
+                          float u0, float u1, std::vector<Point2d>& pts)
+{
+    const Point2d* vertexes = lines->getPoints();
+    int n = lines->getSegmentCount();
+    Point2d bz[4], seg[7];              // splitBezier 分出的两段共用中间点
+    
+    for (int i = (int)u0; i < u1; i++) {
+        float a = mgMax(u0 - i, 0.f), b = mgMin(u1 - i, 1.f);
+        int k = i % n;
+        
+        if (splines) {
+            const Point2d* part = seg;
+            
+            splines->getBezier(k, bz);
+            mgcurv::splitBezier(bz, b, seg, seg + 3);       // seg[0..3] 为 [0,b] 段
+            if (a > 0.f) {
+                for (int j = 0; j < 4; j++)
+                    bz[j] = seg[j];
+                mgcurv::splitBezier(bz, a / b, seg, seg + 3);   // seg[3..6] 为 [a,b] 段
+                part = seg + 3;
+            }
+            if (pts.empty())
+                pts.push_back(part[0]);
+            pts.insert(pts.end(), part + 1, part + 4);
+        }
+        else {
+            const Point2d& p = vertexes[k];
+            Vector2d d(vertexes[(k + 1) % lines->getPointCount()] - p);
+            
+            if (pts.empty())
+                pts.push_back(p + d * a);
+            pts.push_back(p + d * b);
+        }
+    }
+}
+
+static float pathLength(const std::vector<Point2d>& pts)
+{
+    float len = 0.f;
+    for (size_t i = 1; i < pts.size(); i++)
+        len += pts[i - 1].distanceTo(pts[i]);
+    return len;
+}
+
+static MgShape* createPiece(const MgShape* oldsp, std::vector<Point2d>& pts, bool curve)
+{
+    MgShape* newsp = oldsp->cloneShape();
+    MgBaseLines* lines = (MgBaseLines*)newsp->shape();
+    
+    lines->setClosed(false);
+    if (curve) {
+        if (pts.size() == 4) {          // 两个型值点的曲线显示为直线，从中间分为两段
+            Point2d bz[7];
+            mgcurv::splitBezier(&pts.front(), 0.5f, bz, bz + 3);
+            pts.assign(bz, bz + 7);
+        }
+        ((MgSplines*)lines)->setBeziers((int)pts.size(), &pts.front());
+    }
+    else {
+        lines->resize((int)pts.size());
+        for (int i = 0; i < (int)pts.size(); i++)
+            lines->setPoint(i, pts[i]);
+    }
+    lines->update();
+    
+    return newsp;
+}
+
+void MgCmdErase::eraseStroke(const MgMotion* sender, const Point2d& from, const Point2d& to)
+{
+    StrokeEraser e;
+    Box2d box(from, to);
+    MgSnap* snap = sender->view->getSnap();
+    
+    e.a = from;
+    e.b = to;
+    e.r = sender->displayMmToModel(m_radius);
+    box.inflate(e.r);
+    
+    int n = snap->getShapesInBox(sender, box, true, 0, NULL);
+    std::vector<const MgShape*> shapes(n);
+    
+    n = n > 0 ? snap->getShapesInBox(sender, box, true, n, &shapes.front()) : 0;
+    for (int i = 0; i < n; i++) {
+        const MgBaseShape* sp = shapes[i]->shapec();
+        
+        if (!sp->isKindOf(MgBaseLines::Type()) || sp->getFlag(kMgShapeLocked)) {
+            continue;
+        }
+        Ranges& cuts = m_cuts[shapes[i]->getID()];
+        size_t count = cuts.size();
+        
+        e.lines = (const MgBaseLines*)sp;
+        e.splines = splitMode(sp) == kSplitBeziers ? (const MgSplines*)sp : NULL;
+        e.quad = splitMode(sp) == kSplitWhole;
+        e.cuts = &cuts;
+        e.lines->traverseSegments(box, eraseSegment, &e);   // 长笔迹由各边的包络框索引查找
+        
+        if (cuts.empty())
+            m_cuts.erase(shapes[i]->getID());
+        else if (cuts.size() > count)
+            mergeRanges(cuts);
+    }
+}
+
+void MgCmdErase::drawStrokes(const MgMotion* sender, GiGraphics* gs, const GiContext& ctx)
+{
+    std::vector<Point2d> pts;
+    
+    for (std::map<int, Ranges>::const_iterator it = m_cuts.begin(); it != m_cuts.end(); ++it) {
+        const MgShape* shape = sender->view->shapes()->findShape(it->first);
+        if (!shape) {
+            continue;
+        }
+        const MgBaseLines* lines = (const MgBaseLines*)shape->shapec();
+        int mode = splitMode(lines);
+        
+        if (mode == kSplitWhole) {
+            shape->draw(1, *gs, &ctx, -1);
+            continue;
+        }
+        for (size_t i = 0; i + 1 < it->second.size(); i += 2) {
+            pts.clear();
+            rangeGeometry(lines, mode == kSplitBeziers ? (const MgSplines*)lines : NULL,
+                          it->second[i], it->second[i + 1], pts);
+            if (mode == kSplitBeziers) {
+                gs->drawBeziers(&ctx, (int)pts.size(), &pts.front());
+            }
+            else {
+                gs->drawLines(&ctx, (int)pts.size(), &pts.front());
+            }
+        }
+    }
+    if (sender->dragging()) {
+        GiContext ctxeraser(0, GiColor(0, 0, 255, 80), GiContext::kSolidLine, GiColor(0, 0, 255, 24));
+        gs->drawCircle(&ctxeraser, sender->pointM, sender->displayMmToModel(m_radius));
+    }
+}
+
+int MgCmdErase::applyStrokes(const MgMotion* sender)
+{
+    MgView* view = sender->view;
+    const float minlen = sender->displayMmToModel(0.5f);  // 忽略擦除后残留的碎段
+    std::vector<float> pieces;
+    std::vector<Point2d> pts;
+    std::vector<MgShape*> newsps;
+    int count = 0;
+    
+    view->beginBatch();
+    for (std::map<int, Ranges>::const_iterator it = m_cuts.begin(); it != m_cuts.end(); ++it) {
+        const MgShape* oldsp = view->shapes()->findShape(it->first);
+        if (!oldsp) {
+            continue;
+        }
+        const MgBaseLines* lines = (const MgBaseLines*)oldsp->shapec();
+        int mode = splitMode(lines);
+        
+        pieces.clear();
+        newsps.clear();
+        if (mode != kSplitWhole) {
+            remainRanges(it->second, lines->getSegmentCount(), lines->isClosed(), pieces);
+        }
+        for (size_t i = 0; i + 1 < pieces.size(); i += 2) {
+            pts.clear();
+            rangeGeometry(lines, mode == kSplitBeziers ? (const MgSplines*)lines : NULL,
+                          pieces[i], pieces[i + 1], pts);
+            if (pts.size() > 1 && pathLength(pts) >= minlen) {
+                newsps.push_back(createPiece(oldsp, pts, mode == kSplitBeziers));
+            }
+        }
+        
+        if (newsps.empty()) {
+            if (view->shapeWillDeleted(oldsp) && view->removeShape(oldsp)) {
+                count++;
+            }
+            continue;
+        }
+        
+        // 第一段保留原图形号，其余段添加为新图形
+        bool changed = view->shapeWillChanged(newsps[0], oldsp);
+        
+        if (changed) {
+            view->regenShape(oldsp);
+            changed = view->shapes()->updateShape(newsps[0]);
+        }
+        if (changed) {
+            view->shapeChanged(newsps[0]);
+            count++;
+        }
+        else {
+            newsps[0]->release();
+        }
+        for (size_t i = 1; i < newsps.size(); i++) {
+            if (changed && view->shapeWillAdded(newsps[i])
+                && view->shapes()->addShapeDirect(newsps[i])) {
+                view->shapeAdded(newsps[i]);
+            }
+            else {
+                newsps[i]->release();
+            }
+        }
+    }
+    view->commitBatch();
+    
+    return count;
+}
@@ -8,9 +8,12 @@
 
 #include "mgcmd.h"
 #include <vector>
+#include <map>
 
 //! 橡皮擦命令类
-/*! \ingroup CORE_COMMAND
+/*! 命令参数 stroke 为 true 时擦除折线和曲线笔迹中橡皮擦经过的部分，
+    其余部分拆分为新图形；radius 为橡皮擦半径(屏幕毫米)。
+    \ingroup CORE_COMMAND
 */
 class MgCmdErase : public MgCommand
 {
@@ -19,7 +22,7 @@ public:
     static MgCommand* Create() { return new MgCmdErase; }
     
 private:
-    MgCmdErase() : MgCommand(Name()) {}
+    MgCmdErase() : MgCommand(Name()), m_boxsel(false), m_stroke(false), m_radius(2.f) {}
     virtual void release() { delete this; }
     virtual bool cancel(const MgMotion* sender);
     virtual bool initialize(const MgMotion* sender, MgStorage* s);
@@ -35,9 +38,17 @@ private:
     int getStep() { return 0; }
     const MgShape* hitTest(const MgMotion* sender);
     bool isIntersectMode(const MgMotion* sender);
+    void eraseStroke(const MgMotion* sender, const Point2d& from, const Point2d& to);
+    int applyStrokes(const MgMotion* sender);
+    void drawStrokes(const MgMotion* sender, GiGraphics* gs, const GiContext& ctx);
+    
+    typedef std::vector<float> Ranges;  // 依次为各段的起止参数，整数部分为边号，小数部分为边内参数
     
     std::vector<int>     m_delIds;
     bool                    m_boxsel;
+    bool                    m_stroke;       // 是否只擦除笔迹经过的部分
+    float                   m_radius;       // 橡皮擦半径，屏幕毫米
+    std::map<int, Ranges>   m_cuts;         // 各图形已擦除的参数范围
 };
 
 #endif // TOUCHVG_CMD_ERASE_H_
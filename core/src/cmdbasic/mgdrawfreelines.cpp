@@ -5,9 +5,27 @@
 #include "mgdrawfreelines.h"
 #include "mgshapet.h"
 #include "mgbasicsp.h"
+#include "mgsnap.h"
+#include "mgstorage.h"
 
-bool MgCmdDrawFreeLines::initialize(const MgMotion* sender, MgStorage*)
+MgCmdDrawFreeLines::~MgCmdDrawFreeLines()
 {
+    MgObject::release_pointer(m_fitted);
+}
+
+bool MgCmdDrawFreeLines::initialize(const MgMotion* sender, MgStorage* s)
+{
+    bool params = s && s->readNode("", -1, false);     // 命令参数在根节点中
+    
+    m_smooth = params && s->readBool("smooth", false);
+    m_predict = params ? s->readInt("predict", 0) : 0;
+    if (params) {
+        s->readNode("", -1, true);
+    }
+    if (m_smooth && !m_fitted) {
+        m_fitted = MgShapeT<MgSplines>::create();
+        m_fitted->setParent(sender->view->shapes(), 0);
+    }
     return _initialize(MgShapeT<MgLines>::create, sender);
 }
 
@@ -16,22 +34,141 @@ bool MgCmdDrawFreeLines::backStep(const MgMotion* sender)
     if (m_step > 2) {                   // 去掉倒数第二个点，倒数第一点是临时动态点
         ((MgBaseLines*)dynshape()->shape())->removePoint(m_step - 1);
         dynshape()->shape()->update();
+        m_inkCount = -1;
     }
     return MgCommandDraw::backStep(sender);
 }
 
 bool MgCmdDrawFreeLines::draw(const MgMotion* sender, GiGraphics* gs)
 {
+    if (m_smooth && m_step > 0) {
+        bool ret = m_fitted->draw(0, *gs, NULL, -1);
+        return sender->view->getSnap()->drawSnap(sender, gs) || ret;
+    }
     return MgCommandDraw::draw(sender, gs);
 }
 
+bool MgCmdDrawFreeLines::gatherShapes(const MgMotion* sender, MgShapes* shapes)
+{
+    if (m_smooth) {
+        if (m_step > 0 && m_fitted->shapec()->getPointCount() > 0) {
+            shapes->addShape(*m_fitted);
+        }
+        return false;
+    }
+    return MgCommandDraw::gatherShapes(sender, shapes);
+}
+
+int MgCmdDrawFreeLines::gatherInk(const MgMotion* sender, MgShapes* newInk, MgShapes* shapes)
+{
+    const GiContext& ctx = dynshape()->context();
+    
+    // 闭合时首末点相连，整体显示。分段显示时半透明笔迹在接头处叠加变深、虚线在接头处重新开始，
+    // 因此只有不透明的实线使用增量笔迹
+    if (m_step < 1 || dynshape()->shapec()->isClosed()
+        || ctx.getLineStyle() != GiContext::kSolidLine || ctx.getLineAlpha() < 255) {
+        m_inkCount = -1;
+        return 0;
+    }
+    
+    int ret = m_inkCount < 0 ? 2 : 1;
+    
+    if (ret == 2) {
+        m_inkCount = 0;
+    }
+    if (m_smooth) {
+        int fixed = m_fitter.getFixedCount();
+        addBeziers(newInk, m_inkCount, fixed);
+        addBeziers(shapes, fixed, m_fitter.getSegmentCount());
+        m_inkCount = fixed;
+    }
+    else {                              // 末点为临时动态点，之前的点不再改变
+        // 各段向前多取一段重叠显示，使接头处的折角与整条折线相同
+        addLines(newInk, mgMax(m_inkCount - 2, 0), m_step - 1);
+        addLines(shapes, mgMax(m_step - 2, 0), dynshape()->shapec()->getPointCount() - 1);
+        m_inkCount = m_step;
+    }
+    
+    if (m_predict > 0 && !sender->velocity.isZeroVector()) {
+        MgShape* sp = MgShapeT<MgLines>::create();
+        MgBaseLines* lines = (MgBaseLines*)sp->shape();
+        
+        sp->setContext(dynshape()->context());
+        lines->resize(2);
+        lines->setPoint(0, sender->pointM);
+        lines->setPoint(1, sender->predictPointM((float)m_predict, 5.f));  // 预测段不超过5毫米
+        shapes->addShapeDirect(sp);
+    }
+    
+    return ret;
+}
+
+void MgCmdDrawFreeLines::addLines(MgShapes* shapes, int from, int to)
+{
+    if (from < to) {
+        MgShape* sp = MgShapeT<MgLines>::create();
+        MgBaseLines* lines = (MgBaseLines*)sp->shape();
+        
+        sp->setContext(dynshape()->context());
+        lines->resize(to - from + 1);
+        for (int i = from; i <= to; i++) {
+            lines->setPoint(i - from, dynshape()->shapec()->getPoint(i));
+        }
+        shapes->addShapeDirect(sp);
+    }
+}
+
+void MgCmdDrawFreeLines::addBeziers(MgShapes* shapes, int from, int to)
+{
+    if (from < to) {
+        MgShape* sp = MgShapeT<MgSplines>::create();
+        
+        sp->setContext(dynshape()->context());
+        ((MgSplines*)sp->shape())->setBeziers(1 + 3 * (to - from),
+                                              m_fitter.getControlPoints() + 3 * from);
+        shapes->addShapeDirect(sp);
+    }
+}
+
+void MgCmdDrawFreeLines::updateFitted()
+{
+    MgSplines* splines = (MgSplines*)m_fitted->shape();
+    int from = m_fittedFixed;           // 此前已确定的段不变，只替换其后的段
+    
+    splines->setClosed(dynshape()->shapec()->isClosed());   // 设置贝塞尔段时重新生成缓存
+    if (m_fitter.getSegmentCount() < 1) {
+        splines->clear();
+        splines->update();
+        from = -1;
+    }
+    else if (from > 0 && from < splines->getPointCount()) {
+        splines->setTailBeziers(from, 1 + 3 * (m_fitter.getSegmentCount() - from),
+                                m_fitter.getControlPoints() + 3 * from);
+    }
+    else {
+        splines->setBeziers(1 + 3 * m_fitter.getSegmentCount(), m_fitter.getControlPoints());
+    }
+    m_fittedFixed = from < 0 ? 0 : m_fitter.getFixedCount();
+}
+
 bool MgCmdDrawFreeLines::touchBegan(const MgMotion* sender)
 {
     ((MgBaseLines*)dynshape()->shape())->resize(2);
     m_step = 1;
+    m_inkCount = -1;
     dynshape()->shape()->setPoint(0, sender->startPtM);
     dynshape()->shape()->setPoint(1, sender->pointM);
     dynshape()->shape()->update();
+    
+    if (m_smooth) {                     // 拟合容差为0.2毫米
+        m_fitted->setContext(dynshape()->context());
+        m_fitter.clear();
+        m_fittedFixed = 0;
+        m_fitter.setTolerance(sender->displayMmToModel(0.2f));
+        m_fitter.addPoint(sender->startPtM);
+        m_fitter.addPoint(sender->pointM);
+        updateFitted();
+    }
 
     return MgCommandDraw::touchBegan(sender);
 }
@@ -61,8 +198,14 @@ bool MgCmdDrawFreeLines::touchMoved(const MgMotion* sender)
                 ((MgBaseLines*)dynshape()->shape())->addPoint(sender->pointM);
             }
         }
+        if (m_smooth) {
+            m_fitter.addPoint(sender->pointM);
+        }
     }
     dynshape()->shape()->update();
+    if (m_smooth) {
+        updateFitted();
+    }
 
     return MgCommandDraw::touchMoved(sender);
 }
@@ -88,10 +231,22 @@ bool MgCmdDrawFreeLines::touchEnded(const MgMotion* sender)
         dynshape()->shape()->setPoint(m_step, sender->pointM);
         if (m_step > 0 && !canAddPoint(sender, true))
             lines->removePoint(m_step);
+        if (m_smooth) {
+            m_fitter.addPoint(sender->pointM);
+        }
     }
     dynshape()->shape()->update();
     
-    if (m_step > 1) {
+    if (m_step > 1 && m_smooth) {
+        updateFitted();
+        m_fitted->shape()->update();    // 按全部型值点重新计算范围
+        MgShape* newsp = addShape(sender, m_fitted);
+        if (newsp) {
+            dynshape()->shape()->clear();
+            sender->view->regenAppend(newsp->getID());
+        }
+    }
+    else if (m_step > 1) {
         addShape(sender);
     }
     else {
@@ -6,45 +6,77 @@
 #include "cmdsubject.h"
 #include <vector>
 
+// 事件在观察者列表数组中的序号，与 CmdEventMask 的位序一致
+enum {
+    kDocLoaded, kEnterSelect, kUnloadCommands, kActionsNeedHided,
+    kAddShapeActions, kDoAction, kDoEndAction, kDrawInShapeCmd,
+    kDrawInSelectCmd, kSelectTouchEnded, kShapesChanged, kShapeWillAdded,
+    kShapeAdded, kShapeWillDeleted, kShapeDeleted, kShapeCanRotated,
+    kShapeCanTransform, kShapeCanUnlock, kShapeCanUngroup, kShapeMoved,
+    kShapeWillChanged, kCreateShape, kCreateCommand, kPreGesture,
+    kPostGesture, kEventCount
+};
+
 class CmdSubjectImpl : public CmdSubject
 {
 public:
-    CmdSubjectImpl() {}
+    CmdSubjectImpl() : _mask(0) {}
 
 private:
     virtual void registerObserver(CmdObserver* observer) {
+        registerObserver(observer, kCmdEventAll);
+    }
+    virtual void registerObserver(CmdObserver* observer, int events) {
         if (observer) {
             unregisterObserver(observer);
             _arr.push_back(observer);
+            for (int i = 0; i < kEventCount; i++) {
+                if (events & (1 << i)) {
+                    _lists[i].push_back(observer);
+                    _mask |= 1 << i;
+                }
+            }
         }
     }
     virtual void unregisterObserver(CmdObserver* observer) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
-            if (*it == observer) {
-                _arr.erase(it);
-                break;
+        if (!remove(_arr, observer)) {
+            return;
+        }
+        for (int i = 0; i < kEventCount; i++) {
+            if (remove(_lists[i], observer) && _lists[i].empty()) {
+                _mask &= ~(1 << i);
             }
         }
     }
+    virtual bool hasObserver(int events) const {
+        return (_mask & events) != 0;
+    }
     virtual void onDocLoaded(const MgMotion* sender) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kDocLoaded];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             (*it)->onDocLoaded(sender);
         }
     }
     virtual void onEnterSelectCommand(const MgMotion* sender) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kEnterSelect];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             (*it)->onEnterSelectCommand(sender);
         }
     }
     virtual void onUnloadCommands(MgCmdManager* sender) {
-        Observers arr(_arr);
+        Observers arr(_lists[kUnloadCommands]);
         _arr.clear();
+        for (int i = 0; i < kEventCount; i++) {
+            _lists[i].clear();
+        }
+        _mask = 0;
         for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             (*it)->onUnloadCommands(sender);
         }
     }
     virtual bool selectActionsNeedHided(const MgMotion* sender) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kActionsNeedHided];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             if ((*it)->selectActionsNeedHided(sender)) {
                 return true;
             }
@@ -53,20 +85,23 @@ private:
     }
     virtual int addShapeActions(const MgMotion* sender,
         mgvector<int>& actions, int n, const MgShape* shape) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kAddShapeActions];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             n = (*it)->addShapeActions(sender, actions, n, shape);
         }
         return n;
     }
     virtual bool doAction(const MgMotion* sender, int action) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kDoAction];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             if ((*it)->doAction(sender, action))
                 return true;
         }
         return false;
     }
     virtual bool doEndAction(const MgMotion* sender, int action) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kDoEndAction];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             if ((*it)->doEndAction(sender, action))
                 return true;
         }
@@ -74,13 +109,15 @@ private:
     }
     virtual void drawInShapeCommand(const MgMotion* sender, 
         MgCommand* cmd, GiGraphics* gs) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kDrawInShapeCmd];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             (*it)->drawInShapeCommand(sender, cmd, gs);
         }
     }
     virtual void drawInSelectCommand(const MgMotion* sender, 
         const MgShape* shape, int handleIndex, GiGraphics* gs) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kDrawInSelectCmd];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             (*it)->drawInSelectCommand(sender, shape, handleIndex, gs);
         }
     }
@@ -88,14 +125,24 @@ private:
         int handleIndex, int snapid, int snapHandle,
         int count, const int* ids)
     {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kSelectTouchEnded];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             (*it)->onSelectTouchEnded(sender, shapeid, 
                 handleIndex, snapid, snapHandle, count, ids);
         }
     }
+    virtual void onShapesChanged(const MgMotion* sender, int addedCount,
+        int changedCount, int deletedCount, const int* ids)
+    {
+        Observers& arr = _lists[kShapesChanged];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
+            (*it)->onShapesChanged(sender, addedCount, changedCount, deletedCount, ids);
+        }
+    }
 
     virtual bool onShapeWillAdded(const MgMotion* sender, MgShape* shape) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kShapeWillAdded];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             if (!(*it)->onShapeWillAdded(sender, shape)) {
                 return false;
             }
@@ -103,12 +150,14 @@ private:
         return true;
     }
     virtual void onShapeAdded(const MgMotion* sender, const MgShape* shape) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kShapeAdded];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             (*it)->onShapeAdded(sender, shape);
         }
     }
     virtual bool onShapeWillDeleted(const MgMotion* sender, const MgShape* shape) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kShapeWillDeleted];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             if (!(*it)->onShapeWillDeleted(sender, shape)) {
                 return false;
             }
@@ -116,12 +165,14 @@ private:
         return true;
     }
     virtual void onShapeDeleted(const MgMotion* sender, const MgShape* shape) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kShapeDeleted];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             (*it)->onShapeDeleted(sender, shape);
         }
     }
     virtual bool onShapeCanRotated(const MgMotion* sender, const MgShape* shape) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kShapeCanRotated];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             if (!(*it)->onShapeCanRotated(sender, shape)) {
                 return false;
             }
@@ -129,7 +180,8 @@ private:
         return true;
     }
     virtual bool onShapeCanTransform(const MgMotion* sender, const MgShape* shape) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kShapeCanTransform];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             if (!(*it)->onShapeCanTransform(sender, shape)) {
                 return false;
             }
@@ -137,7 +189,8 @@ private:
         return true;
     }
     virtual bool onShapeCanUnlock(const MgMotion* sender, const MgShape* shape) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kShapeCanUnlock];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             if (!(*it)->onShapeCanUnlock(sender, shape)) {
                 return false;
             }
@@ -145,7 +198,8 @@ private:
         return true;
     }
     virtual bool onShapeCanUngroup(const MgMotion* sender, const MgShape* shape) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kShapeCanUngroup];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             if (!(*it)->onShapeCanUngroup(sender, shape)) {
                 return false;
             }
@@ -153,12 +207,23 @@ private:
         return true;
     }
     virtual void onShapeMoved(const MgMotion* sender, MgShape* shape, int segment) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kShapeMoved];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             (*it)->onShapeMoved(sender, shape, segment);
         }
     }
+    virtual void onShapesMoved(const MgMotion* sender, int count,
+                               MgShape* const* shapes, int segment) {
+        Observers& arr = _lists[kShapeMoved];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
+            for (int i = 0; i < count; i++) {
+                (*it)->onShapeMoved(sender, shapes[i], segment);
+            }
+        }
+    }
     virtual bool onShapeWillChanged(const MgMotion* sender, MgShape* sp, const MgShape* oldsp) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kShapeWillChanged];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             if (!(*it)->onShapeWillChanged(sender, sp, oldsp)) {
                 return false;
             }
@@ -167,23 +232,26 @@ private:
     }
 
     virtual MgBaseShape* createShape(const MgMotion* sender, int type) {
+        Observers& arr = _lists[kCreateShape];
         MgBaseShape* sp = (MgBaseShape*)0;
-        for (Iterator it = _arr.begin(); !sp && it != _arr.end(); ++it) {
+        for (Iterator it = arr.begin(); !sp && it != arr.end(); ++it) {
             sp = (*it)->createShape(sender, type);
         }
         return sp;
     }
 
     virtual MgCommand* createCommand(const MgMotion* sender, const char* name) {
+        Observers& arr = _lists[kCreateCommand];
         MgCommand* cmd = (MgCommand*)0;
-        for (Iterator it = _arr.begin(); !cmd && it != _arr.end(); ++it) {
+        for (Iterator it = arr.begin(); !cmd && it != arr.end(); ++it) {
             cmd = (*it)->createCommand(sender, name);
         }
         return cmd;
     }
     
     virtual bool onPreGesture(MgMotion* sender) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kPreGesture];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             if (!(*it)->onPreGesture(sender)) {
                 return false;
             }
@@ -192,7 +260,8 @@ private:
     }
     
     virtual void onPostGesture(const MgMotion* sender) {
-        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+        Observers& arr = _lists[kPostGesture];
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
             (*it)->onPostGesture(sender);
         }
     }
@@ -200,7 +269,20 @@ private:
 private:
     typedef std::vector<CmdObserver*> Observers;
     typedef Observers::iterator Iterator;
-    Observers _arr;
+
+    static bool remove(Observers& arr, CmdObserver* observer) {
+        for (Iterator it = arr.begin(); it != arr.end(); ++it) {
+            if (*it == observer) {
+                arr.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Observers   _arr;                   // 所有已注册的观察者
+    Observers   _lists[kEventCount];    // 各事件的观察者，按注册顺序
+    int         _mask;                  // 有观察者的事件
 };
 
 CmdSubject* MgCmdManagerImpl::getCmdSubject()
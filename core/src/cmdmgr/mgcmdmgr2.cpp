@@ -85,14 +85,15 @@ void MgCmdManagerImpl::eraseWnd(const MgMotion* sender)
         std::vector<int>::iterator i = delIds.begin();
         int n = 0;
         
+        sender->view->beginBatch();
         for (; i != delIds.end(); ++i) {
             const MgShape* shape = s->findShape(*i);
             if (shape && sender->view->removeShape(shape)) {
                 n++;
             }
         }
-        if (n > 0) {
-            sender->view->regenAll(true);
+        sender->view->commitBatch();
+        if (n > 0) {                    // removeShape 已标记重新显示所删图形的区域
             char buf[31];
             MgLocalized::formatString(buf, sizeof(buf), sender->view, "@shape_n_deleted", n);
             sender->view->showMessage(buf);
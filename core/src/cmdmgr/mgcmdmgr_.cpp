@@ -47,6 +47,7 @@ void MgCmdManagerImpl::unloadCommands()
     _cmdname = "";
     getCmdSubject()->onUnloadCommands(this);
     freeSubject();
+    freeSnapIndex();
 }
 
 const char* MgCmdManagerImpl::getCommandName()
@@ -162,9 +163,6 @@ bool MgCmdManagerImpl::setCommand(const MgMotion* sender,
         _cmdname = "";
     }
     
-    if (MgBaseShape::minTol().equalPoint() < 1e-5) {
-        MgBaseShape::minTol().setEqualPoint(sender->view->xform()->displayToModel(1.f, true));
-    }
     if (oldname != _cmdname) {
         sender->view->commandChanged();
     }
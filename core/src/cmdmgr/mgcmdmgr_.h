@@ -13,6 +13,7 @@
 #include <string>
 
 class SnapItem;
+class MgSnapIndex;
 class CmdSubjectImpl;
 
 //! 命令管理器实现类
@@ -65,6 +66,8 @@ private:
     virtual int getSnappedType();
     virtual int getSnappedPoint(Point2d& fromPt, Point2d& toPt);
     virtual bool getSnappedHandle(int& shapeid, int& handleIndex, int& handleIndexSrc);
+    virtual int getShapesInBox(const MgMotion* sender, const Box2d& box, bool intersect,
+                               int count, const MgShape** shapes);
     virtual void clearSnap(const MgMotion* sender);
     
     virtual bool showInSelect(const MgMotion* sender, int selState, const MgShape* shape, const Box2d& selbox);
@@ -74,6 +77,8 @@ private:
 private:
     void eraseWnd(const MgMotion* sender);
     void checkResult(SnapItem arr[3]);
+    MgSnapIndex* getSnapIndex(const MgMotion* sender);
+    void freeSnapIndex();
     void freeSubject();
 
 private:
@@ -92,6 +97,7 @@ private:
     int             _snapShapeId;
     int             _snapHandle;
     int             _snapHandleSrc;
+    std::map<int, MgSnapIndex*> _snapIndex;     // 各图层的捕捉索引
 };
 
 #endif // TOUCHVG_CMD_MANAGER_IMPL_H_
@@ -41,6 +41,7 @@ int MgCmdSelect::getSelection(MgView* view, int count, const MgShape** shapes)
         }
     }
     else {
+        applyCloneMatrices();           // 返回拖动中的实际位置
         for (i = 0; i < count; i++) {
             shapes[ret++] = m_clones[i];
         }
@@ -53,6 +54,7 @@ int MgCmdSelect::getSelectionForChange(MgView* view, int count, MgShape** shapes
 {
     if (m_clones.empty())
         cloneShapes(view);
+    applyCloneMatrices();
     
     int i, ret = 0;
     int maxCount = (int)m_clones.size();
@@ -101,6 +103,7 @@ bool MgCmdSelect::initialize(const MgMotion* sender, MgStorage*)
     m_rotateHandle = 0;
     m_editMode = false;
     m_showSel = true;
+    m_clonesMoved = false;
     m_selIds.clear();
     
     sender->view->getCmdSubject()->onEnterSelectCommand(sender);
@@ -128,6 +131,7 @@ bool MgCmdSelect::backStep(const MgMotion* sender)
             (*it)->release();
         }
         m_clones.clear();
+        m_cloneMats.clear();
         m_insertPt = false;
         sender->view->redraw();
         return true;
@@ -186,8 +190,15 @@ bool MgCmdSelect::draw(const MgMotion* sender, GiGraphics* gs)
     
     // 外部动态改变图形属性时，或拖动时
     if (!m_showSel || !m_clones.empty()) {
-        for (it = shapes.begin(); it != shapes.end(); ++it) {
-            (*it)->draw(m_showSel ? 2 : 0, *gs, NULL, -1);  // 原样显示
+        for (size_t i = 0; i < shapes.size(); i++) {
+            if (i < m_cloneMats.size() && !m_cloneMats[i].isIdentity()) {
+                GiSaveModelTransform xf(&gs->xf(), gs->xf().worldToModel()  // 按待定变换显示
+                                        * m_cloneMats[i] * gs->xf().modelToWorld());
+                shapes[i]->draw(m_showSel ? 2 : 0, *gs, NULL, -1);
+            }
+            else {
+                shapes[i]->draw(m_showSel ? 2 : 0, *gs, NULL, -1);  // 原样显示
+            }
         }
     }
     else if (m_clones.empty()) {                    // 蓝色显示选中的图形
@@ -714,11 +725,11 @@ bool MgCmdSelect::isDragRectCorner(const MgMotion* sender, Matrix2d& mat)
     return m_boxHandle < 10;
 }
 
-static bool moveIntoLimits(MgBaseShape* shape, const MgMotion* sender)
+static bool moveIntoLimits(const Box2d& extent, const MgMotion* sender, Vector2d& vec)
 {
     Box2d limits(sender->view->xform()->getWorldLimits()
                  * sender->view->xform()->worldToModel());
-    Box2d rect(shape->getExtent());
+    Box2d rect(extent);
     bool outside = false;
     
     limits.normalize();
@@ -738,15 +749,115 @@ static bool moveIntoLimits(MgBaseShape* shape, const MgMotion* sender)
         rect.offset(0, limits.ymax - rect.ymax);
         outside = true;
     }
+    vec = rect.center() - extent.center();
+    
+    return outside;
+}
+
+static bool moveIntoLimits(MgBaseShape* shape, const MgMotion* sender)
+{
+    Vector2d vec;
+    bool outside = moveIntoLimits(shape->getExtent(), sender, vec);
     
     if (outside) {
-        shape->offset(rect.center() - shape->getExtent().center(), -1);
+        shape->offset(vec, -1);
         shape->update();
     }
     
     return outside;
 }
 
+// 拖动很多图形时只有这些图形参与捕捉，其余图形只记下变换矩阵
+bool MgCmdSelect::isSnapClone(size_t index) const
+{
+    return m_clones.size() <= 16 || index == 0 || m_clones[index]->getID() == m_id;
+}
+
+void MgCmdSelect::dragClones(const MgMotion* sender, const Point2d& pointM)
+{
+    Vector2d vec(pointM - m_ptStart);
+    Vector2d minsnap(1e8f, 1e8f);
+    int snapindex = -1;
+    size_t i;
+    
+    m_cloneMats.resize(m_clones.size());
+    
+    // 第一遍在参与捕捉的图形中找捕捉距离最近的点
+    for (i = 0; i < m_clones.size(); i++) {
+        MgBaseShape* shape = m_clones[i]->shape();
+        const MgShape* basesp = getShape(m_selIds[i], sender);
+        
+        if (!basesp || shape->getFlag(kMgShapeLocked) || !isSnapClone(i))
+            continue;
+        shape->copy(*basesp->shapec());
+        shape->offset(vec, -1);
+        shape->update();
+        
+        Vector2d snapvec(snapPoint(sender, m_clones[i]) - pointM);
+        shape->offset(snapvec, -1);
+        if (!snapvec.isZeroVector() && minsnap.length() > snapvec.length()) {
+            minsnap = snapvec;
+            snapindex = (int)i;
+        }
+    }
+    if (snapindex >= 0) {
+        snapPoint(sender, m_clones[snapindex]);     // 切换到对应图形的捕捉状态
+        vec += minsnap;                             // 这些图形都移动相同距离
+    }
+    
+    // 第二遍只对参与捕捉的图形生成新位置，其余图形在显示或应用时才变换
+    CmdSubject* subject = sender->view->getCmdSubject();
+    std::vector<MgShape*> moved;
+    
+    for (i = 0; i < m_clones.size(); i++) {
+        MgBaseShape* shape = m_clones[i]->shape();
+        const MgShape* basesp = getShape(m_selIds[i], sender);
+        
+        if (!basesp || shape->getFlag(kMgShapeLocked))
+            continue;
+        
+        Box2d extent(basesp->shapec()->getExtent());
+        Vector2d limitvec;
+        
+        moveIntoLimits(extent.offset(vec), sender, limitvec);   // 限制图形在视图范围内
+        Matrix2d mat(Matrix2d::translation(vec + limitvec));
+        
+        if (isSnapClone(i)) {
+            shape->copy(*basesp->shapec());
+            shape->transform(mat);
+            shape->update();
+            m_cloneMats[i] = Matrix2d::kIdentity();
+            moved.push_back(m_clones[i]);
+        }
+        else {
+            if (m_clonesMoved) {                    // 变换是相对原图形的
+                shape->copy(*basesp->shapec());
+                shape->update();
+            }
+            m_cloneMats[i] = mat;
+        }
+        shape->setFlag(kMgHideContent, false);      // 显示隐藏的图片
+    }
+    m_clonesMoved = false;
+    if (!moved.empty() && subject->hasObserver(kCmdEventShapeMoved)) {
+        subject->onShapesMoved(sender, (int)moved.size(), &moved.front(), -1);
+    }
+    sender->view->redraw();
+    sender->view->dynamicChanged();
+}
+
+void MgCmdSelect::applyCloneMatrices()
+{
+    for (size_t i = 0; i < m_cloneMats.size() && i < m_clones.size(); i++) {
+        if (!m_cloneMats[i].isIdentity()) {
+            m_clones[i]->shape()->transform(m_cloneMats[i]);
+            m_clones[i]->shape()->update();
+            m_clonesMoved = true;
+        }
+    }
+    m_cloneMats.clear();
+}
+
 bool MgCmdSelect::touchMoved(const MgMotion* sender)
 {
     Point2d pointM(sender->pointM);
@@ -767,8 +878,16 @@ bool MgCmdSelect::touchMoved(const MgMotion* sender)
     Vector2d minsnap(1e8f, 1e8f);
     int snapindex = -1;
     
+    const bool dragAll = (m_clones.size() > 1 && !dragCorner && !isEditMode(sender->view)
+                          && !m_insertPt && m_rotateHandle == 0);
+    if (dragAll) {
+        dragClones(sender, pointM);     // 整体拖动多个图形，不必每次复制所有图形
+    }
+    
+    const bool notifyMoved = sender->view->getCmdSubject()->hasObserver(kCmdEventShapeMoved);
+    
     // 拖动多个图形则循环两遍：第一遍在每个选中图形中找捕捉距离最近的点，第二遍应用此最近点拖动
-    for (int t = m_clones.size() > 1 && !dragCorner ? 2 : 1; t > 0; t--) {
+    for (int t = dragAll ? 0 : m_clones.size() > 1 && !dragCorner ? 2 : 1; t > 0; t--) {
         for (size_t i = 0; i < m_clones.size(); i++) {      // 对每个选中图形的临时图形
             MgBaseShape* shape = m_clones[i]->shape();
             const MgShape* basesp = getShape(m_selIds[i], sender); // 对应的原始图形
@@ -839,7 +958,7 @@ bool MgCmdSelect::touchMoved(const MgMotion* sender)
                     shape->offset(minsnap, segment);        // 这些图形都移动相同距离
                 }
             }
-            if (t == 1) {
+            if (t == 1 && notifyMoved) {
                 sender->view->shapeMoved(m_clones[i], segment); // 通知已移动
             }
             shape->update();
@@ -856,19 +975,20 @@ bool MgCmdSelect::touchMoved(const MgMotion* sender)
     
     if (m_clones.empty() && m_boxsel) {    // 没有选中图形时就滑动多选
         Box2d snap(sender->startPtM, sender->pointM);
-        MgShapeIterator it(sender->view->shapes());
+        bool intersect = isIntersectMode(sender);
+        int n = sender->cmds()->getSnap()->getShapesInBox(sender, snap, intersect, 0, NULL);
+        std::vector<const MgShape*> shapes(n);
         
+        n = n > 0 ? sender->cmds()->getSnap()->getShapesInBox(sender, snap, intersect, n, &shapes.front()) : 0;
         m_selIds.clear();
         m_id = 0;
         m_hit.segment = -1;
-        while (const MgShape* shape = it.getNext()) {
-            if (isIntersectMode(sender) ? shape->shapec()->hitTestBox(snap)
-                : snap.contains(shape->shapec()->getExtent())) {
-                if (!shape->shapec()->getFlag(kMgShapeLocked) ||
-                    !shape->shapec()->getFlag(kMgNoAction)) {
-                    m_selIds.push_back(shape->getID());
-                    m_id = shape->getID();
-                }
+        for (int i = 0; i < n; i++) {
+            const MgShape* shape = shapes[i];
+            if (!shape->shapec()->getFlag(kMgShapeLocked) ||
+                !shape->shapec()->getFlag(kMgNoAction)) {
+                m_selIds.push_back(shape->getID());
+                m_id = shape->getID();
             }
         }
         sender->view->redraw();
@@ -935,6 +1055,8 @@ void MgCmdSelect::cloneShapes(MgView* view)
         (*it)->release();
     }
     m_clones.clear();
+    m_cloneMats.clear();
+    m_clonesMoved = false;
     
     for (sel_iterator its = m_selIds.begin(); its != m_selIds.end(); ++its) {
         const MgShape* shape = view->shapes()->findShape(*its);
@@ -952,6 +1074,7 @@ bool MgCmdSelect::applyCloneShapes(MgView* view, bool apply, bool addNewShapes)
     const bool cloned = !m_clones.empty();
     size_t i;
     
+    applyCloneMatrices();
     if (apply) {
         apply = false;
         for (i = 0; i < m_clones.size() && !apply; i++) {
@@ -973,6 +1096,7 @@ bool MgCmdSelect::applyCloneShapes(MgView* view, bool apply, bool addNewShapes)
             m_selIds.clear();
             m_id = 0;
         }
+        view->beginBatch();
         for (i = 0; i < m_clones.size(); i++) {
             const MgShape* oldsp = view->shapes()->findShape(m_clones[i]->getID());
             
@@ -993,8 +1117,14 @@ bool MgCmdSelect::applyCloneShapes(MgView* view, bool apply, bool addNewShapes)
                 }
             }
             else {
-                if (oldsp && view->shapeWillChanged(m_clones[i], oldsp)
-                    && view->shapes()->updateShape(m_clones[i])) {
+                if (oldsp && view->shapeWillChanged(m_clones[i], oldsp)) {
+                    view->regenShape(oldsp);
+                }
+                else {
+                    oldsp = NULL;
+                }
+                if (oldsp && view->shapes()->updateShape(m_clones[i])) {
+                    view->shapeChanged(m_clones[i]);    // 只重新显示新旧图形所在区域
                     changed = true;
                 }
                 else {
@@ -1002,10 +1132,10 @@ bool MgCmdSelect::applyCloneShapes(MgView* view, bool apply, bool addNewShapes)
                 }
             }
         }
+        view->commitBatch();
         m_clones.clear();
     }
     if (changed) {
-        view->regenAll(true);
         if (addNewShapes) {
             selectionChanged(view);
             m_boxsel = false;
@@ -1097,6 +1227,7 @@ bool MgCmdSelect::deleteSelection(const MgMotion* sender)
     if (shape && sender->view->shapeWillDeleted(shape)) {
         applyCloneShapes(sender->view, false);
 
+        sender->view->beginBatch();
         for (sel_iterator it = m_selIds.begin(); it != m_selIds.end(); ++it) {
             shape = sender->view->shapes()->findShape(*it);
             if (shape && !shape->shapec()->getFlag(kMgShapeLocked)
@@ -1104,6 +1235,7 @@ bool MgCmdSelect::deleteSelection(const MgMotion* sender)
                 count++;
             }
         }
+        sender->view->commitBatch();
         
         m_selIds.clear();
         m_id = 0;
@@ -1111,8 +1243,7 @@ bool MgCmdSelect::deleteSelection(const MgMotion* sender)
         m_rotateHandle = 0;
     }
     
-    if (count > 0) {
-        sender->view->regenAll(true);
+    if (count > 0) {                    // removeShape 已标记重新显示所删图形的区域
         selectionChanged(sender->view);
         if (count == 1) {
             sender->view->showMessage("@shape1_deleted");
@@ -79,6 +79,9 @@ private:
     bool isCloneDrag(const MgMotion* sender);
     void cloneShapes(MgView* view);
     bool applyCloneShapes(MgView* view, bool apply, bool addNewShapes = false);
+    bool isSnapClone(size_t index) const;
+    void dragClones(const MgMotion* sender, const Point2d& pointM);
+    void applyCloneMatrices();
     bool canTransform(const MgShape* shape, const MgMotion* sender);
     bool canRotate(const MgShape* shape, const MgMotion* sender);
     void selectionChanged(MgView* view);
@@ -86,6 +89,8 @@ private:
 private:
     std::vector<int>        m_selIds;           // 选中的图形的ID
     std::vector<MgShape*>   m_clones;           // 选中图形的复制对象
+    std::vector<Matrix2d>   m_cloneMats;        // 拖动中尚未作用到复制对象上的变换
+    bool                    m_clonesMoved;      // 复制对象已作用了变换，再拖动时需从原图形复制
     int                     m_id;               // 选中图形的ID
     MgHitResult             m_hit;              // 点中结果
     Point2d                 m_ptSnap;           // 捕捉点
@@ -4,6 +4,8 @@
 
 #include "mgcmdmgr_.h"
 #include "mggrid.h"
+#include <vector>
+#include <algorithm>
 
 class SnapItem {
 public:
@@ -22,6 +24,589 @@ public:
         , handleIndex(_handleIndex), handleIndexSrc(_handleIndexSrc) {}
 };
 
+//! 一个图层中图形控制点和范围的网格索引，捕捉时只检查容差范围内的图形
+/*! 图形列表的改变计数变化或强制同步时，只对新增、改变的图形重新建立索引
+ */
+class MgSnapIndex
+{
+public:
+    MgSnapIndex() : _shapes(NULL), _changeCount(0), _cell(0), _builtCount(0), _mark(0)
+        , _version(0), _cacheVersion(-1), _boxVersion(-1), _boxIntersect(false) {}
+    ~MgSnapIndex() { clear(); }
+    
+    void clear();
+    void sync(const MgShapes* shapes);
+    
+    //! 查找有控制点在pts各点tol距离内、或范围与box相交的图形，按显示次序排列
+    /*! 上次查询时已缓存放大范围内的候选图形，连续拖动时查询范围仍在其中就只筛选候选图形
+     */
+    void query(const std::vector<Point2d>& pts, float tol, const Box2d& box,
+               std::vector<const MgShape*>& result);
+    
+    //! 得到框选矩形内的图形，按显示次序排列，见 MgSnap::getShapesInBox
+    int queryBox(const Box2d& box, bool intersect, int count, const MgShape** shapes);
+    
+private:
+    enum { kMaxCachedPoints = 8 };      // 查询点数不多时才使用候选缓存
+    struct Item {
+        const MgShape*  sp;             // 已增加引用计数，为NULL表示空闲
+        long            changeCount;
+        int             order;          // 在图形列表中的显示次序
+        long            mark;
+        bool            big;            // 范围跨越的网格太多，单独检查
+        Box2d           extent;
+        std::vector<Point2d> handles;   // 可捕捉的控制点
+    };
+    struct Ref {
+        int             item;
+        int             handle;         // 控制点序号，-1表示图形范围
+        Ref(int i, int h) : item(i), handle(h) {}
+    };
+    struct Range { int x1, y1, x2, y2; };
+    typedef std::pair<int, int> Key;
+    typedef std::map<Key, std::vector<Ref> > Cells;
+    
+    int cellOf(float v) const;
+    Range getRange(const Box2d& box) const;
+    int getRangeCount(const Range& r) const;
+    void addItem(const MgShape* sp, int order);
+    void removeItem(int index);
+    void addRefs(int index);
+    void removeRefs(int index);
+    void rebuild();
+    void removeRefs(const Key& key, int index);
+    void fillCache(const Box2d& rect);
+    bool isSameList(const MgShapes* shapes) const;
+    void findExtents(const Box2d& box, long mark, std::vector<int>& found);
+    
+    template <class Visitor>
+    void visitCells(const Box2d& box, Visitor& v) {
+        Range r = getRange(box);
+        if (getRangeCount(r) > (int)_cells.size()) {    // 缩小显示时容差框覆盖很多空网格
+            for (Cells::iterator it = _cells.begin(); it != _cells.end(); ++it) {
+                if (it->first.first >= r.x1 && it->first.first <= r.x2
+                    && it->first.second >= r.y1 && it->first.second <= r.y2) {
+                    v(it->second);
+                }
+            }
+        }
+        else {
+            for (int y = r.y1; y <= r.y2; y++) {
+                for (int x = r.x1; x <= r.x2; x++) {
+                    Cells::iterator it = _cells.find(Key(x, y));
+                    if (it != _cells.end())
+                        v(it->second);
+                }
+            }
+        }
+    }
+    friend struct SnapHandleVisitor;
+    friend struct SnapExtentVisitor;
+    friend struct SnapCacheVisitor;
+    
+private:
+    const MgShapes*     _shapes;
+    long                _changeCount;
+    float               _cell;          // 网格边长，模型坐标
+    int                 _builtCount;    // 确定网格大小时的图形数
+    long                _mark;
+    std::vector<Item>   _items;
+    std::vector<int>    _freeItems;
+    std::vector<int>    _bigItems;
+    std::map<int, int>  _id2item;
+    Cells               _cells;
+    long                _version;       // 增删图形项后增加，用于判断候选缓存是否有效
+    long                _cacheVersion;
+    Box2d               _cacheRect;     // 候选缓存的范围，比查询范围大
+    std::vector<int>    _cacheItems;    // 有控制点在 _cacheRect 内或范围与之相交的图形项
+    long                _boxVersion;    // 框选结果对应的 _version
+    bool                _boxIntersect;
+    Box2d               _boxRect;       // 上次的框选矩形
+    std::map<int, int>  _boxHits;       // 框选到的图形项，显示次序 -> 图形项序号
+};
+
+void MgSnapIndex::clear()
+{
+    for (size_t i = 0; i < _items.size(); i++) {
+        if (_items[i].sp)
+            const_cast<MgShape*>(_items[i].sp)->release();
+    }
+    _items.clear();
+    _freeItems.clear();
+    _bigItems.clear();
+    _id2item.clear();
+    _cells.clear();
+    _shapes = NULL;
+    _cell = 0;
+    _builtCount = 0;
+    _version++;
+}
+
+// 图形列表可能被释放后在同一地址重建。已索引的图形都增加了引用计数，其地址不会被复用，
+// 所以图形数和首末图形都相同时就是同一列表或其浅拷贝，不必逐个核对
+bool MgSnapIndex::isSameList(const MgShapes* shapes) const
+{
+    if (_changeCount != shapes->getChangeCount()
+        || (int)_id2item.size() != shapes->getShapeCount()) {
+        return false;
+    }
+    const MgShape* ends[2] = { shapes->getHeadShape(), shapes->getLastShape() };
+    for (int i = 0; i < 2; i++) {
+        std::map<int, int>::const_iterator it = ends[i] ? _id2item.find(ends[i]->getID()) : _id2item.end();
+        if (ends[i] && (it == _id2item.end() || _items[it->second].sp != ends[i]))
+            return false;
+    }
+    return true;
+}
+
+void MgSnapIndex::sync(const MgShapes* shapes)
+{
+    if (shapes != _shapes) {
+        clear();
+        _shapes = shapes;
+    }
+    else if (isSameList(shapes)) {
+        return;
+    }
+    _changeCount = shapes->getChangeCount();
+    _version++;                         // 显示次序可能已改变
+    
+    MgShapeIterator it(shapes);
+    long mark = ++_mark;
+    int order = 0;
+    
+    while (const MgShape* sp = it.getNext()) {
+        std::map<int, int>::iterator f = _id2item.find(sp->getID());
+        if (f != _id2item.end()) {
+            Item& item = _items[f->second];
+            if (item.sp == sp && item.changeCount == sp->shapec()->getChangeCount()) {
+                item.order = order++;
+                item.mark = mark;
+                continue;
+            }
+            removeItem(f->second);
+        }
+        addItem(sp, order++);
+        _items[_id2item[sp->getID()]].mark = mark;
+    }
+    for (size_t i = 0; i < _items.size(); i++) {
+        if (_items[i].sp && _items[i].mark != mark)
+            removeItem((int)i);
+    }
+    if (_cell == 0 || (int)_id2item.size() > 4 * _builtCount + 64) {
+        rebuild();
+    }
+}
+
+int MgSnapIndex::cellOf(float v) const
+{
+    float f = floorf(v / _cell);
+    return f < -1e9f ? -1000000000 : f > 1e9f ? 1000000000 : (int)f;
+}
+
+MgSnapIndex::Range MgSnapIndex::getRange(const Box2d& box) const
+{
+    Range r = { cellOf(box.xmin), cellOf(box.ymin), cellOf(box.xmax), cellOf(box.ymax) };
+    return r;
+}
+
+int MgSnapIndex::getRangeCount(const Range& r) const
+{
+    float n = (float)(r.x2 - r.x1 + 1) * (float)(r.y2 - r.y1 + 1);
+    return n > 1e8f ? 100000000 : (int)n;
+}
+
+void MgSnapIndex::addItem(const MgShape* sp, int order)
+{
+    int index;
+    
+    if (_freeItems.empty()) {
+        index = (int)_items.size();
+        _items.push_back(Item());
+    }
+    else {
+        index = _freeItems.back();
+        _freeItems.pop_back();
+    }
+    
+    Item& item = _items[index];
+    const MgBaseShape* shape = sp->shapec();
+    int n = shape->getHandleCount();
+    bool curve = shape->isKindOf(MgSplines::Type());
+    
+    const_cast<MgShape*>(sp)->addRef();
+    item.sp = sp;
+    item.changeCount = shape->getChangeCount();
+    item.order = order;
+    item.mark = 0;
+    item.big = false;
+    item.extent = shape->getExtent();
+    item.handles.clear();
+    for (int i = 0; i < n; i++) {           // 与 snapHandle 的条件一致
+        if (curve && ((i > 0 && i + 1 < n) || shape->isClosed()))
+            continue;
+        if (shape->getHandleType(i) < kMgHandleOutside)
+            item.handles.push_back(shape->getHandlePoint(i));
+    }
+    _id2item[sp->getID()] = index;
+    if (_cell > 0) {
+        addRefs(index);
+    }
+    _version++;
+}
+
+void MgSnapIndex::removeItem(int index)
+{
+    Item& item = _items[index];
+    
+    if (_cell > 0) {
+        removeRefs(index);
+    }
+    _id2item.erase(item.sp->getID());
+    const_cast<MgShape*>(item.sp)->release();
+    item.sp = NULL;
+    item.handles.clear();
+    _freeItems.push_back(index);
+    _version++;
+}
+
+void MgSnapIndex::addRefs(int index)
+{
+    Item& item = _items[index];
+    
+    for (int i = 0; i < (int)item.handles.size(); i++) {
+        _cells[Key(cellOf(item.handles[i].x), cellOf(item.handles[i].y))].push_back(Ref(index, i));
+    }
+    
+    Range r = getRange(item.extent);
+    item.big = getRangeCount(r) > 64;
+    if (item.big) {
+        _bigItems.push_back(index);
+    }
+    else {
+        for (int y = r.y1; y <= r.y2; y++) {
+            for (int x = r.x1; x <= r.x2; x++) {
+                std::vector<Ref>& refs = _cells[Key(x, y)];
+                size_t k = 0;               // 图形范围排在控制点之前，按范围查找时不必遍历控制点
+                while (k < refs.size() && refs[k].handle < 0)
+                    k++;
+                refs.push_back(Ref(index, -1));
+                std::swap(refs[k], refs.back());
+            }
+        }
+    }
+}
+
+void MgSnapIndex::removeRefs(const Key& key, int index)
+{
+    Cells::iterator it = _cells.find(key);
+    
+    if (it != _cells.end()) {
+        std::vector<Ref>& refs = it->second;
+        size_t n = 0;
+        for (size_t i = 0; i < refs.size(); i++) {     // 保持图形范围在前的次序
+            if (refs[i].item != index)
+                refs[n++] = refs[i];
+        }
+        refs.resize(n, Ref(0, 0));
+        if (refs.empty()) {
+            _cells.erase(it);
+        }
+    }
+}
+
+void MgSnapIndex::removeRefs(int index)
+{
+    Item& item = _items[index];
+    std::vector<Key> keys;      // 长笔迹的很多控制点在同一网格中，每个网格只清理一次
+    
+    for (int i = 0; i < (int)item.handles.size(); i++) {
+        keys.push_back(Key(cellOf(item.handles[i].x), cellOf(item.handles[i].y)));
+    }
+    if (item.big) {
+        _bigItems.erase(std::find(_bigItems.begin(), _bigItems.end(), index));
+    }
+    else {
+        Range r = getRange(item.extent);
+        for (int y = r.y1; y <= r.y2; y++) {
+            for (int x = r.x1; x <= r.x2; x++)
+                keys.push_back(Key(x, y));
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    for (size_t i = 0; i < keys.size(); i++) {
+        removeRefs(keys[i], index);
+    }
+}
+
+void MgSnapIndex::rebuild()
+{
+    Box2d rect;
+    int n = 0;
+    
+    for (size_t i = 0; i < _items.size(); i++) {
+        if (_items[i].sp) {
+            rect.unionWith(_items[i].extent);
+            n++;
+        }
+    }
+    
+    // 网格边长取图形平均占据的面积，每个网格约有一个图形
+    float len = mgMax(rect.width(), rect.height());
+    float cell = n > 0 ? sqrtf(rect.width() * rect.height() / n) : 0.f;
+    
+    _cell = mgMax(cell, len / 1024.f);
+    if (_cell < 1e-3f) {
+        _cell = 1.f;
+    }
+    _builtCount = n;
+    _cells.clear();
+    _bigItems.clear();
+    for (size_t i = 0; i < _items.size(); i++) {
+        if (_items[i].sp)
+            addRefs((int)i);
+    }
+}
+
+struct SnapHandleVisitor {
+    MgSnapIndex* index;
+    Point2d pt;
+    float tol2;
+    long mark;
+    std::vector<int>* found;
+    
+    void operator()(const std::vector<MgSnapIndex::Ref>& refs) {
+        for (size_t i = 0; i < refs.size(); i++) {
+            MgSnapIndex::Item& item = index->_items[refs[i].item];
+            if (refs[i].handle >= 0 && item.mark != mark
+                && item.handles[refs[i].handle].distanceSquare(pt) <= tol2) {
+                item.mark = mark;
+                found->push_back(refs[i].item);
+            }
+        }
+    }
+};
+
+struct SnapExtentVisitor {
+    MgSnapIndex* index;
+    Box2d box;
+    long mark;
+    std::vector<int>* found;
+    
+    void operator()(const std::vector<MgSnapIndex::Ref>& refs) {
+        for (size_t i = 0; i < refs.size() && refs[i].handle < 0; i++) {
+            MgSnapIndex::Item& item = index->_items[refs[i].item];
+            if (item.mark != mark && item.extent.isIntersect(box)) {
+                item.mark = mark;
+                found->push_back(refs[i].item);
+            }
+        }
+    }
+};
+
+struct SnapCacheVisitor {
+    MgSnapIndex* index;
+    Box2d rect;
+    long mark;
+    
+    void operator()(const std::vector<MgSnapIndex::Ref>& refs) {
+        for (size_t i = 0; i < refs.size(); i++) {
+            MgSnapIndex::Item& item = index->_items[refs[i].item];
+            if (item.mark != mark && (refs[i].handle >= 0
+                ? rect.contains(item.handles[refs[i].handle])
+                : item.extent.isIntersect(rect))) {
+                item.mark = mark;
+                index->_cacheItems.push_back(refs[i].item);
+            }
+        }
+    }
+};
+
+void MgSnapIndex::fillCache(const Box2d& rect)
+{
+    SnapCacheVisitor v = { this, rect, ++_mark };
+    
+    _cacheItems.clear();
+    visitCells(rect, v);
+    for (size_t i = 0; i < _bigItems.size(); i++) {
+        Item& item = _items[_bigItems[i]];
+        if (item.mark != v.mark && item.extent.isIntersect(rect)) {
+            item.mark = v.mark;
+            _cacheItems.push_back(_bigItems[i]);
+        }
+    }
+    _cacheRect = rect;
+    _cacheVersion = _version;
+}
+
+void MgSnapIndex::query(const std::vector<Point2d>& pts, float tol, const Box2d& box,
+                        std::vector<const MgShape*>& result)
+{
+    std::vector<int> found;
+    long mark = ++_mark;
+    
+    if (pts.size() > kMaxCachedPoints) {    // 整体拖动多顶点图形时各点的容差框分散，直接按网格查找
+        SnapHandleVisitor hv = { this, Point2d(), tol * tol, mark, &found };
+        for (size_t i = 0; i < pts.size(); i++) {
+            hv.pt = pts[i];
+            visitCells(Box2d(pts[i], 2 * tol, 2 * tol), hv);
+        }
+        
+        findExtents(box, mark, found);
+    }
+    else {
+        const float r = tol * 1.01f;    // 略放宽范围，避免浮点误差漏掉恰在容差处的控制点
+        Box2d rect(box);                // 本次查询涉及的范围，box 的高度可能为零，不用 unionWith
+        
+        for (size_t i = 0; i < pts.size(); i++) {
+            rect.xmin = mgMin(rect.xmin, pts[i].x - r);
+            rect.ymin = mgMin(rect.ymin, pts[i].y - r);
+            rect.xmax = mgMax(rect.xmax, pts[i].x + r);
+            rect.ymax = mgMax(rect.ymax, pts[i].y + r);
+        }
+        if (_cacheVersion != _version || !_cacheRect.contains(rect)) {
+            fillCache(Box2d(rect).inflate(2 * tol));    // 放大范围，后续几次移动都可用此缓存
+        }
+        
+        const float tol2 = tol * tol;
+        for (size_t i = 0; i < _cacheItems.size(); i++) {
+            const Item& item = _items[_cacheItems[i]];
+            bool hit = item.extent.isIntersect(box);
+            
+            for (size_t h = 0; h < item.handles.size() && !hit; h++) {
+                if (rect.contains(item.handles[h])) {
+                    for (size_t j = 0; j < pts.size() && !hit; j++)
+                        hit = item.handles[h].distanceSquare(pts[j]) <= tol2;
+                }
+            }
+            if (hit) {
+                found.push_back(_cacheItems[i]);
+            }
+        }
+    }
+    
+    std::vector<std::pair<int, const MgShape*> > sorted(found.size());
+    for (size_t i = 0; i < found.size(); i++) {
+        sorted[i].first = _items[found[i]].order;
+        sorted[i].second = _items[found[i]].sp;
+    }
+    std::sort(sorted.begin(), sorted.end());
+    result.resize(sorted.size());
+    for (size_t i = 0; i < sorted.size(); i++) {
+        result[i] = sorted[i].second;
+    }
+}
+
+void MgSnapIndex::findExtents(const Box2d& box, long mark, std::vector<int>& found)
+{
+    SnapExtentVisitor ev = { this, box, mark, &found };
+    
+    visitCells(box, ev);
+    for (size_t i = 0; i < _bigItems.size(); i++) {
+        Item& item = _items[_bigItems[i]];
+        if (item.mark != mark && item.extent.isIntersect(box)) {
+            item.mark = mark;
+            found.push_back(_bigItems[i]);
+        }
+    }
+}
+
+// 图形范围被两个矩形裁剪后相同，则图形与这两个矩形的相交或包含关系都相同
+static bool sameClip(const Box2d& e, const Box2d& a, const Box2d& b)
+{
+    bool ia = e.isIntersect(a);
+    
+    if (ia != e.isIntersect(b))
+        return false;
+    return !ia || (mgMax(e.xmin, a.xmin) == mgMax(e.xmin, b.xmin)
+                   && mgMax(e.ymin, a.ymin) == mgMax(e.ymin, b.ymin)
+                   && mgMin(e.xmax, a.xmax) == mgMin(e.xmax, b.xmax)
+                   && mgMin(e.ymax, a.ymax) == mgMin(e.ymax, b.ymax));
+}
+
+int MgSnapIndex::queryBox(const Box2d& box, bool intersect, int count, const MgShape** shapes)
+{
+    std::vector<int> found;
+    long mark = ++_mark;
+    const bool incremental = (_boxVersion == _version && _boxIntersect == intersect);
+    
+    if (!incremental) {
+        _boxHits.clear();
+        findExtents(box, mark, found);
+    }
+    else {      // 只有范围跨越新旧矩形之差(四条边各自扫过的条带)的图形才可能改变结果
+        const Box2d& a = _boxRect;
+        float x1 = mgMin(a.xmin, box.xmin), x2 = mgMax(a.xmax, box.xmax);
+        float y1 = mgMin(a.ymin, box.ymin), y2 = mgMax(a.ymax, box.ymax);
+        
+        if (a.xmin != box.xmin)
+            findExtents(Box2d(mgMin(a.xmin, box.xmin), y1, mgMax(a.xmin, box.xmin), y2), mark, found);
+        if (a.xmax != box.xmax)
+            findExtents(Box2d(mgMin(a.xmax, box.xmax), y1, mgMax(a.xmax, box.xmax), y2), mark, found);
+        if (a.ymin != box.ymin)
+            findExtents(Box2d(x1, mgMin(a.ymin, box.ymin), x2, mgMax(a.ymin, box.ymin)), mark, found);
+        if (a.ymax != box.ymax)
+            findExtents(Box2d(x1, mgMin(a.ymax, box.ymax), x2, mgMax(a.ymax, box.ymax)), mark, found);
+    }
+    
+    for (size_t i = 0; i < found.size(); i++) {
+        const Item& item = _items[found[i]];
+        
+        if (incremental && sameClip(item.extent, _boxRect, box)) {
+            continue;
+        }
+        if (intersect ? item.sp->shapec()->hitTestBox(box) : box.contains(item.extent)) {
+            _boxHits[item.order] = found[i];
+        }
+        else {
+            _boxHits.erase(item.order);
+        }
+    }
+    _boxVersion = _version;
+    _boxIntersect = intersect;
+    _boxRect = box;
+    
+    if (count <= 0 || !shapes) {
+        return (int)_boxHits.size();
+    }
+    
+    int n = 0;
+    for (std::map<int, int>::const_iterator it = _boxHits.begin();
+         it != _boxHits.end() && n < count; ++it) {
+        shapes[n++] = _items[it->second].sp;
+    }
+    return n;
+}
+
+MgSnapIndex* MgCmdManagerImpl::getSnapIndex(const MgMotion* sender)
+{
+    const MgShapes* shapes = sender->view->shapes();
+    MgSnapIndex*& index = _snapIndex[shapes->getIndex()];
+    
+    if (!index) {
+        index = new MgSnapIndex();
+    }
+    index->sync(shapes);
+    
+    return index;
+}
+
+void MgCmdManagerImpl::freeSnapIndex()
+{
+    for (std::map<int, MgSnapIndex*>::iterator it = _snapIndex.begin();
+         it != _snapIndex.end(); ++it) {
+        delete it->second;
+    }
+    _snapIndex.clear();
+}
+
+int MgCmdManagerImpl::getShapesInBox(const MgMotion* sender, const Box2d& box, bool intersect,
+                                     int count, const MgShape** shapes)
+{
+    return getSnapIndex(sender)->queryBox(box, intersect, count, shapes);
+}
+
 static int snapHV(const Point2d& basePt, Point2d& newPt, SnapItem arr[3])
 {
     int ret = 0;
@@ -205,32 +790,62 @@ static void snapGrid(const MgMotion*, const Point2d& orignPt,
     }
 }
 
-static void snapPoints(const MgMotion* sender, const Point2d& orignPt,
+static void snapPoints(MgSnapIndex* index, const MgMotion* sender, const Point2d& orignPt,
                        const MgShape* shape, int ignoreHandle,
                        const int* ignoreids, SnapItem arr[3], Point2d* matchpt)
 {
     Box2d snapbox(orignPt, 2 * arr[0].dist, 0);         // 捕捉容差框
     GiTransform* xf = sender->view->xform();
     Box2d wndbox(xf->getWndRectM());
-    MgShapeIterator it(sender->view->shapes());
+    std::vector<Point2d> pts(1, orignPt);
+    std::vector<const MgShape*> shapes;
     
-    while (const MgShape* sp = it.getNext()) {
-        if (skipShape(ignoreids, sp)) {
-            continue;
-        }
-        Box2d extent(sp->shapec()->getExtent());
-        if (extent.width() < xf->displayToModel(2, true)
-            && extent.height() < xf->displayToModel(2, true)) { // 图形太小就跳过
-            continue;
-        }
-        if (extent.isIntersect(wndbox)
-            && !snapHandle(sender, orignPt, shape, ignoreHandle, sp, arr[0], matchpt)) {
+    int d = matchpt ? shape->shapec()->getHandleCount() - 1 : -1;
+    for (; d >= 0; d--) {                               // 整体移动图形时其顶点也参与匹配
+        if (d != ignoreHandle && !shape->shapec()->isHandleFixed(d))
+            pts.push_back(shape->shapec()->getHandlePoint(d));
+    }
+    
+    // 只检查有控制点在容差内或范围与捕捉容差框相交的图形，snapNear 每次可能将容差放宽4毫米
+    const SnapItem initItems[3] = { arr[0], arr[1], arr[2] };
+    const Point2d initMatch(matchpt ? *matchpt : Point2d());
+    float tol = arr[0].dist + sender->displayMmToModel(4.f);
+    float maxDist;
+    
+    for (;;) {
+        index->query(pts, tol, snapbox, shapes);
+        maxDist = arr[0].dist;
+        
+        for (size_t i = 0; i < shapes.size(); i++) {
+            const MgShape* sp = shapes[i];
+            if (skipShape(ignoreids, sp)) {
+                continue;
+            }
+            Box2d extent(sp->shapec()->getExtent());
+            if (extent.width() < xf->displayToModel(2, true)
+                && extent.height() < xf->displayToModel(2, true)) { // 图形太小就跳过
+                continue;
+            }
+            if (extent.isIntersect(wndbox)
+                && !snapHandle(sender, orignPt, shape, ignoreHandle, sp, arr[0], matchpt)) {
+                if (extent.isIntersect(snapbox)) {
+                    snapNear(sender, orignPt, shape, ignoreHandle, sp, arr[0], matchpt);
+                    maxDist = mgMax(maxDist, arr[0].dist);
+                }
+            }
             if (extent.isIntersect(snapbox)) {
-                snapNear(sender, orignPt, shape, ignoreHandle, sp, arr[0], matchpt);
+                snapGrid(sender, orignPt, shape, ignoreHandle, sp, arr, matchpt);
             }
         }
-        if (extent.isIntersect(snapbox)) {
-            snapGrid(sender, orignPt, shape, ignoreHandle, sp, arr, matchpt);
+        if (maxDist + _MGZERO < tol) {
+            break;
+        }
+        tol = maxDist + sender->displayMmToModel(4.f);  // 容差放宽到了查询范围外，扩大范围重新捕捉
+        for (int j = 0; j < 3; j++) {
+            arr[j] = initItems[j];
+        }
+        if (matchpt) {
+            *matchpt = initMatch;
         }
     }
 }
@@ -264,8 +879,8 @@ Point2d MgCmdManagerImpl::snapPoint(const MgMotion* sender, const Point2d& orign
     bool matchpt = (shape && shape->getID() != 0    // 拖动整个图形
                     && (hotHandle < 0 || (ignoreHandle >= 0 && ignoreHandle != hotHandle)));
     
-    snapPoints(sender, orignPt, shape, ignoreHandle, ignoreids,
-               arr, matchpt ? &pnt : NULL);         // 在所有图形中捕捉
+    snapPoints(getSnapIndex(sender), sender, orignPt, shape,
+               ignoreHandle, ignoreids, arr, matchpt ? &pnt : NULL);  // 在附近图形中捕捉
     checkResult(arr);
     
     return matchpt && pnt.x > -1e8f ? pnt : _ptSnap;    // 顶点匹配优先于用触点捕捉结果
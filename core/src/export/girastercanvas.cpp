@@ -0,0 +1,792 @@
+// girastercanvas.cpp
+// Copyright (c) 2013-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#include "girastercanvas.h"
+#include <vector>
+#include <math.h>
+#include <string.h>
+
+static const float patDash[]      = { 4, 2, 0 };
+static const float patDot[]       = { 1, 2, 0 };
+static const float patDashDot[]   = { 10, 2, 2, 2, 0 };
+static const float dashDotdot[]   = { 20, 2, 2, 2, 2, 2, 0 };
+static const float* const lpats[] = { NULL, patDash, patDot, patDashDot, dashDotdot };
+
+static const float kTol = 0.25f;        // 曲线折线化的允许误差(像素)
+
+struct RasterPt {
+    float x, y;
+    RasterPt() {}
+    RasterPt(float x_, float y_) : x(x_), y(y_) {}
+};
+
+//! 已折线化的路径，各子路径的点连续存放
+struct RasterPath {
+    struct Sub {
+        int     start;
+        int     count;
+        bool    closed;
+    };
+    std::vector<RasterPt>   pts;
+    std::vector<Sub>        subs;
+
+    void clear() {
+        pts.clear();
+        subs.clear();
+    }
+    bool empty() const { return subs.empty(); }
+
+    void moveTo(float x, float y) {
+        Sub sub = { (int)pts.size(), 1, false };
+        subs.push_back(sub);
+        pts.push_back(RasterPt(x, y));
+    }
+
+    void lineTo(float x, float y) {
+        if (subs.empty()) {
+            moveTo(x, y);
+        } else {
+            if (subs.back().closed) {       // 闭合后继续绘制则从子路径起点开始
+                RasterPt pt(pts[subs.back().start]);
+                moveTo(pt.x, pt.y);
+            }
+            pts.push_back(RasterPt(x, y));
+            subs.back().count++;
+        }
+    }
+
+    RasterPt lastPoint() const {
+        return subs.empty() ? RasterPt(0, 0) : pts.back();
+    }
+
+    void bezierTo(float c1x, float c1y, float c2x, float c2y, float x, float y) {
+        RasterPt p0(lastPoint());
+        float ddx = fabsf(p0.x - 2 * c1x + c2x) + fabsf(c1x - 2 * c2x + x);
+        float ddy = fabsf(p0.y - 2 * c1y + c2y) + fabsf(c1y - 2 * c2y + y);
+        int n = (int)ceilf(sqrtf(0.75f * (ddx + ddy) / kTol));
+
+        n = n < 1 ? 1 : (n > 256 ? 256 : n);
+        for (int i = 1; i <= n; i++) {
+            float t = (float)i / n, s = 1.f - t;
+            float a = s * s * s, b = 3 * s * s * t, c = 3 * s * t * t, d = t * t * t;
+            lineTo(a * p0.x + b * c1x + c * c2x + d * x, a * p0.y + b * c1y + c * c2y + d * y);
+        }
+    }
+
+    void quadTo(float cpx, float cpy, float x, float y) {
+        RasterPt p0(lastPoint());
+        float dd = fabsf(p0.x - 2 * cpx + x) + fabsf(p0.y - 2 * cpy + y);
+        int n = (int)ceilf(sqrtf(0.25f * dd / kTol));
+
+        n = n < 1 ? 1 : (n > 256 ? 256 : n);
+        for (int i = 1; i <= n; i++) {
+            float t = (float)i / n, s = 1.f - t;
+            lineTo(s * s * p0.x + 2 * s * t * cpx + t * t * x,
+                   s * s * p0.y + 2 * s * t * cpy + t * t * y);
+        }
+    }
+
+    void closePath() {
+        if (!subs.empty())
+            subs.back().closed = true;
+    }
+
+    void addRect(float x, float y, float w, float h) {
+        moveTo(x, y);
+        lineTo(x + w, y);
+        lineTo(x + w, y + h);
+        lineTo(x, y + h);
+        closePath();
+    }
+
+    void addEllipse(float x, float y, float w, float h) {
+        const float k = 0.5522847498f;
+        float rx = w / 2, ry = h / 2, cx = x + rx, cy = y + ry;
+
+        moveTo(cx + rx, cy);
+        bezierTo(cx + rx, cy + ry * k, cx + rx * k, cy + ry, cx, cy + ry);
+        bezierTo(cx - rx * k, cy + ry, cx - rx, cy + ry * k, cx - rx, cy);
+        bezierTo(cx - rx, cy - ry * k, cx - rx * k, cy - ry, cx, cy - ry);
+        bezierTo(cx + rx * k, cy - ry, cx + rx, cy - ry * k, cx + rx, cy);
+        closePath();
+    }
+
+    // 添加顺时针的圆，与 addQuad 的环绕方向相同，重叠部分按非零规则合并
+    void addDisc(float cx, float cy, float r) {
+        int n = (int)ceilf(3.2f * sqrtf(2 * r));
+        n = n < 8 ? 8 : (n > 128 ? 128 : n);
+        moveTo(cx + r, cy);
+        for (int i = 1; i < n; i++) {
+            float a = -6.2831853f * i / n;
+            lineTo(cx + r * cosf(a), cy + r * sinf(a));
+        }
+        closePath();
+    }
+
+    // 添加线段两侧偏移 hw 的矩形
+    void addQuad(const RasterPt& a, const RasterPt& b, float nx, float ny) {
+        moveTo(a.x + nx, a.y + ny);
+        lineTo(b.x + nx, b.y + ny);
+        lineTo(b.x - nx, b.y - ny);
+        lineTo(a.x - nx, a.y - ny);
+        closePath();
+    }
+};
+
+struct GiRasterCanvas::Impl
+{
+    struct Clip {
+        int x0, y0, x1, y1;                 // 像素范围，不含右下边界
+        std::vector<unsigned char> mask;    // 非矩形剪裁区的覆盖率，为空则只按矩形剪裁
+    };
+
+    unsigned char*  pixels;
+    int             width;
+    int             height;
+    int             stride;
+
+    int             penArgb;
+    float           penWidth;
+    int             penStyle;
+    int             penCap;
+    float           penPhase;
+    int             brushArgb;
+
+    RasterPath      path;                   // beginPath 开始的路径
+    RasterPath      tmp;                    // drawRect 等使用的临时路径
+    RasterPath      rings;                  // 描边生成的轮廓
+    RasterPath      dashes;                 // 虚线分段
+    std::vector<Clip>   clips;              // 剪裁区栈，末尾为当前剪裁区
+    std::vector<float>  acc;                // 各像素的面积累积值，每行 width+2 个
+    int             xmin, xmax, ymin, ymax; // acc 中有数据的范围
+
+    Impl() : pixels(NULL), width(0), height(0), stride(0) {
+        resetAttributes();
+    }
+
+    void resetAttributes() {
+        penArgb = 0xFF000000;
+        penWidth = 1.f;
+        penStyle = 0;
+        penCap = kLineCapRound;
+        penPhase = 0;
+        brushArgb = 0;
+        xmin = ymin = 0x7FFFFFFF;
+        xmax = ymax = -1;
+    }
+
+    const Clip& clip() const { return clips.back(); }
+
+    void addEdge(float x0, float y0, float x1, float y1);
+    void accumulate(float x0, float y0, float x1, float y1);
+    void addPath(const RasterPath& p);
+    void flush(int argb, unsigned char* maskOut = NULL);
+    void fillPath(const RasterPath& p, int argb);
+    void strokePath(const RasterPath& p);
+    void dashPath(const RasterPath& p, const float* pattern, float scale);
+    void addStroke(const RasterPt* pts, int count, bool closed, float hw, int cap);
+};
+
+static inline int mul255(int a, int b)
+{
+    int t = a * b + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+static inline unsigned char blend255(int src, int dst, int cover, int inv)
+{
+    int v = mul255(src, cover) + mul255(dst, inv);
+    return (unsigned char)(v < 255 ? v : 255);
+}
+
+// 将线段在剪裁区左右边界处分段，界外部分压到边界上，不影响右侧像素的累积值
+void GiRasterCanvas::Impl::addEdge(float x0, float y0, float x1, float y1)
+{
+    const float lo = (float)clip().x0, hi = (float)clip().x1;
+    float ts[4] = { 0, 1, 1, 1 };
+    int n = 1;
+
+    if ((x0 < lo) != (x1 < lo))
+        ts[n++] = (lo - x0) / (x1 - x0);
+    if ((x0 > hi) != (x1 > hi))
+        ts[n++] = (hi - x0) / (x1 - x0);
+    if (n == 3 && ts[1] > ts[2]) {
+        float t = ts[1]; ts[1] = ts[2]; ts[2] = t;
+    }
+    ts[n] = 1;
+
+    for (int i = 0; i < n; i++) {
+        float xa = x0 + (x1 - x0) * ts[i], ya = y0 + (y1 - y0) * ts[i];
+        float xb = x0 + (x1 - x0) * ts[i+1], yb = y0 + (y1 - y0) * ts[i+1];
+        accumulate(xa < lo ? lo : (xa > hi ? hi : xa), ya,
+                   xb < lo ? lo : (xb > hi ? hi : xb), yb);
+    }
+}
+
+// 按扫描线累积线段左侧的带符号面积，逐行求和即得覆盖率
+void GiRasterCanvas::Impl::accumulate(float x0, float y0, float x1, float y1)
+{
+    if (y0 == y1)
+        return;
+
+    float dir = 1.f;
+    if (y0 > y1) {
+        float t = x0; x0 = x1; x1 = t;
+        t = y0; y0 = y1; y1 = t;
+        dir = -1.f;
+    }
+
+    const float lo = (float)clip().x0, hi = (float)clip().x1;
+    const int ystart = (int)floorf(y0) > clip().y0 ? (int)floorf(y0) : clip().y0;
+    const int yend = (int)ceilf(y1) < clip().y1 ? (int)ceilf(y1) : clip().y1;
+    const float dxdy = (x1 - x0) / (y1 - y0);
+    float x = y0 < ystart ? x0 + (ystart - y0) * dxdy : x0;
+
+    if (ystart >= yend)
+        return;
+    if (ymin > ystart) ymin = ystart;
+    if (ymax < yend) ymax = yend;
+
+    for (int y = ystart; y < yend; y++) {
+        float* row = &acc[y * (width + 2)];
+        float dy = (y + 1 < y1 ? y + 1 : y1) - (y > y0 ? y : y0);
+        float xnext = x + dxdy * dy;
+        float d = dy * dir;
+        float xa = x < xnext ? x : xnext;
+        float xb = x < xnext ? xnext : x;
+
+        xa = xa < lo ? lo : (xa > hi ? hi : xa);
+        xb = xb < lo ? lo : (xb > hi ? hi : xb);
+
+        float xafloor = floorf(xa);
+        int xai = (int)xafloor;
+        int xbi = (int)ceilf(xb);
+
+        if (xbi <= xai + 1) {
+            float xmf = 0.5f * (x + xnext) - xafloor;
+            xmf = xmf < 0 ? 0 : (xmf > 1 ? 1 : xmf);
+            row[xai] += d - d * xmf;
+            row[xai + 1] += d * xmf;
+            xbi = xai + 1;
+        } else {
+            float s = 1.f / (xb - xa);
+            float xaf = xa - xafloor;
+            float a0 = 0.5f * s * (1 - xaf) * (1 - xaf);
+            float xbf = xb - xbi + 1;
+            float am = 0.5f * s * xbf * xbf;
+
+            row[xai] += d * a0;
+            if (xbi == xai + 2) {
+                row[xai + 1] += d * (1 - a0 - am);
+            } else {
+                float a1 = s * (1.5f - xaf);
+                row[xai + 1] += d * (a1 - a0);
+                for (int xi = xai + 2; xi < xbi - 1; xi++) {
+                    row[xi] += d * s;
+                }
+                float a2 = a1 + (xbi - xai - 3) * s;
+                row[xbi - 1] += d * (1 - a2 - am);
+            }
+            row[xbi] += d * am;
+        }
+        if (xmin > xai) xmin = xai;
+        if (xmax < xbi) xmax = xbi;
+        x = xnext;
+    }
+}
+
+void GiRasterCanvas::Impl::addPath(const RasterPath& p)
+{
+    for (size_t i = 0; i < p.subs.size(); i++) {
+        const RasterPt* pts = &p.pts[p.subs[i].start];
+        int n = p.subs[i].count;
+
+        for (int j = 0; j < n; j++) {               // 填充时各子路径都自动闭合
+            const RasterPt& a = pts[j];
+            const RasterPt& b = pts[j + 1 < n ? j + 1 : 0];
+            addEdge(a.x, a.y, b.x, b.y);
+        }
+    }
+}
+
+// 逐行求和得到覆盖率，与颜色混合到缓冲区，或输出到剪裁掩码中
+void GiRasterCanvas::Impl::flush(int argb, unsigned char* maskOut)
+{
+    if (ymin >= ymax) {
+        return;
+    }
+
+    const Clip& c = clip();
+    const unsigned char* mask = c.mask.empty() ? NULL : &c.mask.front();
+    const int a = (argb >> 24) & 0xFF;
+    const int r = mul255((argb >> 16) & 0xFF, a);
+    const int g = mul255((argb >> 8) & 0xFF, a);
+    const int b = mul255(argb & 0xFF, a);
+    const unsigned char solid[4] = { (unsigned char)r, (unsigned char)g, (unsigned char)b, (unsigned char)a };
+    const int xend = xmax + 1;
+
+    for (int y = ymin; y < ymax; y++) {
+        float* row = &acc[y * (width + 2)];
+        unsigned char* line = pixels + y * stride;
+        const unsigned char* mline = mask ? mask + y * width : NULL;
+        float sum = 0;
+
+        for (int x = xmin; x < xend; ) {
+            sum += row[x];
+            row[x] = 0;
+
+            // 累积值为零的连续像素覆盖率相同，成段处理
+            int n = 1;
+            while (x + n < xend && row[x + n] == 0.f)
+                n++;
+
+            float f = fabsf(sum);
+            int cover = f >= 1.f ? 255 : (int)(f * 255.f + 0.5f);
+            int x2 = x + n < c.x1 ? x + n : c.x1;
+
+            if (cover > 0 && x < c.x1) {
+                if (maskOut) {
+                    for (int i = x; i < x2; i++)
+                        maskOut[y * width + i] = (unsigned char)(mline ? mul255(cover, mline[i]) : cover);
+                }
+                else if (!mline && cover == 255 && a == 255) {
+                    for (int i = x; i < x2; i++)
+                        memcpy(line + 4 * i, solid, 4);
+                }
+                else {
+                    for (int i = x; i < x2; i++) {
+                        int cv = mline ? mul255(cover, mline[i]) : cover;
+                        int inv = 255 - mul255(a, cv);
+                        unsigned char* p = line + 4 * i;
+
+                        p[0] = blend255(r, p[0], cv, inv);
+                        p[1] = blend255(g, p[1], cv, inv);
+                        p[2] = blend255(b, p[2], cv, inv);
+                        p[3] = blend255(a, p[3], cv, inv);
+                    }
+                }
+            }
+            x += n;
+        }
+    }
+
+    xmin = ymin = 0x7FFFFFFF;
+    xmax = ymax = -1;
+}
+
+void GiRasterCanvas::Impl::fillPath(const RasterPath& p, int argb)
+{
+    if (pixels && (argb & 0xFF000000) && !p.empty()) {
+        addPath(p);
+        flush(argb);
+    }
+}
+
+void GiRasterCanvas::Impl::strokePath(const RasterPath& p)
+{
+    if (!pixels || !(penArgb & 0xFF000000) || penStyle == 5 || p.empty()) {
+        return;
+    }
+
+    // 不足一像素宽的线按一像素宽显示，以透明度体现粗细
+    float w = penWidth < 1.f ? 1.f : penWidth;
+    int argb = penArgb;
+    if (penWidth < 1.f) {
+        int a = (int)(((argb >> 24) & 0xFF) * penWidth + 0.5f);
+        argb = (argb & 0x00FFFFFF) | ((a < 1 ? 1 : a) << 24);
+    }
+
+    const RasterPath* src = &p;
+    if (penStyle > 0 && penStyle < 5) {
+        dashPath(p, lpats[penStyle], w);
+        src = &dashes;
+    }
+
+    rings.clear();
+    for (size_t i = 0; i < src->subs.size(); i++) {
+        const RasterPath::Sub& sub = src->subs[i];
+        addStroke(&src->pts[sub.start], sub.count, sub.closed, w / 2, penCap);
+    }
+    addPath(rings);
+    flush(argb);
+}
+
+// 按线型将各子路径分为多个不闭合的实线段，线型长度按线宽缩放
+void GiRasterCanvas::Impl::dashPath(const RasterPath& p, const float* pattern, float scale)
+{
+    int npat = 0;
+    float total = 0;
+
+    while (pattern[npat] > 0.1f)
+        total += pattern[npat++];
+    total *= scale;
+
+    dashes.clear();
+    for (size_t i = 0; i < p.subs.size(); i++) {
+        const RasterPath::Sub& sub = p.subs[i];
+        const RasterPt* pts = &p.pts[sub.start];
+        int nseg = sub.closed ? sub.count : sub.count - 1;
+
+        // 起始相位
+        float phase = fmodf(penPhase, total);
+        int k = 0;
+        if (phase < 0)
+            phase += total;
+        while (phase >= pattern[k] * scale) {
+            phase -= pattern[k] * scale;
+            k = (k + 1) % npat;
+        }
+        float remain = pattern[k] * scale - phase;
+        bool drawing = false;
+
+        for (int j = 0; j < nseg; j++) {
+            RasterPt a(pts[j]);
+            const RasterPt& b = pts[(j + 1) % sub.count];
+            float len = hypotf(b.x - a.x, b.y - a.y);
+
+            while (len > 0) {
+                bool on = (k % 2) == 0;
+                if (on && !drawing) {
+                    dashes.moveTo(a.x, a.y);
+                    drawing = true;
+                }
+                if (remain >= len) {
+                    if (on)
+                        dashes.lineTo(b.x, b.y);
+                    remain -= len;
+                    len = 0;
+                } else {
+                    float t = remain / len;
+                    a = RasterPt(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t);
+                    len -= remain;
+                    if (on) {
+                        dashes.lineTo(a.x, a.y);
+                        drawing = false;
+                    }
+                    k = (k + 1) % npat;
+                    remain = pattern[k] * scale;
+                }
+            }
+        }
+    }
+}
+
+// 将折线的描边转为矩形、连接圆和端点的轮廓，各轮廓环绕方向相同
+void GiRasterCanvas::Impl::addStroke(const RasterPt* pts, int count, bool closed,
+                                     float hw, int cap)
+{
+    int nseg = closed ? count : count - 1;
+    int first = -1, last = -1;
+    float dx0 = 0, dy0 = 0;
+
+    for (int j = 0; j < nseg; j++) {
+        const RasterPt& a = pts[j];
+        const RasterPt& b = pts[(j + 1) % count];
+        float len = hypotf(b.x - a.x, b.y - a.y);
+
+        if (len < 1e-4f)
+            continue;
+
+        float dx = (b.x - a.x) / len, dy = (b.y - a.y) / len;
+
+        if (first < 0) {
+            first = j;
+        } else if (hw * fabsf(dx0 * dy - dy0 * dx) > 0.35f || dx0 * dx + dy0 * dy < 0) {
+            rings.addDisc(a.x, a.y, hw);        // 圆角连接
+        }
+        last = j;
+        dx0 = dx;
+        dy0 = dy;
+
+        RasterPt a2(a), b2(b);
+        if (!closed && (cap & kLineCapSquare)) {
+            if (j == 0) {
+                a2.x -= dx * hw;
+                a2.y -= dy * hw;
+            }
+            if (j == nseg - 1) {
+                b2.x += dx * hw;
+                b2.y += dy * hw;
+            }
+        }
+        rings.addQuad(a2, b2, -dy * hw, dx * hw);
+    }
+
+    if (first < 0) {                            // 没有长度的线显示为点
+        if (count > 0 && !(cap & (kLineCapButt | kLineCapSquare)))
+            rings.addDisc(pts[0].x, pts[0].y, hw);
+    }
+    else if (closed) {
+        rings.addDisc(pts[first].x, pts[first].y, hw);
+    }
+    else if (!(cap & (kLineCapButt | kLineCapSquare))) {
+        rings.addDisc(pts[first].x, pts[first].y, hw);
+        rings.addDisc(pts[(last + 1) % count].x, pts[(last + 1) % count].y, hw);
+    }
+}
+
+GiRasterCanvas::GiRasterCanvas()
+{
+    im = new Impl();
+}
+
+GiRasterCanvas::~GiRasterCanvas()
+{
+    delete im;
+}
+
+bool GiRasterCanvas::attach(unsigned char* pixels, int width, int height, int stride)
+{
+    if (!pixels || width < 1 || height < 1 || (stride != 0 && stride < width * 4)) {
+        return false;
+    }
+
+    Impl::Clip clip = { 0, 0, width, height };
+
+    im->pixels = pixels;
+    im->width = width;
+    im->height = height;
+    im->stride = stride ? stride : width * 4;
+    im->clips.clear();
+    im->clips.push_back(clip);
+    im->acc.assign((width + 2) * height, 0.f);
+    im->path.clear();
+    im->resetAttributes();
+
+    return true;
+}
+
+void GiRasterCanvas::detach()
+{
+    im->pixels = NULL;
+    im->width = im->height = im->stride = 0;
+    im->clips.clear();
+    im->acc.clear();
+}
+
+void GiRasterCanvas::clear(int argb)
+{
+    if (im->pixels) {
+        int a = (argb >> 24) & 0xFF;
+        const unsigned char c[4] = { (unsigned char)mul255((argb >> 16) & 0xFF, a),
+            (unsigned char)mul255((argb >> 8) & 0xFF, a), (unsigned char)mul255(argb & 0xFF, a),
+            (unsigned char)a };
+
+        for (int y = 0; y < im->height; y++) {
+            unsigned char* line = im->pixels + y * im->stride;
+            for (int x = 0; x < im->width; x++)
+                memcpy(line + 4 * x, c, 4);
+        }
+    }
+}
+
+int GiRasterCanvas::width() const
+{
+    return im->width;
+}
+
+int GiRasterCanvas::height() const
+{
+    return im->height;
+}
+
+void GiRasterCanvas::setPen(int argb, float width, int style, float phase, float)
+{
+    if (argb != 0) {
+        im->penArgb = argb;
+    }
+    if (width > 0) {
+        im->penWidth = width;
+    }
+    if (style >= 0) {
+        int linecap = style & kLineCapMask;
+
+        im->penStyle = style & kLineDashMask;
+        im->penPhase = phase;
+        if (linecap)
+            im->penCap = linecap;
+        else
+            im->penCap = (im->penStyle > 0 && im->penStyle < 5) ? kLineCapButt : kLineCapRound;
+    }
+}
+
+void GiRasterCanvas::setBrush(int argb, int style)
+{
+    if (style == 0) {
+        im->brushArgb = argb;
+    }
+}
+
+void GiRasterCanvas::clearRect(float x, float y, float w, float h)
+{
+    if (!im->pixels) {
+        return;
+    }
+
+    const Impl::Clip& c = im->clip();
+    int x0 = (int)floorf(x + 0.5f), y0 = (int)floorf(y + 0.5f);
+    int x1 = (int)floorf(x + w + 0.5f), y1 = (int)floorf(y + h + 0.5f);
+
+    x0 = x0 > c.x0 ? x0 : c.x0;
+    y0 = y0 > c.y0 ? y0 : c.y0;
+    x1 = x1 < c.x1 ? x1 : c.x1;
+    y1 = y1 < c.y1 ? y1 : c.y1;
+    for (int yi = y0; yi < y1; yi++) {
+        if (x0 < x1)
+            memset(im->pixels + yi * im->stride + 4 * x0, 0, 4 * (x1 - x0));
+    }
+}
+
+void GiRasterCanvas::drawRect(float x, float y, float w, float h, bool stroke, bool fill)
+{
+    im->tmp.clear();
+    im->tmp.addRect(x, y, w, h);
+    if (fill)
+        im->fillPath(im->tmp, im->brushArgb);
+    if (stroke)
+        im->strokePath(im->tmp);
+}
+
+void GiRasterCanvas::drawLine(float x1, float y1, float x2, float y2)
+{
+    im->tmp.clear();
+    im->tmp.moveTo(x1, y1);
+    im->tmp.lineTo(x2, y2);
+    im->strokePath(im->tmp);
+}
+
+void GiRasterCanvas::drawEllipse(float x, float y, float w, float h, bool stroke, bool fill)
+{
+    im->tmp.clear();
+    im->tmp.addEllipse(x, y, w, h);
+    if (fill)
+        im->fillPath(im->tmp, im->brushArgb);
+    if (stroke)
+        im->strokePath(im->tmp);
+}
+
+void GiRasterCanvas::beginPath()
+{
+    im->path.clear();
+}
+
+void GiRasterCanvas::moveTo(float x, float y)
+{
+    im->path.moveTo(x, y);
+}
+
+void GiRasterCanvas::lineTo(float x, float y)
+{
+    im->path.lineTo(x, y);
+}
+
+void GiRasterCanvas::bezierTo(float c1x, float c1y, float c2x, float c2y, float x, float y)
+{
+    im->path.bezierTo(c1x, c1y, c2x, c2y, x, y);
+}
+
+void GiRasterCanvas::quadTo(float cpx, float cpy, float x, float y)
+{
+    im->path.quadTo(cpx, cpy, x, y);
+}
+
+void GiRasterCanvas::closePath()
+{
+    im->path.closePath();
+}
+
+void GiRasterCanvas::drawPath(bool stroke, bool fill)
+{
+    if (fill)
+        im->fillPath(im->path, im->brushArgb);
+    if (stroke)
+        im->strokePath(im->path);
+    im->path.clear();
+}
+
+void GiRasterCanvas::saveClip()
+{
+    if (!im->clips.empty()) {
+        Impl::Clip c(im->clip());
+        im->clips.push_back(c);
+    }
+}
+
+void GiRasterCanvas::restoreClip()
+{
+    if (im->clips.size() > 1) {
+        im->clips.pop_back();
+    }
+}
+
+bool GiRasterCanvas::clipRect(float x, float y, float w, float h)
+{
+    im->path.clear();
+    if (im->clips.empty()) {
+        return false;
+    }
+
+    Impl::Clip& c = im->clips.back();
+    int x0 = (int)floorf(x + 0.5f), y0 = (int)floorf(y + 0.5f);
+    int x1 = (int)floorf(x + w + 0.5f), y1 = (int)floorf(y + h + 0.5f);
+
+    c.x0 = x0 > c.x0 ? x0 : c.x0;
+    c.y0 = y0 > c.y0 ? y0 : c.y0;
+    c.x1 = x1 < c.x1 ? x1 : c.x1;
+    c.y1 = y1 < c.y1 ? y1 : c.y1;
+    if (c.x1 < c.x0) c.x1 = c.x0;
+    if (c.y1 < c.y0) c.y1 = c.y0;
+
+    return c.x0 < c.x1 && c.y0 < c.y1;
+}
+
+bool GiRasterCanvas::clipPath()
+{
+    if (im->clips.empty() || im->path.empty()) {
+        im->path.clear();
+        return false;
+    }
+
+    std::vector<unsigned char> mask(im->width * im->height, 0);
+
+    im->addPath(im->path);
+    im->path.clear();
+
+    Impl::Clip& c = im->clips.back();
+    int x0 = im->xmin, y0 = im->ymin, x1 = im->xmax + 1, y1 = im->ymax;
+
+    im->flush(0, &mask.front());
+    c.mask.swap(mask);
+    if (x0 < x1 && y0 < y1) {           // 剪裁矩形缩小到路径的像素范围
+        c.x0 = x0 > c.x0 ? x0 : c.x0;
+        c.y0 = y0 > c.y0 ? y0 : c.y0;
+        c.x1 = x1 < c.x1 ? x1 : c.x1;
+        c.y1 = y1 < c.y1 ? y1 : c.y1;
+    }
+    if (c.x1 < c.x0 || x0 >= x1 || y0 >= y1) c.x1 = c.x0;
+    if (c.y1 < c.y0) c.y1 = c.y0;
+
+    return c.x0 < c.x1 && c.y0 < c.y1;
+}
+
+bool GiRasterCanvas::drawHandle(float x, float y, int)
+{
+    im->tmp.clear();
+    im->tmp.addDisc(x, y, 4.f);
+    im->fillPath(im->tmp, 0xFFFFFFFF);
+    im->tmp.clear();
+    im->tmp.addDisc(x, y, 3.f);
+    im->fillPath(im->tmp, 0xFF0000FF);
+    return im->pixels != NULL;
+}
+
+bool GiRasterCanvas::drawBitmap(const char*, float, float, float, float, float)
+{
+    return false;
+}
+
+float GiRasterCanvas::drawTextAt(const char*, float, float, float, int)
+{
+    return 0;
+}
@@ -5,644 +5,150 @@
 #include "mgshapes.h"
 #include "mgshapet.h"
 #include "mgstorage.h"
+#include "gilock.h"
 #include <string>
+#include <vector>
 
-struct CmdSetPen : public MgRecordShape::ICmd {
-    int argb; float width; int style; float phase; float orgw;
-    CmdSetPen() : argb(0xFF000000), width(0), style(0), phase(0), orgw(0) {}
-    CmdSetPen(int argb, float width, int style, float phase, float orgw)
-        : argb(argb), width(width), style(style), phase(), orgw(orgw) {}
-    
-    virtual int type() const { return 1; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdSetPen& p = (const CmdSetPen&)src;
-            argb = p.argb;
-            width = p.width;
-            style = p.style;
-            phase = p.phase;
-            orgw = p.orgw;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeInt("argb", argb);
-        s->writeFloat("width", width);
-        s->writeInt("style", style);
-        s->writeFloat("phase", phase);
-        s->writeFloat("orgw", orgw);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        argb = s->readInt("argb", argb);
-        width = s->readFloat("width", width);
-        style = s->readInt("style", style);
-        phase = s->readFloat("phase", phase);
-        orgw = s->readFloat("orgw", orgw);
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d&) const {
-        gs.getCanvas()->setPen(argb, width, style, phase, orgw);
-    }
-};
+typedef MgRecordShape::Cell Cell;
+enum { kClip, kSaveClip, kRestoreClip };    // arguments of MgRecordShape::kClipPath
 
-struct CmdSetBrush : public MgRecordShape::ICmd {
-    int argb; int style;
-    CmdSetBrush() {}
-    CmdSetBrush(int argb, int style) : argb(argb), style(style) {}
-    
-    virtual int type() const { return 2; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdSetBrush& p = (const CmdSetBrush&)src;
-            argb = p.argb;
-            style = p.style;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeInt("argb", argb);
-        s->writeInt("style", style);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        argb = s->readInt("argb", argb);
-        style = s->readInt("style", style);
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d&) const {
-        gs.getCanvas()->setBrush(argb, style);
-    }
-};
+// The command tag holds the type in the low byte and the count of argument cells.
+// Text arguments are stored inline after the fixed arguments, padded to cells.
 
-struct CmdClearRect : public MgRecordShape::ICmd {
-    Point2d pt; Vector2d vec;
-    CmdClearRect() {}
-    CmdClearRect(const Matrix2d& d2w, float x, float y, float w, float h)
-        : pt(Point2d(x, y) * d2w), vec(Vector2d(w, h) * d2w) {}
-    
-    virtual int type() const { return 3; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdClearRect& p = (const CmdClearRect&)src;
-            pt = p.pt;
-            vec = p.vec;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        s->writeFloat("w", vec.x);
-        s->writeFloat("h", vec.y);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        pt.set(s->readFloat("x", pt.x), s->readFloat("y", pt.y));
-        vec.set(s->readFloat("w", vec.x), s->readFloat("h", vec.y));
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        Vector2d vec2(vec * w2d);
-        gs.getCanvas()->clearRect(pt2.x, pt2.y, vec2.x, vec2.y);
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, pt + vec); }
-};
+static inline int tagType(const Cell& tag) { return tag.i & 0xFF; }
+static inline int tagCells(const Cell& tag) { return tag.i >> 8; }
 
-struct CmdClipRect : public MgRecordShape::ICmd {
-    Point2d pt; Vector2d vec;
-    CmdClipRect() {}
-    CmdClipRect(const Matrix2d& d2w, float x, float y, float w, float h)
-        : pt(Point2d(x, y) * d2w), vec(Vector2d(w, h) * d2w) {}
-    
-    virtual int type() const { return 18; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdClipRect& p = (const CmdClipRect&)src;
-            pt = p.pt;
-            vec = p.vec;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        s->writeFloat("w", vec.x);
-        s->writeFloat("h", vec.y);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        pt.set(s->readFloat("x", pt.x), s->readFloat("y", pt.y));
-        vec.set(s->readFloat("w", vec.x), s->readFloat("h", vec.y));
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        Vector2d vec2(vec * w2d);
-        gs.getCanvas()->clipRect(pt2.x, pt2.y, vec2.x, vec2.y);
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, pt + vec); }
-};
+static inline void setCellPoint(Cell* a, const Point2d& pt)
+{
+    a[0].f = pt.x;
+    a[1].f = pt.y;
+}
 
-struct CmdDrawRect : public MgRecordShape::ICmd {
-    Point2d pt; Vector2d vec; bool stroke; bool fill;
-    CmdDrawRect() {}
-    CmdDrawRect(const Matrix2d& d2w, float x, float y, float w, float h, bool stroke, bool fill)
-        : pt(Point2d(x, y) * d2w), vec(Vector2d(w, h) * d2w), stroke(stroke), fill(fill) {}
-    
-    virtual int type() const { return 4; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdDrawRect& p = (const CmdDrawRect&)src;
-            pt = p.pt;
-            vec = p.vec;
-            stroke = p.stroke;
-            fill = p.fill;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        s->writeFloat("w", vec.x);
-        s->writeFloat("h", vec.y);
-        s->writeBool("stroke", stroke);
-        s->writeBool("fill", fill);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        pt.set(s->readFloat("x", pt.x), s->readFloat("y", pt.y));
-        vec.set(s->readFloat("w", vec.x), s->readFloat("h", vec.y));
-        stroke = s->readBool("stroke", stroke);
-        fill = s->readBool("fill", fill);
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        Vector2d vec2(vec * w2d);
-        gs.getCanvas()->drawRect(pt2.x, pt2.y, vec2.x, vec2.y, stroke, fill);
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, pt + vec); }
-};
+static inline Point2d cellPoint(const Cell* a, const Matrix2d& m)
+{
+    return Point2d(a[0].f, a[1].f) * m;
+}
 
-struct CmdDrawLine : public MgRecordShape::ICmd {
-    Point2d pt1; Point2d pt2;
-    CmdDrawLine() {}
-    CmdDrawLine(const Matrix2d& d2w, float x1, float y1, float x2, float y2)
-        : pt1(Point2d(x1, y1) * d2w), pt2(Point2d(x2, y2) * d2w) {}
-    
-    virtual int type() const { return 5; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdDrawLine& p = (const CmdDrawLine&)src;
-            pt1 = p.pt1;
-            pt2 = p.pt2;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x1", pt1.x);
-        s->writeFloat("y1", pt1.y);
-        s->writeFloat("x2", pt2.x);
-        s->writeFloat("y2", pt2.y);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        pt1.set(s->readFloat("x1", pt1.x), s->readFloat("y1", pt1.y));
-        pt2.set(s->readFloat("x2", pt2.x), s->readFloat("y2", pt2.y));
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt3(pt1 * w2d);
-        Point2d pt4(pt2 * w2d);
-        gs.getCanvas()->drawLine(pt3.x, pt3.y, pt4.x, pt4.y);
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt1, pt2); }
-};
+static inline Vector2d cellVector(const Cell* a, const Matrix2d& m)
+{
+    return Vector2d(a[0].f, a[1].f) * m;
+}
 
-struct CmdDrawEllipse : public MgRecordShape::ICmd {
-    Point2d pt; Vector2d vec; bool stroke; bool fill;
-    CmdDrawEllipse() {}
-    CmdDrawEllipse(const Matrix2d& d2w, float x, float y, float w, float h, bool stroke, bool fill)
-        : pt(Point2d(x, y) * d2w), vec(Vector2d(w, h) * d2w), stroke(stroke), fill(fill) {}
-    
-    virtual int type() const { return 6; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdDrawEllipse& p = (const CmdDrawEllipse&)src;
-            pt = p.pt;
-            vec = p.vec;
-            stroke = p.stroke;
-            fill = p.fill;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        s->writeFloat("w", vec.x);
-        s->writeFloat("h", vec.y);
-        s->writeBool("stroke", stroke);
-        s->writeBool("fill", fill);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        pt.set(s->readFloat("x", pt.x), s->readFloat("y", pt.y));
-        vec.set(s->readFloat("w", vec.x), s->readFloat("h", vec.y));
-        stroke = s->readBool("stroke", stroke);
-        fill = s->readBool("fill", fill);
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        Vector2d vec2(vec * w2d);
-        gs.getCanvas()->drawEllipse(pt2.x, pt2.y, vec2.x, vec2.y, stroke, fill);
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, pt + vec); }
-};
+// Buffer pool
+//
 
-struct CmdBeginPath : public MgRecordShape::ICmd {
-    CmdBeginPath() {}
-    
-    virtual int type() const { return 7; }
-    virtual void copy(const ICmd&) {}
-    virtual bool save(MgStorage*) const {
-        return true;
-    }
-    virtual bool load(MgStorage*) {
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d&) const {
-        gs.getCanvas()->beginPath();
-    }
+struct MgRecordShape::Buffer {
+    std::vector<Cell>   cells;
 };
 
-struct CmdMoveTo : public MgRecordShape::ICmd {
-    Point2d pt;
-    CmdMoveTo() {}
-    CmdMoveTo(const Matrix2d& d2w, float x, float y) : pt(Point2d(x, y) * d2w) {}
-    
-    virtual int type() const { return 8; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdMoveTo& p = (const CmdMoveTo&)src;
-            pt = p.pt;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        pt.set(s->readFloat("x", pt.x), s->readFloat("y", pt.y));
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        gs.getCanvas()->moveTo(pt2.x, pt2.y);
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, 1e-3f, 0); }
-};
+// Released buffers keep their capacity for the next frames. The list is a plain array
+// guarded by a try-lock, because the shapes may be released in the drawing thread.
+// The pooled capacity is bounded in total, so a burst of large frames can't pin memory.
+static const int kPoolSize = 256;
+static const size_t kMaxPooledCells = 0x4000;           // 64 KB per buffer
+static const size_t kMaxPoolTotalCells = 0x100000;      // 4 MB in the whole pool
+static MgRecordShape::Buffer* s_pool[kPoolSize];
+static int s_poolCount = 0;
+static size_t s_poolCells = 0;
+static volatile long s_poolLock = 0;
 
-struct CmdLineTo : public MgRecordShape::ICmd {
-    Point2d pt;
-    CmdLineTo() {}
-    CmdLineTo(const Matrix2d& d2w, float x, float y) : pt(Point2d(x, y) * d2w) {}
-    
-    virtual int type() const { return 9; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdLineTo& p = (const CmdLineTo&)src;
-            pt = p.pt;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        gs.getCanvas()->lineTo(pt2.x, pt2.y);
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, 1e-3f, 0); }
-};
+// Never spins: when another thread holds the pool, the caller just bypasses it.
+static bool lockPool()
+{
+    return giAtomicCompareAndSwap(&s_poolLock, 1, 0);
+}
 
-struct CmdBezierTo : public MgRecordShape::ICmd {
-    Point2d c1, c2, pt;
-    CmdBezierTo() {}
-    CmdBezierTo(const Matrix2d& d2w, float c1x, float c1y, float c2x, float c2y, float x, float y)
-        : c1(Point2d(c1x, c1y) * d2w), c2(Point2d(c2x, c2y) * d2w), pt(Point2d(x, y) * d2w) {}
-    
-    virtual int type() const { return 10; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdBezierTo& p = (const CmdBezierTo&)src;
-            c1 = p.c1;
-            c2 = p.c2;
-            pt = p.pt;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("c1x", c1.x);
-        s->writeFloat("c1y", c1.y);
-        s->writeFloat("c2x", c2.x);
-        s->writeFloat("c2y", c2.y);
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        c1.x = s->readFloat("c1x", c1.x);
-        c1.y = s->readFloat("c1y", c1.y);
-        c2.x = s->readFloat("c2x", c2.x);
-        c2.y = s->readFloat("c2y", c2.y);
-        pt.x = s->readFloat("x", pt.x);
-        pt.y = s->readFloat("y", pt.y);
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d c1t(c1 * w2d), c2t(c2 * w2d), pt2(pt * w2d);
-        gs.getCanvas()->bezierTo(c1t.x, c1t.y, c2t.x, c2t.y, pt2.x, pt2.y);
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, c1, c2, pt); }
-};
+static void unlockPool()
+{
+    giAtomicCompareAndSwap(&s_poolLock, 0, 1);
+}
 
-struct CmdQuadTo : public MgRecordShape::ICmd {
-    Point2d cp, pt;
-    CmdQuadTo() {}
-    CmdQuadTo(const Matrix2d& d2w, float cpx, float cpy, float x, float y)
-        : cp(Point2d(cpx, cpy) * d2w), pt(Point2d(x, y) * d2w) {}
+static MgRecordShape::Buffer* acquireBuffer()
+{
+    MgRecordShape::Buffer* buf = NULL;
     
-    virtual int type() const { return 11; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdQuadTo& p = (const CmdQuadTo&)src;
-            cp = p.cp;
-            pt = p.pt;
+    if (lockPool()) {
+        if (s_poolCount > 0) {
+            buf = s_pool[--s_poolCount];
+            s_poolCells -= buf->cells.capacity();
         }
+        unlockPool();
     }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("cpx", cp.x);
-        s->writeFloat("cpy", cp.y);
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        cp.x = s->readFloat("cpx", cp.x);
-        cp.y = s->readFloat("cpy", cp.y);
-        pt.x = s->readFloat("x", pt.x);
-        pt.y = s->readFloat("y", pt.y);
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d cp2(cp * w2d), pt2(pt * w2d);
-        gs.getCanvas()->quadTo(cp2.x, cp2.y, pt2.x, pt2.y);
-    }
-    virtual Box2d getExtentW() const { return Box2d(cp, pt); }
-};
-
-struct CmdClosePath : public MgRecordShape::ICmd {
-    CmdClosePath() {}
     
-    virtual int type() const { return 12; }
-    virtual void copy(const ICmd&) {}
-    virtual bool save(MgStorage*) const {
-        return true;
-    }
-    virtual bool load(MgStorage*) {
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d&) const {
-        gs.getCanvas()->closePath();
-    }
-};
+    return buf ? buf : new MgRecordShape::Buffer();
+}
 
-struct CmdDrawPath : public MgRecordShape::ICmd {
-    bool stroke; bool fill;
-    CmdDrawPath() {}
-    CmdDrawPath(bool stroke, bool fill) : stroke(stroke), fill(fill) {}
-    
-    virtual int type() const { return 13; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdDrawPath& p = (const CmdDrawPath&)src;
-            stroke = p.stroke;
-            fill = p.fill;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeBool("stroke", stroke);
-        s->writeBool("fill", fill);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        stroke = s->readBool("stroke", stroke);
-        fill = s->readBool("fill", fill);
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d&) const {
-        gs.getCanvas()->drawPath(stroke, fill);
+static void releaseBuffer(MgRecordShape::Buffer* buf)
+{
+    if (buf->cells.capacity() > kMaxPooledCells) {
+        delete buf;
+        return;
     }
-};
-
-struct CmdClipPath : public MgRecordShape::ICmd {
-    int t;
-    CmdClipPath(int t = 0) : t(t) {}
+    buf->cells.clear();
     
-    enum { Clip, Save, Restore };
-    virtual int type() const { return 17; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdClipPath& p = (const CmdClipPath&)src;
-            t = p.t;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeInt("t", t);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        t = s->readInt("t", t);
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d&) const {
-        switch (t) {
-            case Clip:
-                gs.getCanvas()->clipPath();
-                break;
-            case Save:
-                gs.getCanvas()->saveClip();
-                break;
-            case Restore:
-                gs.getCanvas()->restoreClip();
-                break;
-            default:
-                break;
-        }
-    }
-};
-
-struct CmdDrawHandle : public MgRecordShape::ICmd {
-    Point2d pt; int t;
-    CmdDrawHandle() {}
-    CmdDrawHandle(const Matrix2d& d2w, float x, float y, int t) : pt(Point2d(x, y) * d2w), t(t) {}
+    size_t cells = buf->cells.capacity();
     
-    virtual int type() const { return 14; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdDrawHandle& p = (const CmdDrawHandle&)src;
-            pt = p.pt;
-            t = p.t;
+    if (lockPool()) {
+        if (s_poolCount < kPoolSize && s_poolCells + cells <= kMaxPoolTotalCells) {
+            s_pool[s_poolCount++] = buf;
+            s_poolCells += cells;
+            buf = NULL;
         }
+        unlockPool();
     }
-    virtual bool save(MgStorage* s) const {
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        s->writeInt("t", t);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        pt.x = s->readFloat("x", pt.x);
-        pt.y = s->readFloat("y", pt.y);
-        t = s->readInt("t", t);
-        return true;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        gs.getCanvas()->drawHandle(pt2.x, pt2.y, t);
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, 1e-3f, 0); }
-};
-
-struct CmdDrawBitmap : public MgRecordShape::ICmd {
-    std::string name; Point2d pt; Vector2d vec; float angle;
-    CmdDrawBitmap() {}
-    CmdDrawBitmap(const Matrix2d& d2w, const char* name, float xc, float yc, float w, float h, float angle)
-        : name(name), pt(Point2d(xc, yc) * d2w), vec(Vector2d(w, h) * d2w), angle(angle) {}
     
-    virtual int type() const { return 15; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdDrawBitmap& p = (const CmdDrawBitmap&)src;
-            name = p.name;
-            pt = p.pt;
-            vec = p.vec;
-            angle = p.angle;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeString("name", name.c_str());
-        s->writeFloat("xc", pt.x);
-        s->writeFloat("yc", pt.y);
-        s->writeFloat("w", vec.x);
-        s->writeFloat("h", vec.y);
-        s->writeFloat("angle", angle);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        int len = s->readString("name", NULL, 0);
-        name.resize(len, 0);
-        len = s->readString("name", const_cast<char*>(name.c_str()), (int)name.size());
-        
-        pt.x = s->readFloat("xc", pt.x);
-        pt.y = s->readFloat("yc", pt.y);
-        vec.x = s->readFloat("w", vec.x);
-        vec.y = s->readFloat("h", vec.y);
-        angle = s->readFloat("angle", angle);
-        
-        return len > 0;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        Vector2d vec2(vec * w2d);
-        gs.getCanvas()->drawBitmap(name.c_str(), pt2.x, pt2.y, vec2.x, vec2.y, angle);
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, pt + vec); }
-};
-
-struct CmdDrawTextAt : public MgRecordShape::ICmd {
-    std::string text; Point2d pt; Vector2d vec; int align;
-    CmdDrawTextAt() {}
-    CmdDrawTextAt(const Matrix2d& d2w, const char* text, float x, float y, float h, int align)
-        : text(text), pt(Point2d(x, y) * d2w), vec(Vector2d(h, h) * d2w), align(align) {}
-    
-    virtual int type() const { return 16; }
-    virtual void copy(const ICmd& src) {
-        if (src.type() == type()) {
-            const CmdDrawTextAt& p = (const CmdDrawTextAt&)src;
-            text = p.text;
-            pt = p.pt;
-            vec = p.vec;
-            align = p.align;
-        }
-    }
-    virtual bool save(MgStorage* s) const {
-        s->writeString("text", text.c_str());
-        s->writeFloat("x", pt.x);
-        s->writeFloat("y", pt.y);
-        s->writeFloat("h", vec.x);
-        s->writeInt("align", align);
-        return true;
-    }
-    virtual bool load(MgStorage* s) {
-        int len = s->readString("text", NULL, 0);
-        text.resize(len, 0);
-        len = s->readString("text", const_cast<char*>(text.c_str()), (int)text.size());
-        
-        pt.x = s->readFloat("x", pt.x);
-        pt.y = s->readFloat("y", pt.y);
-        vec.x = s->readFloat("h", vec.x);
-        align = s->readInt("align", align);
-        
-        return len > 0;
-    }
-    virtual void draw(GiGraphics& gs, const Matrix2d& w2d) const {
-        Point2d pt2(pt * w2d);
-        Vector2d vec2(vec * w2d);
-        gs.getCanvas()->drawTextAt(text.c_str(), pt2.x, pt2.y, vec2.x, align);
-    }
-    virtual Box2d getExtentW() const { return Box2d(pt, pt + vec); }
-};
+    delete buf;
+}
 
 // MgRecordShape
 //
 
-MgRecordShape::ICmd* MgRecordShape::createItem(int type) const
+MgRecordShape::MgRecordShape() : _buf(NULL), _count(0), _sid(0)
 {
-    switch (type) {
-        case 1: return new CmdSetPen();
-        case 2: return new CmdSetBrush();
-        case 3: return new CmdClearRect();
-        case 4: return new CmdDrawRect();
-        case 5: return new CmdDrawLine();
-        case 6: return new CmdDrawEllipse();
-        case 7: return new CmdBeginPath();
-        case 8: return new CmdMoveTo();
-        case 9: return new CmdLineTo();
-        case 10: return new CmdBezierTo();
-        case 11: return new CmdQuadTo();
-        case 12: return new CmdClosePath();
-        case 13: return new CmdDrawPath();
-        case 14: return new CmdDrawHandle();
-        case 15: return new CmdDrawBitmap();
-        case 16: return new CmdDrawTextAt();
-        case 17: return new CmdClipPath();
-        case 18: return new CmdClipRect();
-    }
-    return NULL;
+}
+
+MgRecordShape::~MgRecordShape()
+{
+    _clear();
 }
 
 void MgRecordShape::_clear()
 {
-    for (ITEMS::iterator it = _items.begin(); it != _items.end(); ++it) {
-        delete *it;
+    if (_buf) {
+        releaseBuffer(_buf);
+        _buf = NULL;
     }
-    _items.clear();
+    _count = 0;
     _sid = 0;
 }
 
+MgRecordShape::Cell* MgRecordShape::addItem(int type, int n, const char* text)
+{
+    int len = text ? (int)strlen(text) + 1 : 0;
+    int cells = n + (len + (int)sizeof(Cell) - 1) / (int)sizeof(Cell);
+    
+    if (!_buf) {
+        _buf = acquireBuffer();
+    }
+    
+    size_t pos = _buf->cells.size();
+    _buf->cells.resize(pos + 1 + cells);
+    
+    Cell* tag = &_buf->cells[pos];
+    tag->i = type | (cells << 8);
+    if (len > 0) {
+        memcpy(tag + 1 + n, text, len);
+    }
+    _count++;
+    
+    return tag + 1;
+}
+
+void MgRecordShape::addExtent(const Matrix2d& w2m, const Box2d& rectW)
+{
+    _extent.unionWith(rectW * w2m);
+}
+
 MgObject* MgRecordShape::clone() const
 {
     MgRecordShape* p = new MgRecordShape();
@@ -655,11 +161,11 @@ void MgRecordShape::copy(const MgObject& src)
     if (src.isKindOf(Type()) && this != &src) {
         const MgRecordShape& p = (const MgRecordShape&)src;
         _clear();
-        for (ITEMS::const_iterator it = p._items.begin(); it != p._items.end(); ++it) {
-            ICmd* item = createItem((*it)->type());
-            item->copy(**it);
-            _items.push_back(item);
+        if (p._buf && !p._buf->cells.empty()) {
+            _buf = acquireBuffer();
+            _buf->cells = p._buf->cells;
         }
+        _count = p._count;
         _sid = p._sid;
     }
     MgBaseShape::copy(src);
@@ -669,7 +175,7 @@ bool MgRecordShape::equals(const MgObject& src) const
 {
     if (src.isKindOf(Type())) {
         const MgRecordShape& p = (const MgRecordShape&)src;
-        if (_items.size() != p._items.size() || _sid != p._sid)
+        if (_count != p._count || _sid != p._sid)
             return false;
     }
     return MgBaseShape::equals(src);
@@ -677,16 +183,20 @@ bool MgRecordShape::equals(const MgObject& src) const
 
 bool MgRecordShape::save(MgStorage* s) const
 {
-    int i = 0;
     bool ret = true;
     
     s->writeInt("refid", _sid);
-    for (ITEMS::const_iterator it = _items.begin(); ret && it != _items.end(); ++it) {
-        ret = s->writeNode("p", i, false);
-        if (ret) {
-            s->writeInt("type", (*it)->type());
-            ret = (*it)->save(s);
-            s->writeNode("p", i++, true);
+    if (_buf) {
+        const Cell* p = _buf->cells.empty() ? NULL : &_buf->cells.front();
+        const Cell* end = p + _buf->cells.size();
+    
+        for (int i = 0; ret && p < end; p += 1 + tagCells(*p)) {
+            ret = s->writeNode("p", i, false);
+            if (ret) {
+                s->writeInt("type", tagType(*p));
+                ret = saveItem(s, tagType(*p), p + 1);
+                s->writeNode("p", i++, true);
+            }
         }
     }
     return ret && _save(s);
@@ -698,13 +208,7 @@ bool MgRecordShape::load(MgShapeFactory* factory, MgStorage* s)
     
     _sid = s->readInt("refid", _sid);
     for (int i = 0; s->readNode("p", i, false); i++) {
-        ICmd* item = createItem(s->readInt("type", 0));
-        
-        if (item && item->load(s)) {
-            _items.push_back(item);
-        } else {
-            delete item;
-        }
+        loadItem(s, s->readInt("type", 0));
         s->readNode("p", i, true);
     }
     return _load(factory, s);
@@ -713,16 +217,320 @@ bool MgRecordShape::load(MgShapeFactory* factory, MgStorage* s)
 bool MgRecordShape::draw(int mode, GiGraphics& gs, const GiContext& ctx, int segment) const
 {
     const Matrix2d& w2d = gs.xf().worldToDisplay();
-    for (ITEMS::const_iterator it = _items.begin(); it != _items.end(); ++it) {
-        (*it)->draw(gs, w2d);
+    GiCanvas* canvas = gs.getCanvas();
+    
+    if (_buf && !_buf->cells.empty()) {
+        const Cell* p = &_buf->cells.front();
+        const Cell* end = p + _buf->cells.size();
+    
+        for (; p < end; p += 1 + tagCells(*p)) {
+            drawItem(canvas, w2d, tagType(*p), p + 1);
+        }
+    }
+    return _draw(mode, gs, ctx, segment) || _count > 0;
+}
+
+void MgRecordShape::drawItem(GiCanvas* canvas, const Matrix2d& w2d, int type, const Cell* a) const
+{
+    switch (type) {
+        case kSetPen:
+            canvas->setPen(a[0].i, a[1].f, a[2].i, a[3].f, a[4].f);
+            break;
+        case kSetBrush:
+            canvas->setBrush(a[0].i, a[1].i);
+            break;
+        case kClearRect: {
+            Point2d pt(cellPoint(a, w2d));
+            Vector2d vec(cellVector(a + 2, w2d));
+            canvas->clearRect(pt.x, pt.y, vec.x, vec.y);
+            break;
+        }
+        case kClipRect: {
+            Point2d pt(cellPoint(a, w2d));
+            Vector2d vec(cellVector(a + 2, w2d));
+            canvas->clipRect(pt.x, pt.y, vec.x, vec.y);
+            break;
+        }
+        case kDrawRect: {
+            Point2d pt(cellPoint(a, w2d));
+            Vector2d vec(cellVector(a + 2, w2d));
+            canvas->drawRect(pt.x, pt.y, vec.x, vec.y, !!a[4].i, !!a[5].i);
+            break;
+        }
+        case kDrawLine: {
+            Point2d pt1(cellPoint(a, w2d));
+            Point2d pt2(cellPoint(a + 2, w2d));
+            canvas->drawLine(pt1.x, pt1.y, pt2.x, pt2.y);
+            break;
+        }
+        case kDrawEllipse: {
+            Point2d pt(cellPoint(a, w2d));
+            Vector2d vec(cellVector(a + 2, w2d));
+            canvas->drawEllipse(pt.x, pt.y, vec.x, vec.y, !!a[4].i, !!a[5].i);
+            break;
+        }
+        case kBeginPath:
+            canvas->beginPath();
+            break;
+        case kMoveTo: {
+            Point2d pt(cellPoint(a, w2d));
+            canvas->moveTo(pt.x, pt.y);
+            break;
+        }
+        case kLineTo: {
+            Point2d pt(cellPoint(a, w2d));
+            canvas->lineTo(pt.x, pt.y);
+            break;
+        }
+        case kBezierTo: {
+            Point2d c1(cellPoint(a, w2d)), c2(cellPoint(a + 2, w2d)), pt(cellPoint(a + 4, w2d));
+            canvas->bezierTo(c1.x, c1.y, c2.x, c2.y, pt.x, pt.y);
+            break;
+        }
+        case kQuadTo: {
+            Point2d cp(cellPoint(a, w2d)), pt(cellPoint(a + 2, w2d));
+            canvas->quadTo(cp.x, cp.y, pt.x, pt.y);
+            break;
+        }
+        case kClosePath:
+            canvas->closePath();
+            break;
+        case kDrawPath:
+            canvas->drawPath(!!a[0].i, !!a[1].i);
+            break;
+        case kClipPath:
+            switch (a[0].i) {
+                case kClip: canvas->clipPath(); break;
+                case kSaveClip: canvas->saveClip(); break;
+                case kRestoreClip: canvas->restoreClip(); break;
+            }
+            break;
+        case kDrawHandle: {
+            Point2d pt(cellPoint(a, w2d));
+            canvas->drawHandle(pt.x, pt.y, a[2].i);
+            break;
+        }
+        case kDrawBitmap: {
+            Point2d pt(cellPoint(a, w2d));
+            Vector2d vec(cellVector(a + 2, w2d));
+            canvas->drawBitmap((const char*)(a + 5), pt.x, pt.y, vec.x, vec.y, a[4].f);
+            break;
+        }
+        case kDrawTextAt: {
+            Point2d pt(cellPoint(a, w2d));
+            Vector2d vec(cellVector(a + 2, w2d));
+            canvas->drawTextAt((const char*)(a + 5), pt.x, pt.y, vec.x, a[4].i);
+            break;
+        }
     }
-    return _draw(mode, gs, ctx, segment) || !_items.empty();
 }
 
-void MgRecordShape::addItem(const Matrix2d& w2m, ICmd* p)
+bool MgRecordShape::saveItem(MgStorage* s, int type, const Cell* a) const
 {
-    _extent.unionWith(p->getExtentW() * w2m);
-    _items.push_back(p);
+    switch (type) {
+        case kSetPen:
+            s->writeInt("argb", a[0].i);
+            s->writeFloat("width", a[1].f);
+            s->writeInt("style", a[2].i);
+            s->writeFloat("phase", a[3].f);
+            s->writeFloat("orgw", a[4].f);
+            break;
+        case kSetBrush:
+            s->writeInt("argb", a[0].i);
+            s->writeInt("style", a[1].i);
+            break;
+        case kClearRect:
+        case kClipRect:
+        case kDrawRect:
+        case kDrawEllipse:
+            s->writeFloat("x", a[0].f);
+            s->writeFloat("y", a[1].f);
+            s->writeFloat("w", a[2].f);
+            s->writeFloat("h", a[3].f);
+            if (type == kDrawRect || type == kDrawEllipse) {
+                s->writeBool("stroke", !!a[4].i);
+                s->writeBool("fill", !!a[5].i);
+            }
+            break;
+        case kDrawLine:
+            s->writeFloat("x1", a[0].f);
+            s->writeFloat("y1", a[1].f);
+            s->writeFloat("x2", a[2].f);
+            s->writeFloat("y2", a[3].f);
+            break;
+        case kMoveTo:
+        case kLineTo:
+            s->writeFloat("x", a[0].f);
+            s->writeFloat("y", a[1].f);
+            break;
+        case kBezierTo:
+            s->writeFloat("c1x", a[0].f);
+            s->writeFloat("c1y", a[1].f);
+            s->writeFloat("c2x", a[2].f);
+            s->writeFloat("c2y", a[3].f);
+            s->writeFloat("x", a[4].f);
+            s->writeFloat("y", a[5].f);
+            break;
+        case kQuadTo:
+            s->writeFloat("cpx", a[0].f);
+            s->writeFloat("cpy", a[1].f);
+            s->writeFloat("x", a[2].f);
+            s->writeFloat("y", a[3].f);
+            break;
+        case kDrawPath:
+            s->writeBool("stroke", !!a[0].i);
+            s->writeBool("fill", !!a[1].i);
+            break;
+        case kClipPath:
+            s->writeInt("t", a[0].i);
+            break;
+        case kDrawHandle:
+            s->writeFloat("x", a[0].f);
+            s->writeFloat("y", a[1].f);
+            s->writeInt("t", a[2].i);
+            break;
+        case kDrawBitmap:
+            s->writeString("name", (const char*)(a + 5));
+            s->writeFloat("xc", a[0].f);
+            s->writeFloat("yc", a[1].f);
+            s->writeFloat("w", a[2].f);
+            s->writeFloat("h", a[3].f);
+            s->writeFloat("angle", a[4].f);
+            break;
+        case kDrawTextAt:
+            s->writeString("text", (const char*)(a + 5));
+            s->writeFloat("x", a[0].f);
+            s->writeFloat("y", a[1].f);
+            s->writeFloat("h", a[2].f);
+            s->writeInt("align", a[4].i);
+            break;
+    }
+    return true;
+}
+
+static std::string readString(MgStorage* s, const char* name)
+{
+    std::string str;
+    int len = s->readString(name, NULL, 0);
+    
+    if (len > 0) {
+        str.resize(len, 0);
+        len = s->readString(name, const_cast<char*>(str.c_str()), len);
+        str.resize(len > 0 ? len : 0);
+    }
+    return str;
+}
+
+bool MgRecordShape::loadItem(MgStorage* s, int type)
+{
+    Cell* a;
+    
+    switch (type) {
+        case kSetPen:
+            a = addItem(type, 5);
+            a[0].i = s->readInt("argb", 0xFF000000);
+            a[1].f = s->readFloat("width", 0);
+            a[2].i = s->readInt("style", 0);
+            a[3].f = s->readFloat("phase", 0);
+            a[4].f = s->readFloat("orgw", 0);
+            break;
+        case kSetBrush:
+            a = addItem(type, 2);
+            a[0].i = s->readInt("argb", 0);
+            a[1].i = s->readInt("style", 0);
+            break;
+        case kClearRect:
+        case kClipRect:
+        case kDrawRect:
+        case kDrawEllipse: {
+            bool flags = (type == kDrawRect || type == kDrawEllipse);
+            a = addItem(type, flags ? 6 : 4);
+            a[0].f = s->readFloat("x", 0);
+            a[1].f = s->readFloat("y", 0);
+            a[2].f = s->readFloat("w", 0);
+            a[3].f = s->readFloat("h", 0);
+            if (flags) {
+                a[4].i = s->readBool("stroke", false);
+                a[5].i = s->readBool("fill", false);
+            }
+            break;
+        }
+        case kDrawLine:
+            a = addItem(type, 4);
+            a[0].f = s->readFloat("x1", 0);
+            a[1].f = s->readFloat("y1", 0);
+            a[2].f = s->readFloat("x2", 0);
+            a[3].f = s->readFloat("y2", 0);
+            break;
+        case kBeginPath:
+        case kClosePath:
+            addItem(type, 0);
+            break;
+        case kMoveTo:
+        case kLineTo:
+            a = addItem(type, 2);
+            a[0].f = s->readFloat("x", 0);
+            a[1].f = s->readFloat("y", 0);
+            break;
+        case kBezierTo:
+            a = addItem(type, 6);
+            a[0].f = s->readFloat("c1x", 0);
+            a[1].f = s->readFloat("c1y", 0);
+            a[2].f = s->readFloat("c2x", 0);
+            a[3].f = s->readFloat("c2y", 0);
+            a[4].f = s->readFloat("x", 0);
+            a[5].f = s->readFloat("y", 0);
+            break;
+        case kQuadTo:
+            a = addItem(type, 4);
+            a[0].f = s->readFloat("cpx", 0);
+            a[1].f = s->readFloat("cpy", 0);
+            a[2].f = s->readFloat("x", 0);
+            a[3].f = s->readFloat("y", 0);
+            break;
+        case kDrawPath:
+            a = addItem(type, 2);
+            a[0].i = s->readBool("stroke", false);
+            a[1].i = s->readBool("fill", false);
+            break;
+        case kClipPath:
+            a = addItem(type, 1);
+            a[0].i = s->readInt("t", 0);
+            break;
+        case kDrawHandle:
+            a = addItem(type, 3);
+            a[0].f = s->readFloat("x", 0);
+            a[1].f = s->readFloat("y", 0);
+            a[2].i = s->readInt("t", 0);
+            break;
+        case kDrawBitmap: {
+            std::string name(readString(s, "name"));
+            if (name.empty())
+                return false;
+            a = addItem(type, 5, name.c_str());
+            a[0].f = s->readFloat("xc", 0);
+            a[1].f = s->readFloat("yc", 0);
+            a[2].f = s->readFloat("w", 0);
+            a[3].f = s->readFloat("h", 0);
+            a[4].f = s->readFloat("angle", 0);
+            break;
+        }
+        case kDrawTextAt: {
+            std::string text(readString(s, "text"));
+            if (text.empty())
+                return false;
+            a = addItem(type, 5, text.c_str());
+            a[0].f = s->readFloat("x", 0);
+            a[1].f = s->readFloat("y", 0);
+            a[2].f = s->readFloat("h", 0);
+            a[3].f = a[2].f;
+            a[4].i = s->readInt("align", 0);
+            break;
+        }
+        default:
+            return false;
+    }
+    return true;
 }
 
 // GiRecordCanvas
@@ -730,16 +538,12 @@ void MgRecordShape::addItem(const Matrix2d& w2m, ICmd* p)
 
 GiRecordCanvas::GiRecordCanvas(MgShapes* shapes, const GiTransform* xf, int ignoreId)
     : _shapes(shapes), _xf(xf), _ignoreId(ignoreId)
+    , _d2w(xf->displayToWorld()), _w2m(xf->worldToModel()), _known(0), _pending(0)
 {
     _shape = MgShapeT<MgRecordShape>::create();
     _sp = (MgRecordShape*)_shape->shape();
 }
 
-const Matrix2d GiRecordCanvas::d2w() const
-{
-    return _xf->displayToWorld();
-}
-
 void GiRecordCanvas::clear()
 {
     if (_shape) {
@@ -762,6 +566,7 @@ bool GiRecordCanvas::beginShape(int, int sid, int, float, float, float, float)
         clear();
         _shape = MgShapeT<MgRecordShape>::create();
         _sp = (MgRecordShape*)_shape->shape();
+        _pending = _known;  // each record is replayed alone, so it starts with the current pen
     }
     _sp->setRefID(sid);
     
@@ -770,113 +575,216 @@ bool GiRecordCanvas::beginShape(int, int sid, int, float, float, float, float)
 
 void GiRecordCanvas::endShape(int, int, float, float)
 {
-    clear();
-    _shape = MgShapeT<MgRecordShape>::create();
-    _sp = (MgRecordShape*)_shape->shape();
+    if (_sp->getCount() > 0) {
+        clear();
+        _shape = MgShapeT<MgRecordShape>::create();
+        _sp = (MgRecordShape*)_shape->shape();
+        _pending = _known;
+    } else {
+        _sp->setRefID(0);   // reuse the empty shape
+    }
+}
+
+MgRecordShape::Cell* GiRecordCanvas::addItem(int type, int n, const char* text)
+{
+    if (_pending) {     // GiGraphics skips an unchanged pen or brush across shapes
+        int pending = _pending;
+        
+        _pending = 0;
+        if (pending & 1) {
+            Cell* a = _sp->addItem(MgRecordShape::kSetPen, 5);
+            for (int i = 0; i < 5; i++) {
+                a[i] = _pen[i];
+            }
+        }
+        if (pending & 2) {
+            Cell* a = _sp->addItem(MgRecordShape::kSetBrush, 2);
+            a[0] = _brush[0];
+            a[1] = _brush[1];
+        }
+    }
+    return _sp->addItem(type, n, text);
+}
+
+MgRecordShape::Cell* GiRecordCanvas::addRect(int type, float x, float y, float w, float h, int n)
+{
+    Point2d pt(Point2d(x, y) * _d2w);
+    Vector2d vec(Vector2d(w, h) * _d2w);
+    Cell* a = addItem(type, n);
+    
+    setCellPoint(a, pt);
+    a[2].f = vec.x;
+    a[3].f = vec.y;
+    _sp->addExtent(_w2m, Box2d(pt, pt + vec));
+    
+    return a;
+}
+
+MgRecordShape::Cell* GiRecordCanvas::addPoints(int type, int count, const float* xy, int extra)
+{
+    Cell* a = addItem(type, count * 2 + extra);
+    Box2d rect;
+    
+    for (int i = 0; i < count; i++) {
+        Point2d pt(Point2d(xy[2 * i], xy[2 * i + 1]) * _d2w);
+        setCellPoint(a + 2 * i, pt);
+        rect.unionWith(Box2d(pt, 1e-3f, 0));
+    }
+    _sp->addExtent(_w2m, rect);
+    
+    return a;
 }
 
 void GiRecordCanvas::setPen(int argb, float width, int style, float phase, float orgw)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdSetPen(argb, width, style, phase, orgw));
+    Cell* a;
+    
+    _known |= 1;
+    _pending &= ~1;
+    a = addItem(MgRecordShape::kSetPen, 5);
+    a[0].i = argb;
+    a[1].f = width;
+    a[2].i = style;
+    a[3].f = phase;
+    a[4].f = orgw;
+    for (int i = 0; i < 5; i++) {
+        _pen[i] = a[i];
+    }
 }
 
 void GiRecordCanvas::setBrush(int argb, int style)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdSetBrush(argb, style));
+    Cell* a;
+    
+    _known |= 2;
+    _pending &= ~2;
+    a = addItem(MgRecordShape::kSetBrush, 2);
+    a[0].i = argb;
+    a[1].i = style;
+    _brush[0] = a[0];
+    _brush[1] = a[1];
 }
 
 void GiRecordCanvas::clearRect(float x, float y, float w, float h)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdClearRect(d2w(), x, y, w, h));
+    addRect(MgRecordShape::kClearRect, x, y, w, h, 4);
 }
 
 void GiRecordCanvas::drawRect(float x, float y, float w, float h, bool stroke, bool fill)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdDrawRect(d2w(), x, y, w, h, stroke, fill));
+    Cell* a = addRect(MgRecordShape::kDrawRect, x, y, w, h, 6);
+    a[4].i = stroke;
+    a[5].i = fill;
 }
 
 void GiRecordCanvas::drawLine(float x1, float y1, float x2, float y2)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdDrawLine(d2w(), x1, y1, x2, y2));
+    const float xy[] = { x1, y1, x2, y2 };
+    addPoints(MgRecordShape::kDrawLine, 2, xy);
 }
 
 void GiRecordCanvas::drawEllipse(float x, float y, float w, float h, bool stroke, bool fill)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdDrawEllipse(d2w(), x, y, w, h, stroke, fill));
+    Cell* a = addRect(MgRecordShape::kDrawEllipse, x, y, w, h, 6);
+    a[4].i = stroke;
+    a[5].i = fill;
 }
 
 void GiRecordCanvas::beginPath()
 {
-    _sp->addItem(_xf->worldToModel(), new CmdBeginPath());
+    addItem(MgRecordShape::kBeginPath, 0);
 }
 
 void GiRecordCanvas::moveTo(float x, float y)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdMoveTo(d2w(), x, y));
+    const float xy[] = { x, y };
+    addPoints(MgRecordShape::kMoveTo, 1, xy);
 }
 
 void GiRecordCanvas::lineTo(float x, float y)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdLineTo(d2w(), x, y));
+    const float xy[] = { x, y };
+    addPoints(MgRecordShape::kLineTo, 1, xy);
 }
 
 void GiRecordCanvas::bezierTo(float c1x, float c1y, float c2x, float c2y, float x, float y)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdBezierTo(d2w(), c1x, c1y, c2x, c2y, x, y));
+    const float xy[] = { c1x, c1y, c2x, c2y, x, y };
+    addPoints(MgRecordShape::kBezierTo, 3, xy);
 }
 
 void GiRecordCanvas::quadTo(float cpx, float cpy, float x, float y)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdQuadTo(d2w(), cpx, cpy, x, y));
+    const float xy[] = { cpx, cpy, x, y };
+    addPoints(MgRecordShape::kQuadTo, 2, xy);
 }
 
 void GiRecordCanvas::closePath()
 {
-    _sp->addItem(_xf->worldToModel(), new CmdClosePath());
+    addItem(MgRecordShape::kClosePath, 0);
 }
 
 void GiRecordCanvas::drawPath(bool stroke, bool fill)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdDrawPath(stroke, fill));
+    Cell* a = addItem(MgRecordShape::kDrawPath, 2);
+    a[0].i = stroke;
+    a[1].i = fill;
 }
 
 void GiRecordCanvas::saveClip()
 {
-    _sp->addItem(_xf->worldToModel(), new CmdClipPath(CmdClipPath::Save));
+    addItem(MgRecordShape::kClipPath, 1)->i = kSaveClip;
 }
 
 void GiRecordCanvas::restoreClip()
 {
-    _sp->addItem(_xf->worldToModel(), new CmdClipPath(CmdClipPath::Restore));
+    addItem(MgRecordShape::kClipPath, 1)->i = kRestoreClip;
 }
 
 bool GiRecordCanvas::clipRect(float x, float y, float w, float h)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdClipRect(d2w(), x, y, w, h));
+    addRect(MgRecordShape::kClipRect, x, y, w, h, 4);
     return true;
 }
 
 bool GiRecordCanvas::clipPath()
 {
-    _sp->addItem(_xf->worldToModel(), new CmdClipPath(CmdClipPath::Clip));
+    addItem(MgRecordShape::kClipPath, 1)->i = kClip;
     return true;
 }
 
 bool GiRecordCanvas::drawHandle(float x, float y, int type)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdDrawHandle(d2w(), x, y, type));
+    const float xy[] = { x, y };
+    addPoints(MgRecordShape::kDrawHandle, 1, xy, 1)[2].i = type;
     return true;
 }
 
 bool GiRecordCanvas::drawBitmap(const char* name, float xc, float yc,
                                 float w, float h, float angle)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdDrawBitmap(d2w(), name, xc, yc, w, h, angle));
+    Point2d pt(Point2d(xc, yc) * _d2w);
+    Vector2d vec(Vector2d(w, h) * _d2w);
+    Cell* a = addItem(MgRecordShape::kDrawBitmap, 5, name);
+    
+    setCellPoint(a, pt);
+    a[2].f = vec.x;
+    a[3].f = vec.y;
+    a[4].f = angle;
+    _sp->addExtent(_w2m, Box2d(pt, pt + vec));
     return true;
 }
 
 float GiRecordCanvas::drawTextAt(const char* text, float x, float y, float h, int align)
 {
-    _sp->addItem(_xf->worldToModel(), new CmdDrawTextAt(d2w(), text, x, y, h, align));
+    Point2d pt(Point2d(x, y) * _d2w);
+    Vector2d vec(Vector2d(h, h) * _d2w);
+    Cell* a = addItem(MgRecordShape::kDrawTextAt, 5, text);
+    
+    setCellPoint(a, pt);
+    a[2].f = vec.x;
+    a[3].f = vec.y;
+    a[4].i = align;
+    _sp->addExtent(_w2m, Box2d(pt, pt + vec));
     return h;
 }
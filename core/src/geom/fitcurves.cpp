@@ -10,6 +10,7 @@
 
 #include "mgpnt.h"
 #include "mgdblpt.h"
+#include "mgfitcurve.h"
 
 typedef struct {
     Point2d pts[4];
@@ -22,12 +23,26 @@ typedef struct {
     point_t operator[](int i) const { return point_t(d[i].x, d[i].y); }
 } PtArr;
 
-// Forward declarations
 typedef void        (*FitCubicCallback)(void* data, const Point2d curve[4]);
+
+// Scratch buffers shared by all levels of recursion, allocated once per fitting
+typedef struct {
+    FitCubicCallback fc;
+    void        *data;
+    double      *u;         // Parameter values, one per point
+    double      *uPrime;    // Improved parameter values, one per point
+    point_t     *ab;        // A and B arrays of GenerateBezier, two per point
+    int         first;      // Index of first point of the curve being output
+    point_t     tHat1;      // Left tangent of the curve being output
+} FitContext;
+
+// Forward declarations
 void                FitCurve(FitCubicCallback fc, void* data, const Point2d *d, int nPts, float error);
-static  void        FitCubic(FitCubicCallback fc, void* data, const PtArr &d, int first,
+static  void        FitCubic(FitContext &c, const PtArr &d, int first,
                              int last, point_t tHat1, point_t tHat2, double error);
-static  double      *Reparameterize(const PtArr &d, int first, int last, double *u, BezierCurve bezCurve);
+static  void        OutputCubic(FitContext &c, int first, point_t tHat1, const BezierCurve &bezCurve);
+static  void        Reparameterize(const PtArr &d, int first, int last, const double *u,
+                                   double *uPrime, BezierCurve bezCurve);
 static  double      NewtonRaphsonRootFind(BezierCurve Q, point_t P, double u);
 static  point_t     BezierII(int degree, point_t *V, double t);
 static  double      B0(double u), B1(double u), B2(double u), B3(double u);
@@ -35,10 +50,10 @@ static  point_t     ComputeLeftTangent(const PtArr &d, int end);
 static  point_t     ComputeRightTangent(const PtArr &d, int end);
 static  point_t     ComputeCenterTangent(const PtArr &d, int center);
 static  double      ComputeMaxError(const PtArr &d, int first, int last,
-                                    BezierCurve bezCurve, double *u, int &splitPoint);
-static  double      *ChordLengthParameterize(const PtArr &d, int first, int last);
-static  BezierCurve GenerateBezier(const PtArr &d, int first, int last,
-                                   double *uPrime, point_t tHat1, point_t tHat2);
+                                    BezierCurve bezCurve, const double *u, int &splitPoint);
+static  void        ChordLengthParameterize(const PtArr &d, int first, int last, double *u);
+static  BezierCurve GenerateBezier(const PtArr &d, int first, int last, const double *uPrime,
+                                   point_t tHat1, point_t tHat2, point_t *A);
 
 /*
  *  FitCurve :
@@ -51,11 +66,24 @@ void FitCurve(FitCubicCallback fc, void* data, const Point2d *d, int nPts, float
 {
     point_t     tHat1, tHat2;   // Unit tangent vectors at endpoints
     PtArr       arr;
+    FitContext  c;
+
+    if (nPts < 2)
+        return;
 
     arr.d = d;
+    c.fc = fc;
+    c.data = data;
+    c.u = new double[nPts * 2];
+    c.uPrime = c.u + nPts;
+    c.ab = new point_t[nPts * 2];
+
     tHat1 = ComputeLeftTangent(arr, 0);
     tHat2 = ComputeRightTangent(arr, nPts - 1);
-    FitCubic(fc, data, arr, 0, nPts - 1, tHat1, tHat2, error);
+    FitCubic(c, arr, 0, nPts - 1, tHat1, tHat2, error);
+
+    delete[] c.u;
+    delete[] c.ab;
 }
 
 
@@ -67,7 +95,7 @@ void FitCurve(FitCubicCallback fc, void* data, const Point2d *d, int nPts, float
  *  tHat1, tHat2: Unit tangent vectors at endpoints
  *  error: User-defined error squared
  */
-static void FitCubic(FitCubicCallback fc, void* data, const PtArr &d, int first,
+static void FitCubic(FitContext &c, const PtArr &d, int first,
                      int last, point_t tHat1, point_t tHat2, double error)
 {
     BezierCurve bezCurve;       // Control points of fitted Bezier curve
@@ -92,45 +120,58 @@ static void FitCubic(FitCubicCallback fc, void* data, const PtArr &d, int first,
         bezCurve.set(3, d[last]);
         bezCurve.set(1, bezCurve[0] + tHat1.scaledVector(dist));
         bezCurve.set(2, bezCurve[3] + tHat2.scaledVector(dist));
-        (*fc)(data, bezCurve.pts);
+        OutputCubic(c, first, tHat1, bezCurve);
         return;
     }
 
     // Parameterize points, and attempt to fit curve
-    u = ChordLengthParameterize(d, first, last);
-    bezCurve = GenerateBezier(d, first, last, u, tHat1, tHat2);
+    u = c.u;
+    uPrime = c.uPrime;
+    ChordLengthParameterize(d, first, last, u);
+    bezCurve = GenerateBezier(d, first, last, u, tHat1, tHat2, c.ab);
 
     // Find max deviation of points to fitted curve
     maxError = ComputeMaxError(d, first, last, bezCurve, u, splitPoint);
     if (maxError < error) {
-        delete[] u;
-        (*fc)(data, bezCurve.pts);
+        OutputCubic(c, first, tHat1, bezCurve);
         return;
     }
 
     // If error not too large, try some reparameterization and iteration
     if (maxError < iterationError) {
         for (i = 0; i < maxIterations; i++) {
-            uPrime = Reparameterize(d, first, last, u, bezCurve);
-            bezCurve = GenerateBezier(d, first, last, uPrime, tHat1, tHat2);
+            Reparameterize(d, first, last, u, uPrime, bezCurve);
+            bezCurve = GenerateBezier(d, first, last, uPrime, tHat1, tHat2, c.ab);
             maxError = ComputeMaxError(d, first, last, bezCurve, uPrime, splitPoint);
             if (maxError < error) {
-                delete[] u;
-                delete[] uPrime;
-                (*fc)(data, bezCurve.pts);
+                OutputCubic(c, first, tHat1, bezCurve);
                 return;
             }
-            delete[] u;
+            double *tmp = u;    // Swap the buffers instead of reallocating
             u = uPrime;
+            uPrime = tmp;
         }
     }
 
-    // Fitting failed -- split at max error point and fit recursively
-    delete[] u;
+    // Fitting failed -- split at max error point and fit recursively.
+    // The scratch buffers are no longer needed at this level, so reuse them.
     tHatCenter = ComputeCenterTangent(d, splitPoint);
-    FitCubic(fc, data, d, first, splitPoint, tHat1, tHatCenter, error);
+    FitCubic(c, d, first, splitPoint, tHat1, tHatCenter, error);
     tHatCenter = point_t(-tHatCenter.x, -tHatCenter.y);
-    FitCubic(fc, data, d, splitPoint, last, tHatCenter, tHat2, error);
+    FitCubic(c, d, splitPoint, last, tHatCenter, tHat2, error);
+}
+
+
+/*
+ *  OutputCubic :
+ *      Pass a fitted curve to the callback, with the index of its first point
+ *      and its left tangent available in the context
+ */
+static void OutputCubic(FitContext &c, int first, point_t tHat1, const BezierCurve &bezCurve)
+{
+    c.first = first;
+    c.tHat1 = tHat1;
+    (*c.fc)(c.data, bezCurve.pts);
 }
 
 
@@ -141,12 +182,13 @@ static void FitCubic(FitCubicCallback fc, void* data, const PtArr &d, int first,
  *  first, last: Indices defining region
  *  uPrime: Parameter values for region
  *  tHat1, tHat2: Unit tangents at endpoints
+ *  A: Scratch buffer of nPts * 2 items
  */
-static BezierCurve GenerateBezier(const PtArr &d, int first, int last,
-                                  double *uPrime, point_t tHat1, point_t tHat2)
+static BezierCurve GenerateBezier(const PtArr &d, int first, int last, const double *uPrime,
+                                  point_t tHat1, point_t tHat2, point_t *A)
 {
     int     i;
-    point_t *A, *B;                         // Precomputed rhs for eqn
+    point_t *B;                             // Precomputed rhs for eqn
     const int nPts = last - first + 1;      // Number of pts in sub-curve
     double  C[2][2];                        // Matrix C
     double  X[2];                           // Matrix X
@@ -155,8 +197,7 @@ static BezierCurve GenerateBezier(const PtArr &d, int first, int last,
     point_t tmp;                            // Utility variable
     BezierCurve bezCurve;                   // RETURN bezier curve ctl pts
 
-    // Compute the A's
-    A = new point_t[nPts * 2];
+    // Compute the A's, A has room for nPts * 2 items
     B = A + nPts;
     for (i = 0; i < nPts; i++) {
         A[i] = tHat1.scaledVector(B1(uPrime[i]));
@@ -183,8 +224,6 @@ static BezierCurve GenerateBezier(const PtArr &d, int first, int last,
         X[0] += A[i].dotProduct(tmp);
         X[1] += B[i].dotProduct(tmp);
     }
-    
-    delete[] A;
 
     // Compute the determinants of C and X
     det_C0_C1 = C[0][0] * C[1][1] - C[1][0] * C[0][1];
@@ -231,18 +270,17 @@ static BezierCurve GenerateBezier(const PtArr &d, int first, int last,
  *  d: Array of digitized points
  *  first, last: Indices defining region
  *  u: Current parameter values
+ *  uPrime: New parameter values
  *  bezCurve: Current fitted curve
  */
-static double *Reparameterize(const PtArr &d, int first, int last, double *u, BezierCurve bezCurve)
+static void Reparameterize(const PtArr &d, int first, int last, const double *u,
+                           double *uPrime, BezierCurve bezCurve)
 {
     int     i;
-    double  *uPrime;                // New parameter values
 
-    uPrime = new double[last - first + 1];
     for (i = first; i <= last; i++) {
         uPrime[i-first] = NewtonRaphsonRootFind(bezCurve, d[i], u[i - first]);
     }
-    return uPrime;
 }
 
 
@@ -388,12 +426,9 @@ static point_t ComputeCenterTangent(const PtArr &d, int center)
  *  Assign parameter values to digitized points
  *  using relative distances between points.
  */
-static double *ChordLengthParameterize(const PtArr &d, int first, int last)
+static void ChordLengthParameterize(const PtArr &d, int first, int last, double *u)
 {
     int     i;
-    double  *u;         // Parameterization
-
-    u = new double[last-first+1];
 
     u[0] = 0.0;
     for (i = first+1; i <= last; i++) {
@@ -403,8 +438,6 @@ static double *ChordLengthParameterize(const PtArr &d, int first, int last)
     for (i = first + 1; i <= last; i++) {
         u[i-first] = u[i-first] / u[last-first];
     }
-
-    return u;
 }
 
 
@@ -419,7 +452,7 @@ static double *ChordLengthParameterize(const PtArr &d, int first, int last)
  *  splitPoint: Point of maximum error
  */
 static double ComputeMaxError(const PtArr &d, int first, int last,
-                             BezierCurve Q, double *u, int &splitPoint)
+                             BezierCurve Q, const double *u, int &splitPoint)
 {
     int     i;
     double  maxDist = 0; // Maximum error
@@ -440,3 +473,163 @@ static double ComputeMaxError(const PtArr &d, int first, int last,
     }
     return (maxDist);
 }
+
+
+/*
+ *  MgCurveFitter :
+ *      Incremental fitting for live strokes. Curves before the trailing window
+ *      are fixed, only the points of the window are refitted as points arrive.
+ */
+struct MgCurveFitter::Impl {
+    float       tol;            // Max distance between points and fitted curve
+    int         maxWindow;      // Max number of points in the window
+
+    Point2d     *pts;           // Control points, fixed curves then trailing curves
+    int         ptsCapacity;
+    int         fixedCount;     // Number of fixed curves
+    int         tailCount;      // Number of trailing curves fitted from the window
+
+    Point2d     *window;        // Points not covered by the fixed curves
+    int         winCount;
+    bool        hasTangent;     // Whether the window starts at a fixed curve
+    point_t     tHat1;          // Left tangent of the window, continuous with fixed curves
+
+    int         *tailFirst;     // First index in window of each trailing curve
+    point_t     *tailTangent;   // Left tangent of each trailing curve
+    FitContext  c;              // Pooled scratch buffers, maxWindow points
+
+    void appendCurve(const Point2d curve[4]) {
+        int n = (fixedCount + tailCount + 1) * 3 + 1;
+
+        if (n > ptsCapacity) {
+            ptsCapacity = n * 2;
+            Point2d *newpts = new Point2d[ptsCapacity];
+            for (int i = 0; i < n - 4; i++) {   // pts[n - 4] is to be set below
+                newpts[i] = pts[i];
+            }
+            delete[] pts;
+            pts = newpts;
+        }
+        pts[n - 4] = curve[0];
+        pts[n - 3] = curve[1];
+        pts[n - 2] = curve[2];
+        pts[n - 1] = curve[3];
+        if (tailCount < maxWindow) {
+            tailFirst[tailCount] = c.first;
+            tailTangent[tailCount] = c.tHat1;
+        }
+        tailCount++;
+    }
+
+    static void append(void* data, const Point2d curve[4]) {
+        ((Impl*)data)->appendCurve(curve);
+    }
+
+    void removeWindowHead(int count) {
+        for (int i = count; i < winCount; i++) {
+            window[i - count] = window[i];
+        }
+        winCount -= count;
+    }
+};
+
+MgCurveFitter::MgCurveFitter(int maxWindow)
+{
+    im = new Impl();
+    im->tol = 1.f;
+    im->maxWindow = mgMax(maxWindow, 4);
+    im->pts = NULL;
+    im->ptsCapacity = 0;
+    im->window = new Point2d[im->maxWindow];
+    im->tailFirst = new int[im->maxWindow];
+    im->tailTangent = new point_t[im->maxWindow];
+    im->c.fc = &Impl::append;
+    im->c.data = im;
+    im->c.u = new double[im->maxWindow * 2];
+    im->c.uPrime = im->c.u + im->maxWindow;
+    im->c.ab = new point_t[im->maxWindow * 2];
+    clear();
+}
+
+MgCurveFitter::~MgCurveFitter()
+{
+    delete[] im->pts;
+    delete[] im->window;
+    delete[] im->tailFirst;
+    delete[] im->tailTangent;
+    delete[] im->c.u;
+    delete[] im->c.ab;
+    delete im;
+}
+
+void MgCurveFitter::clear()
+{
+    im->fixedCount = 0;
+    im->tailCount = 0;
+    im->winCount = 0;
+    im->hasTangent = false;
+}
+
+void MgCurveFitter::setTolerance(float tol)
+{
+    im->tol = tol;
+}
+
+int MgCurveFitter::getSegmentCount() const
+{
+    return im->fixedCount + im->tailCount;
+}
+
+int MgCurveFitter::getFixedCount() const
+{
+    return im->fixedCount;
+}
+
+const Point2d* MgCurveFitter::getControlPoints() const
+{
+    return im->pts;
+}
+
+bool MgCurveFitter::addPoint(const Point2d& pt)
+{
+    if (im->winCount > 0 && im->window[im->winCount - 1] == pt) {
+        return false;
+    }
+    im->window[im->winCount++] = pt;
+    im->tailCount = 0;
+    if (im->winCount < 2) {
+        return false;
+    }
+
+    PtArr   arr;
+    point_t tHat1, tHat2;
+    int     n = im->winCount;
+
+    arr.d = im->window;
+    tHat1 = im->hasTangent ? im->tHat1 : ComputeLeftTangent(arr, 0);
+    tHat2 = ComputeRightTangent(arr, n - 1);
+    FitCubic(im->c, arr, 0, n - 1, tHat1, tHat2, im->tol * im->tol);
+
+    if (im->tailCount > 1 && im->tailCount <= im->maxWindow) {
+        // Fix all but the last curve, the window restarts at the last split point
+        int k = im->tailCount - 1;
+
+        im->fixedCount += k;
+        im->tailCount = 1;
+        im->tHat1 = im->tailTangent[k];
+        im->hasTangent = true;
+        im->removeWindowHead(im->tailFirst[k]);
+        return true;
+    }
+    if (n == im->maxWindow) {
+        // Window is full, fix the curves and restart at the last point
+        im->fixedCount += im->tailCount;
+        im->tailCount = 0;
+        im->tHat1 = point_t(-tHat2.x, -tHat2.y);
+        im->hasTangent = true;
+        im->removeWindowHead(n - 1);
+        return true;
+    }
+
+    return false;
+}
@@ -37,11 +37,18 @@ void GiGraphics::copy(const GiGraphics& src)
     if (this != &src) {
         m_impl->bkcolor = src.m_impl->bkcolor;
         m_impl->maxPenWidth = src.m_impl->maxPenWidth;
+        m_impl->penWidthFactor = src.m_impl->penWidthFactor;
         m_impl->drawColors = src.m_impl->drawColors;
         m_impl->xform->copy(src.xf());
+        giAtomicIncrement(&m_impl->version);
     }
 }
 
+long GiGraphics::getVersion() const
+{
+    return xf().getVersion() + m_impl->version;
+}
+
 const GiTransform& GiGraphics::xf() const
 {
     return *m_impl->xform;
@@ -76,6 +83,7 @@ bool GiGraphics::beginPaint(GiCanvas* canvas, const RECT_2D& clipBox)
     m_impl->rectDraw.inflate(GiGraphicsImpl::CLIP_INFLATE);
     m_impl->rectDrawM = Box2d(m_impl->rectDraw) * xf().displayToModel();
     m_impl->rectDrawMaxM = xf().getWndRectM();
+    m_impl->rectZoomTimes = xf().getZoomTimes();
     m_impl->rectDrawW = m_impl->rectDrawM * xf().modelToWorld();
     m_impl->rectDrawMaxW = m_impl->rectDrawMaxM * xf().modelToWorld();
     
@@ -112,11 +120,13 @@ void GiGraphics::stopDrawing(bool stopped)
 
 GiCanvas* GiGraphics::getCanvas()
 {
+    m_impl->ctxused = 0;            // 调用者可能直接设置画布的画笔，如回放录制图形
     return m_impl->canvas;
 }
 
 Box2d GiGraphics::getClipModel() const
 {
+    m_impl->checkModelRect();
     return m_impl->rectDrawM;
 }
 
@@ -145,10 +155,12 @@ bool GiGraphics::setClipBox(const RECT_2D& rc)
             m_impl->rectDraw.set(Box2d(rc));
             m_impl->rectDraw.inflate(GiGraphicsImpl::CLIP_INFLATE);
             m_impl->rectDrawM = m_impl->rectDraw * xf().displayToModel();
+            m_impl->rectZoomTimes = xf().getZoomTimes();
             m_impl->rectDrawW = m_impl->rectDrawM * xf().modelToWorld();
             SafeCall(m_impl->canvas, clipRect(m_impl->clipBox.left, m_impl->clipBox.top,
                                               m_impl->clipBox.width(),
                                               m_impl->clipBox.height()));
+            m_impl->ctxused = 0;    // 有的画布剪裁时恢复了绘图状态
         }
         ret = true;
     }
@@ -170,9 +182,11 @@ bool GiGraphics::setClipWorld(const Box2d& rectWorld)
                 m_impl->rectDraw = box;
                 m_impl->rectDraw.inflate(GiGraphicsImpl::CLIP_INFLATE);
                 m_impl->rectDrawM = m_impl->rectDraw * xf().displayToModel();
+                m_impl->rectZoomTimes = xf().getZoomTimes();
                 m_impl->rectDrawW = m_impl->rectDrawM * xf().modelToWorld();
                 SafeCall(m_impl->canvas, clipRect(m_impl->clipBox.left, m_impl->clipBox.top,
                                                   m_impl->clipBox.width(), m_impl->clipBox.height()));
+                m_impl->ctxused = 0;
             }
 
             ret = true;
@@ -190,6 +204,7 @@ bool GiGraphics::isGrayMode() const
 void GiGraphics::setGrayMode(bool gray)
 {
     m_impl->drawColors = gray ? 2 : 0;
+    giAtomicIncrement(&m_impl->version);
 }
 
 GiColor GiGraphics::getBkColor() const
@@ -200,8 +215,10 @@ GiColor GiGraphics::getBkColor() const
 GiColor GiGraphics::setBkColor(const GiColor& color)
 {
     GiColor old(m_impl->bkcolor);
-    if (m_impl->bkcolor != color)
+    if (m_impl->bkcolor != color) {
         m_impl->bkcolor = color;
+        giAtomicIncrement(&m_impl->version);
+    }
     return old;
 }
 
@@ -218,12 +235,17 @@ GiColor GiGraphics::calcPenColor(const GiColor& color) const
     return ret;
 }
 
-static float _penWidthFactor = 1;
-
 void GiGraphics::setPenWidthFactor(float factor)
 {
-    if (factor > 0.1f && factor < 10.f)
-        _penWidthFactor = factor;
+    if (factor > 0.1f && factor < 10.f && m_impl->penWidthFactor != factor) {
+        m_impl->penWidthFactor = factor;
+        giAtomicIncrement(&m_impl->version);
+    }
+}
+
+float GiGraphics::getPenWidthFactor() const
+{
+    return m_impl->penWidthFactor;
 }
 
 float GiGraphics::calcPenWidth(float lineWidth, bool useViewScale) const
@@ -242,7 +264,7 @@ float GiGraphics::calcPenWidth(float lineWidth, bool useViewScale) const
         if (lineWidth < -1e3f)      // 不使用UI放缩系数
             w = 1e3f - lineWidth;
         else
-            w = -lineWidth * _penWidthFactor;
+            w = -lineWidth * m_impl->penWidthFactor;
         if (useViewScale)
             w *= xf().getViewScale();
     }
@@ -268,6 +290,7 @@ void GiGraphics::setMaxPenWidth(float pixels, float minw)
     
     m_impl->maxPenWidth = pixels;
     m_impl->minPenWidth = minw;
+    giAtomicIncrement(&m_impl->version);
 }
 
 static inline const Matrix2d& S2D(const GiTransform& xf, bool modelUnit)
@@ -275,13 +298,17 @@ static inline const Matrix2d& S2D(const GiTransform& xf, bool modelUnit)
     return modelUnit ? xf.modelToDisplay() : xf.worldToDisplay();
 }
 
-static inline const Box2d& DRAW_RECT(const GiGraphicsImpl* p, bool modelUnit)
+static inline const Box2d& DRAW_RECT(GiGraphicsImpl* p, bool modelUnit)
 {
+    if (modelUnit)
+        p->checkModelRect();
     return modelUnit ? p->rectDrawM : p->rectDrawW;
 }
 
-static inline const Box2d& DRAW_MAXR(const GiGraphicsImpl* p, bool modelUnit)
+static inline const Box2d& DRAW_MAXR(GiGraphicsImpl* p, bool modelUnit)
 {
+    if (modelUnit)
+        p->checkModelRect();
     return modelUnit ? p->rectDrawMaxM : p->rectDrawMaxW;
 }
 
@@ -1026,6 +1053,7 @@ bool GiGraphics::drawPath(const GiContext* ctx, const GiPath& path,
 
 bool GiGraphics::setPen(const GiContext* ctx)
 {
+    m_impl->checkContextUsed();
     bool changed = !(m_impl->ctxused & 1);
     
     if (m_impl->canvas) {
@@ -1050,7 +1078,7 @@ bool GiGraphics::setPen(const GiContext* ctx)
     
     ctx = &(m_impl->ctx);
     if (m_impl->canvas && changed) {
-        m_impl->ctxused &= 1;
+        m_impl->ctxused |= 1;       // 属性相同的后续图形不再设置画笔
         float w = calcPenWidth(ctx->getLineWidth(), ctx->isAutoScale());
         float orgw = ctx->getLineWidth();
         orgw = (orgw < -0.1f && ctx->isAutoScale()) ? orgw - 1e4f : orgw;
@@ -1064,6 +1092,7 @@ bool GiGraphics::setPen(const GiContext* ctx)
 
 bool GiGraphics::setBrush(const GiContext* ctx)
 {
+    m_impl->checkContextUsed();
     bool changed = !(m_impl->ctxused & 2);
     
     if (m_impl->canvas) {
@@ -1075,7 +1104,7 @@ bool GiGraphics::setBrush(const GiContext* ctx)
     
     ctx = &(m_impl->ctx);
     if (m_impl->canvas && changed) {
-        m_impl->ctxused &= 2;
+        m_impl->ctxused |= 2;
         m_impl->canvas->setBrush(calcPenColor(ctx->getFillColor()).getARGB(), 0);
     }
     
@@ -1230,6 +1259,7 @@ bool GiGraphics::rawText(const char* text, float x, float y, float h, int align)
 {
     if (m_impl->canvas && text && !m_impl->stopping) {
         m_impl->canvas->drawTextAt(text, x, y, h, align);
+        m_impl->ctxused = 0;        // 有的画布显示文字时改变了画刷
         return true;
     }
     return false;
@@ -1239,6 +1269,7 @@ bool GiGraphics::rawImage(const char* name, float xc, float yc,
                           float w, float h, float angle)
 {
     if (m_impl->canvas && name && !m_impl->stopping) {
+        m_impl->ctxused = 0;
         return m_impl->canvas->drawBitmap(name, xc, yc, w, h, angle);
     }
     return false;
@@ -1248,6 +1279,7 @@ bool GiGraphics::drawHandle(const Point2d& pnt, int type, bool modelUnit)
 {
     if (m_impl->canvas && type >= 0 && !m_impl->stopping) {
         Point2d ptd(pnt * S2D(xf(), modelUnit));
+        m_impl->ctxused = 0;
         return m_impl->canvas->drawHandle(ptd.x, ptd.y, type);
     }
     return false;
@@ -18,12 +18,17 @@ public:
     GiCanvas*   canvas;             //!< 显示适配器
     GiContext   ctx;                //!< 当前绘图参数
     int         ctxused;            //!< 画笔和画刷的设置标志
+    long        ctxVersion;         //!< 设置画笔和画刷时的显示属性改变次数
+    long        ctxZoomTimes;       //!< 设置画笔和画刷时的放缩结果改变次数
     GiColor     bkcolor;            //!< 背景色
 
     float       maxPenWidth;        //!< 最大像素线宽
     float       minPenWidth;        //!< 最小像素线宽
+    float       penWidthFactor;     //!< 像素线宽的放大系数
 
     long        lastZoomTimes;      //!< 记下的放缩结果改变次数
+    long        rectZoomTimes;      //!< 计算模型坐标剪裁矩形时的放缩结果改变次数
+    volatile long   version;        //!< 显示属性改变的次数
     volatile long   stopping;       //!< 是否需要停止绘图
     bool        isPrint;            //!< 是否打印或打印预览
     int         drawColors;         //!< 绘图DC颜色数
@@ -39,12 +44,17 @@ public:
     GiGraphicsImpl(GiTransform* x, bool needFree) : xform(x), needFreeXf(needFree), canvas(NULL)
     {
         drawColors = 0;
+        rectZoomTimes = 0;
         stopping = 0;
+        version = 0;
         isPrint = false;
         ctxused = 0;
+        ctxVersion = 0;
+        ctxZoomTimes = 0;
         bkcolor = GiColor::White();
         maxPenWidth = 100;
         minPenWidth = 1;
+        penWidthFactor = 1;
     }
 
     ~GiGraphicsImpl()
@@ -55,6 +65,7 @@ public:
 
     void zoomChanged()
     {
+        rectZoomTimes = xform->getZoomTimes();
         rectDrawM = rectDraw * xform->displayToModel();
         rectDrawMaxM = xform->getWndRectM();
         rectDrawW = rectDrawM * xform->modelToWorld();
@@ -63,6 +74,26 @@ public:
             canvas->clearCachedBitmap(true);
         }
     }
+    
+    //! 显示中临时改变模型坐标系(GiSaveModelTransform)后重新计算模型坐标的剪裁矩形，不清除缓存位图
+    void checkModelRect()
+    {
+        if (rectZoomTimes != xform->getZoomTimes()) {
+            rectZoomTimes = xform->getZoomTimes();
+            rectDrawM = rectDraw * xform->displayToModel();
+            rectDrawMaxM = xform->getWndRectM();
+        }
+    }
+    
+    //! 显示属性或放缩比例改变后需重新设置画笔和画刷，画笔宽度和颜色与之相关
+    void checkContextUsed()
+    {
+        if (ctxVersion != version || ctxZoomTimes != xform->getZoomTimes()) {
+            ctxVersion = version;
+            ctxZoomTimes = xform->getZoomTimes();
+            ctxused = 0;
+        }
+    }
 
 private:
     GiGraphicsImpl();
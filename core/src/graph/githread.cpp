@@ -0,0 +1,192 @@
+// githread.cpp: 实现常驻工作线程池 GiThreadPool
+// Copyright (c) 2012-2014, https://github.com/rhcad/touchvg
+
+#include "githread.h"
+#ifdef _WIN32
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600      // SRWLOCK, CONDITION_VARIABLE
+#endif
+#ifndef _WINDOWS_
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+// 一次 run() 调用，helpers 为还可加入的工作线程数，active 为正在执行的工作线程数
+struct GiPoolJob {
+    GiThreadPool::Task  task;
+    void*               data;
+    int                 helpers;
+    int                 active;
+    GiPoolJob*          next;
+};
+
+static GiPoolJob* s_jobs = 0;       // 等待工作线程加入的任务，先进先出
+static int s_workers = 0;           // 已创建的工作线程数
+static int s_idle = 0;              // 正在等待任务的工作线程数
+
+#ifdef _WIN32
+static SRWLOCK s_lock = SRWLOCK_INIT;
+static CONDITION_VARIABLE s_workCond = CONDITION_VARIABLE_INIT;
+static CONDITION_VARIABLE s_doneCond = CONDITION_VARIABLE_INIT;
+
+static void lockPool() { AcquireSRWLockExclusive(&s_lock); }
+static void unlockPool() { ReleaseSRWLockExclusive(&s_lock); }
+static void waitWork() { SleepConditionVariableSRW(&s_workCond, &s_lock, INFINITE, 0); }
+static void waitDone() { SleepConditionVariableSRW(&s_doneCond, &s_lock, INFINITE, 0); }
+static void notifyWork() { WakeAllConditionVariable(&s_workCond); }
+static void notifyDone() { WakeAllConditionVariable(&s_doneCond); }
+
+void giYieldThread()
+{
+    SwitchToThread();
+}
+
+int giGetProcessorCount()
+{
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+}
+#else
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_workCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t s_doneCond = PTHREAD_COND_INITIALIZER;
+
+static void lockPool() { pthread_mutex_lock(&s_lock); }
+static void unlockPool() { pthread_mutex_unlock(&s_lock); }
+static void waitWork() { pthread_cond_wait(&s_workCond, &s_lock); }
+static void waitDone() { pthread_cond_wait(&s_doneCond, &s_lock); }
+static void notifyWork() { pthread_cond_broadcast(&s_workCond); }
+static void notifyDone() { pthread_cond_broadcast(&s_doneCond); }
+
+void giYieldThread()
+{
+    sched_yield();
+}
+
+int giGetProcessorCount()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+#endif
+
+// 从等待队列中移除任务，需已加锁
+static void removeJob(GiPoolJob* job)
+{
+    for (GiPoolJob** p = &s_jobs; *p; p = &(*p)->next) {
+        if (*p == job) {
+            *p = job->next;
+            break;
+        }
+    }
+}
+
+// 工作线程循环领取任务，不退出
+static void workerLoop()
+{
+    lockPool();
+    for (;;) {
+        GiPoolJob* job = s_jobs;
+        
+        if (!job) {
+            s_idle++;
+            waitWork();
+            s_idle--;
+            continue;
+        }
+        if (--job->helpers == 0) {
+            s_jobs = job->next;
+        }
+        job->active++;
+        unlockPool();
+        
+        job->task(job->data);
+        
+        lockPool();
+        if (--job->active == 0) {
+            notifyDone();
+        }
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI workerThread(LPVOID)
+#else
+static void* workerThread(void*)
+#endif
+{
+    workerLoop();
+    return 0;
+}
+
+static bool createWorker()
+{
+#ifdef _WIN32
+    HANDLE h = CreateThread(NULL, 0, workerThread, NULL, 0, NULL);
+    if (h) {
+        CloseHandle(h);
+    }
+    return h != NULL;
+#else
+    pthread_t t;
+    if (pthread_create(&t, NULL, workerThread, NULL) != 0) {
+        return false;
+    }
+    pthread_detach(t);
+    return true;
+#endif
+}
+
+void GiThreadPool::run(Task task, void* data, int threads)
+{
+    if (threads < 2) {
+        task(data);
+        return;
+    }
+    
+    GiPoolJob job = { task, data, threads - 1, 0, 0 };
+    int create;
+    
+    lockPool();
+    GiPoolJob** tail = &s_jobs;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = &job;
+    create = job.helpers - s_idle;              // 空闲线程不够时再创建
+    if (create > kMaxThreads - s_workers) {
+        create = kMaxThreads - s_workers;
+    }
+    if (create > 0) {
+        s_workers += create;
+    }
+    notifyWork();
+    unlockPool();
+    
+    for (int i = 0; i < create; i++) {
+        if (!createWorker()) {
+            lockPool();
+            s_workers -= create - i;
+            unlockPool();
+            break;
+        }
+    }
+    
+    task(data);                                 // 调用线程也参与，做完后不再等待未加入的工作线程
+    
+    lockPool();
+    if (job.helpers > 0) {
+        removeJob(&job);
+        job.helpers = 0;
+    }
+    while (job.active > 0) {
+        waitDone();
+    }
+    unlockPool();
+}
@@ -29,6 +29,7 @@ struct GiTransformImpl
     Point2d     tmpCenterW;     //!< 当前放缩结果，不论是否允许放缩
     float       tmpViewScale;   //!< 当前放缩结果，不论是否允许放缩
     volatile long   zoomTimes;  //!< 放缩结果改变的次数
+    volatile long   version;    //!< 坐标系参数改变的次数
 
     float       minViewScale;   //!< 最小显示比例
     float       maxViewScale;   //!< 最大显示比例
@@ -36,7 +37,7 @@ struct GiTransformImpl
 
     GiTransformImpl(bool _ydown)
         : cxWnd(1), cyWnd(1), dpiX(96), dpiY(96), ydown(_ydown), viewScale(1)
-        , zoomEnabled(true), tmpViewScale(1.f), zoomTimes(0)
+        , zoomEnabled(true), tmpViewScale(1.f), zoomTimes(0), version(0)
     {
         minViewScale = 0.01f;   // 最小显示比例为1%
         maxViewScale = 5.f;     // 最大显示比例为500%
@@ -61,6 +62,7 @@ struct GiTransformImpl
 
         matD2M = matD2W * matW2M;
         matM2D = matM2W * matW2D;
+        changed();
     }
 
     void copyFrom(const GiTransformImpl* src)
@@ -86,11 +88,18 @@ struct GiTransformImpl
         tmpCenterW = src->tmpCenterW;
         tmpViewScale = src->tmpViewScale;
         zoomTimes = src->zoomTimes;
+        changed();
     }
 
     void zoomChanged()
     {
         giAtomicIncrement(&zoomTimes);
+        changed();
+    }
+    
+    void changed()
+    {
+        giAtomicIncrement(&version);
     }
 
     bool zoomNoAdjust(const Point2d& pnt, float scale, bool* changed = NULL)
@@ -176,6 +185,11 @@ float GiTransform::displayToModel(float px, bool mm) const
         : (Vector2d(px,px) * m_impl->matD2M).length() * _M_SQRT1_2;
 }
 
+long GiTransform::getVersion() const
+{
+    return m_impl->version;
+}
+
 long GiTransform::getZoomTimes() const
 {
     return m_impl->zoomTimes;
@@ -248,6 +262,7 @@ void GiTransform::setViewScaleRange(float minScale, float maxScale)
 
     m_impl->minViewScale = minScale;
     m_impl->maxViewScale = maxScale;
+    m_impl->changed();
 }
 
 Box2d GiTransform::setWorldLimits(const Box2d& rect)
@@ -255,6 +270,7 @@ Box2d GiTransform::setWorldLimits(const Box2d& rect)
     Box2d ret = m_impl->rectLimitsW;
     m_impl->rectLimitsW = rect.isEmpty() ? Box2d(Point2d::kOrigin(), 2e5f, 2e5f) : rect;
     m_impl->rectLimitsW.normalize();
+    m_impl->changed();
     return ret;
 }
 
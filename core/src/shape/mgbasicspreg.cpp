@@ -7,6 +7,7 @@
 #include "mgcomposite.h"
 #include "mggrid.h"
 #include "mgpathsp.h"
+#include "mgsymbol.h"
 
 void MgBasicShapes::registerShapes(MgShapeFactory* factory)
 {
@@ -25,4 +26,5 @@ void MgBasicShapes::registerShapes(MgShapeFactory* factory)
     MgShapeT<MgArc>::registerCreator(factory);
     MgShapeT<MgGrid>::registerCreator(factory);
     MgShapeT<MgPathShape>::registerCreator(factory);
+    MgShapeT<MgSymbolShape>::registerCreator(factory);
 }
@@ -3,15 +3,215 @@
 // License: LGPL, https://github.com/rhcad/touchvg
 
 #include "mgcomposite.h"
+#include <vector>
+
+// 子图形索引：按显示次序保存各子图形的包络框和控制点序号，每 kGroup 个相邻子图形再合成一个包络框，
+// 查询时整组跳过不相交的子图形。只在 update() 等修改图形时重建，查询时只读，可在多个线程中显示。
+struct MgComposite::ChildIndex
+{
+    enum { kGroup = 16 };
+    struct Child {
+        const MgShape*  sp;
+        Box2d           extent;
+        long            changeCount;    // 子图形的改变计数，用于增量更新
+        int             handleEnd;      // 此子图形及之前所有子图形的控制点数
+    };
+    std::vector<Child>  children;
+    std::vector<Box2d>  groups;         // 相邻子图形的包络框
+    Box2d               extent;         // 所有子图形的包络框
+    long                listChange;     // 建立索引时子图形列表的改变计数
+    const MgShape*      head;
+    const MgShape*      last;
+    bool                built;
+    
+    ChildIndex() : listChange(0), head(NULL), last(NULL), built(false) {}
+    
+    bool isValid(const MgShapes* shapes) const {
+        return built && listChange == shapes->getChangeCount()
+            && head == shapes->getHeadShape() && last == shapes->getLastShape();
+    }
+    Box2d rebuild(const MgShapes* shapes);
+    Box2d update(const MgShapes* shapes);
+    void updateGroup(size_t g);
+    int traverse(const Box2d& rect, bool (*c)(const MgShape*, void*), void* d) const;
+    const MgShape* findHandle(int& handle) const;  // 返回控制点所在的子图形，并转为其控制点序号
+};
+
+Box2d MgComposite::ChildIndex::rebuild(const MgShapes* shapes)
+{
+    MgShapeIterator it(shapes);
+    int handles = 0;
+    
+    children.clear();
+    while (const MgShape* sp = it.getNext()) {
+        Child child;
+        
+        child.sp = sp;
+        child.extent = sp->shapec()->getExtent();
+        child.changeCount = sp->shapec()->getChangeCount();
+        handles += sp->shapec()->getHandleCount();
+        child.handleEnd = handles;
+        children.push_back(child);
+    }
+    groups.resize((children.size() + kGroup - 1) / kGroup);
+    extent.empty();
+    for (size_t g = 0; g < groups.size(); g++) {
+        updateGroup(g);
+        extent.unionWith(groups[g]);
+    }
+    listChange = shapes->getChangeCount();
+    head = shapes->getHeadShape();
+    last = shapes->getLastShape();
+    built = true;
+    
+    return extent;
+}
+
+void MgComposite::ChildIndex::updateGroup(size_t g)
+{
+    size_t end = mgMin(children.size(), (g + 1) * kGroup);
+    
+    groups[g].empty();
+    for (size_t i = g * kGroup; i < end; i++) {
+        groups[g].unionWith(children[i].extent);
+    }
+}
+
+// 子图形个数未变时只重新取改变或换入的子图形，变化的子图形原来在边界上时才由各组重新合成包络框
+Box2d MgComposite::ChildIndex::update(const MgShapes* shapes)
+{
+    if (!built) {
+        return rebuild(shapes);
+    }
+    
+    MgShapeIterator it(shapes);
+    Box2d oldExtent(extent);
+    bool shrink = false, handlesChanged = false;
+    size_t i = 0, dirtyGroup = groups.size();
+    
+    for (; ; i++) {
+        const MgShape* sp = it.getNext();
+        
+        if (!sp != (i == children.size())) {        // 增删了子图形
+            return rebuild(shapes);
+        }
+        if (!sp) {
+            break;
+        }
+        
+        Child& child = children[i];
+        if (sp == child.sp && child.changeCount == sp->shapec()->getChangeCount()) {
+            continue;
+        }
+        const Box2d& o = child.extent;
+        shrink = shrink || o.xmin <= oldExtent.xmin || o.ymin <= oldExtent.ymin
+            || o.xmax >= oldExtent.xmax || o.ymax >= oldExtent.ymax;
+        child.sp = sp;
+        child.extent = sp->shapec()->getExtent();
+        child.changeCount = sp->shapec()->getChangeCount();
+        extent.unionWith(child.extent);
+        
+        int handles = child.handleEnd - (i > 0 ? children[i - 1].handleEnd : 0);
+        handlesChanged = handlesChanged || handles != sp->shapec()->getHandleCount();
+        
+        if (dirtyGroup != i / kGroup) {
+            if (dirtyGroup < groups.size())
+                updateGroup(dirtyGroup);
+            dirtyGroup = i / kGroup;
+        }
+    }
+    if (dirtyGroup < groups.size()) {
+        updateGroup(dirtyGroup);
+    }
+    if (handlesChanged) {                           // 控制点数变了则重新累计
+        int handles = 0;
+        for (i = 0; i < children.size(); i++) {
+            handles += children[i].sp->shapec()->getHandleCount();
+            children[i].handleEnd = handles;
+        }
+    }
+    if (shrink) {
+        extent.empty();
+        for (i = 0; i < groups.size(); i++) {
+            extent.unionWith(groups[i]);
+        }
+    }
+    listChange = shapes->getChangeCount();
+    head = shapes->getHeadShape();
+    last = shapes->getLastShape();
+    
+    return extent;
+}
+
+int MgComposite::ChildIndex::traverse(const Box2d& rect, bool (*c)(const MgShape*, void*),
+                                      void* d) const
+{
+    int n = 0;
+    
+    for (size_t g = 0; g < groups.size(); g++) {
+        if (!groups[g].isIntersect(rect))
+            continue;
+        
+        size_t end = mgMin(children.size(), (g + 1) * kGroup);
+        for (size_t i = g * kGroup; i < end; i++) {
+            if (children[i].extent.isIntersect(rect)) {
+                n++;
+                if (!c(children[i].sp, d))
+                    return n;
+            }
+        }
+    }
+    
+    return n;
+}
+
+const MgShape* MgComposite::ChildIndex::findHandle(int& handle) const
+{
+    int lo = 0, hi = (int)children.size();
+    
+    while (lo < hi) {                               // 第一个 handleEnd > handle 的子图形
+        int mid = (lo + hi) / 2;
+        if (children[mid].handleEnd > handle)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    if (handle < 0 || lo == (int)children.size())
+        return NULL;
+    handle -= lo > 0 ? children[lo - 1].handleEnd : 0;
+    return children[lo].sp;
+}
 
 MgComposite::MgComposite() : _owner(NULL)
 {
     _shapes = MgShapes::create(this);
+    _index = new ChildIndex();
 }
 
 MgComposite::~MgComposite()
 { 
     _shapes->release();
+    delete _index;
+}
+
+int MgComposite::traverseChildren(const Box2d& rect, bool (*c)(const MgShape*, void*), void* d) const
+{
+    if (_index->isValid(_shapes)) {
+        return _index->traverse(rect, c, d);
+    }
+    
+    MgShapeIterator it(_shapes);
+    int n = 0;
+    
+    while (const MgShape* sp = it.getNext()) {
+        if (sp->shapec()->getExtent().isIntersect(rect)) {
+            n++;
+            if (!c(sp, d))
+                break;
+        }
+    }
+    
+    return n;
 }
 
 bool MgComposite::_isKindOf(int type) const
@@ -42,6 +242,10 @@ void MgComposite::_setPoint(int, const Point2d&)
 
 int MgComposite::_getHandleCount() const
 {
+    if (_index->isValid(_shapes)) {
+        return _index->children.empty() ? 0 : _index->children.back().handleEnd;
+    }
+    
     int n = 0;
     MgShapeIterator it(_shapes);
     
@@ -54,6 +258,11 @@ int MgComposite::_getHandleCount() const
 
 Point2d MgComposite::_getHandlePoint(int index) const
 {
+    if (_index->isValid(_shapes)) {
+        const MgShape* sp = _index->findHandle(index);
+        return sp ? sp->shapec()->getHandlePoint(index) : getExtent().center();
+    }
+    
     int n = 0;
     MgShapeIterator it(_shapes);
     
@@ -75,6 +284,11 @@ bool MgComposite::_setHandlePoint(int index, const Point2d& pt, float)
 
 int MgComposite::_getHandleType(int index) const
 {
+    if (_index->isValid(_shapes)) {
+        const MgShape* sp = _index->findHandle(index);
+        return sp ? sp->shapec()->getHandleType(index) : kMgHandleOutside;
+    }
+    
     int n = 0;
     MgShapeIterator it(_shapes);
     
@@ -91,6 +305,11 @@ int MgComposite::_getHandleType(int index) const
 
 bool MgComposite::_isHandleFixed(int index) const
 {
+    if (_index->isValid(_shapes)) {
+        const MgShape* sp = _index->findHandle(index);
+        return sp ? sp->shapec()->isHandleFixed(index) : true;
+    }
+    
     int n = 0;
     MgShapeIterator it(_shapes);
     
@@ -118,12 +337,7 @@ void MgComposite::_clearCachedData()
 
 void MgComposite::_update()
 {
-    MgShapeIterator it(_shapes);
-    _extent.empty();
-
-    while (const MgShape* sp = it.getNext()) {
-        _extent.unionWith(sp->shapec()->getExtent());
-    }
+    _extent = _index->update(_shapes);
     __super::_update();
 }
 
@@ -133,17 +347,20 @@ void MgComposite::_transform(const Matrix2d& mat)
     while (MgShape* sp = const_cast<MgShape*>(it.getNext())) {
         sp->shape()->transform(mat);
     }
+    _index->built = false;          // 子图形变形后未增加改变计数，在 update() 中重建索引
 }
 
 void MgComposite::_clear()
 {
     _shapes->clear();
+    _index->built = false;
     MgBaseShape::_clear();
 }
 
 void MgComposite::_copy(const MgComposite& src)
 {
     _shapes->copyShapes(src._shapes);
+    _index->built = false;
     __super::_copy(src);
 }
 
@@ -152,30 +369,60 @@ bool MgComposite::_equals(const MgComposite& src) const
     return _shapes->equals(*(src._shapes)) && __super::_equals(src);
 }
 
-float MgComposite::_hitTest(const Point2d& pt, float tol, MgHitResult& res) const
+struct CompositeHitData {
+    Point2d         pt;
+    float           tol;
+    MgHitResult*    res;
+};
+
+static bool hitTestChild(const MgShape* sp, void* data)
 {
-    MgShapeIterator it(_shapes);
+    CompositeHitData* d = (CompositeHitData*)data;
     MgHitResult tmpRes;
-    Box2d limits(pt, 2 * tol, 0);
+    float dist = sp->shapec()->hitTest(d->pt, d->tol, tmpRes);
+    
+    if (d->res->dist > dist - _MGZERO) {
+        *d->res = tmpRes;
+        d->res->dist = dist;
+        d->res->segment = sp->getID();
+    }
+    return true;
+}
+
+float MgComposite::_hitTest(const Point2d& pt, float tol, MgHitResult& res) const
+{
+    CompositeHitData data = { pt, tol, &res };
 
     res.segment = 0;
     res.dist = _FLT_MAX;
-
-    while (const MgShape* sp = it.getNext()) {
-        if (limits.isIntersect(sp->shapec()->getExtent())) {
-            float d = sp->shapec()->hitTest(pt, tol, tmpRes);
-            if (res.dist > d - _MGZERO)
-            {
-                res = tmpRes;
-                res.dist = d;
-                res.segment = sp->getID();
-            }
-        }
-    }
+    traverseChildren(Box2d(pt, 2 * tol, 0), hitTestChild, &data);
 
     return res.dist;
 }
 
+struct CompositeBoxData {
+    const Box2d*    rect;
+    bool            hit;
+};
+
+static bool hitTestChildBox(const MgShape* sp, void* data)
+{
+    CompositeBoxData* d = (CompositeBoxData*)data;
+    
+    d->hit = sp->shapec()->hitTestBox(*d->rect);
+    return !d->hit;                 // 有一个子图形相交就停止
+}
+
+bool MgComposite::_hitTestBox(const Box2d& rect) const
+{
+    CompositeBoxData data = { &rect, false };
+    
+    if (getExtent().isIntersect(rect)) {
+        traverseChildren(rect, hitTestChildBox, &data);
+    }
+    return data.hit;
+}
+
 bool MgComposite::_offset(const Vector2d& vec, int)
 {
     MgShapeIterator it(_shapes);
@@ -184,20 +431,33 @@ bool MgComposite::_offset(const Vector2d& vec, int)
     while (MgShape* sp = const_cast<MgShape*>(it.getNext())) {
         n += sp->shape()->offset(vec, -1) ? 1 : 0;
     }
+    _index->built = false;
 
     return n > 0;
 }
 
-bool MgComposite::_draw(int mode, GiGraphics& gs, const GiContext& ctx, int) const
+struct CompositeDrawData {
+    int             mode;
+    GiGraphics*     gs;
+    const GiContext* ctx;
+    int             count;
+};
+
+static bool drawChild(const MgShape* sp, void* data)
 {
-    MgShapeIterator it(_shapes);
-    int n = 0;
+    CompositeDrawData* d = (CompositeDrawData*)data;
+    
+    d->count += sp->draw(d->mode, *d->gs, d->ctx, -1) ? 1 : 0;
+    return !d->gs->isStopping();
+}
 
-    while (const MgShape* sp = it.getNext()) {
-        n += sp->draw(mode, gs, ctx.isNullLine() ? NULL : &ctx, -1) ? 1 : 0;
-    }
+bool MgComposite::_draw(int mode, GiGraphics& gs, const GiContext& ctx, int) const
+{
+    CompositeDrawData data = { mode, &gs, ctx.isNullLine() ? NULL : &ctx, 0 };
+    
+    traverseChildren(gs.getClipModel(), drawChild, &data);  // 跳过显示区域外的子图形
 
-    return n > 0;
+    return data.count > 0;
 }
 
 void MgComposite::_output(GiPath& path) const
@@ -226,7 +486,9 @@ bool MgGroup::_offset(const Vector2d& vec, int segment)
     MgShape* sp = const_cast<MgShape*>(_shapes->findShape(segment));
 
     if (sp && canOffsetShapeAlone(sp)) {
-        return sp->shape()->offset(vec, -1);
+        bool ret = sp->shape()->offset(vec, -1);
+        sp->shape()->update();      // 增加改变计数，本图形 update() 时只更新这个子图形的索引
+        return ret;
     }
 
     return __super::_offset(vec, segment);
@@ -4,19 +4,21 @@
 
 #include "mgbasicsp.h"
 #include "mgshape_.h"
+#include "mgpool.h"
+#include <new>
 
 // MgBaseLines
 //
 
 MgBaseLines::MgBaseLines()
-    : _points(NULL), _maxCount(0), _count(0)
+    : _points(NULL), _maxCount(0), _count(0), _segtree(NULL), _segcount(0), _segstate(0)
 {
 }
 
 MgBaseLines::~MgBaseLines()
 {
-    if (_points)
-        delete[] _points;
+    MgPool::deallocate(_points, _maxCount * sizeof(Point2d));
+    delete[] _segtree;
 }
 
 bool MgBaseLines::_isClosed() const
@@ -38,11 +40,13 @@ void MgBaseLines::_setPoint(int index, const Point2d& pt)
 {
     if (index >= 0 && index < _count) {
         _points[index] = pt;
+        freeSegmentTree();
     }
 }
 
 void MgBaseLines::_copy(const MgBaseLines& src)
 {
+    freeSegmentTree();
     resize(src._count);
     for (int i = 0; i < _count; i++)
         _points[i] = src._points[i];
@@ -68,8 +72,10 @@ bool MgBaseLines::isIncrementFrom(const MgBaseLines& src) const
     if (_count <= src._count)
         return false;
     
+    const Tol tol(minTol());
+    
     for (int i = 0; i < src._count; i++) {
-        if (!_points[i].isEqualTo(src._points[i], minTol()))
+        if (!_points[i].isEqualTo(src._points[i], tol))
             return false;
     }
     
@@ -83,6 +89,7 @@ bool MgBaseLines::_isKindOf(int type) const
 
 void MgBaseLines::_update()
 {
+    freeSegmentTree();
     _extent.set(_count, _points);
     if (_extent.isEmpty() && _points)
         _extent.set(_points[0], 2 * Tol::gTol().equalPoint(), 0);
@@ -91,6 +98,7 @@ void MgBaseLines::_update()
 
 void MgBaseLines::_transform(const Matrix2d& mat)
 {
+    freeSegmentTree();
     for (int i = 0; i < _count; i++)
         _points[i] *= mat;
     __super::_transform(mat);
@@ -98,10 +106,17 @@ void MgBaseLines::_transform(const Matrix2d& mat)
 
 void MgBaseLines::_clear()
 {
+    freeSegmentTree();
     _count = 0;
     __super::_clear();
 }
 
+void MgBaseLines::_clearCachedData()
+{
+    freeSegmentTree(false);             // 图形可能正被其他线程显示，只释放空闲的索引
+    __super::_clearCachedData();
+}
+
 Point2d MgBaseLines::endPoint() const
 {
     return _count > 0 ? _points[_count - 1] : Point2d();
@@ -109,15 +124,18 @@ Point2d MgBaseLines::endPoint() const
 
 bool MgBaseLines::resize(int count)
 {
+    freeSegmentTree();
     if (_maxCount < count) {
-        _maxCount = (count + 32 - 1) / 32 * 32;
+        int oldMax = _maxCount;
+        _maxCount = (mgMax(count, oldMax + oldMax / 2) + 32 - 1) / 32 * 32;  // 逐点增加时按比例扩大
 
-        Point2d* pts = new Point2d[_maxCount];
+        Point2d* pts = (Point2d*)MgPool::allocate(_maxCount * sizeof(Point2d));
 
         for (int i = 0; i < _count; i++)
             pts[i] = _points[i];
-        if (_points)
-            delete[] _points;
+        for (int j = _count; j < _maxCount; j++)
+            new (pts + j) Point2d();
+        MgPool::deallocate(_points, oldMax * sizeof(Point2d));
         _points = pts;
     }
     _count = count;
@@ -156,6 +174,7 @@ bool MgBaseLines::removePoint(int index)
     bool ret = false;
     
     if (index < _count && _count > 1) {
+        freeSegmentTree();
         for (int i = index + 1; i < _count; i++)
             _points[i - 1] = _points[i];
         _count--;
@@ -195,17 +214,162 @@ float MgBaseLines::_hitTest(const Point2d& pt, float tol, MgHitResult& res) cons
                             res.nearpt, res.segment, &res.inside);
 }
 
+static bool stopAtFirst(int, void*) { return false; }
+
 bool MgBaseLines::_hitTestBox(const Box2d& rect) const
 {
     if (!__super::_hitTestBox(rect))
         return false;
+    return _count < 2 || traverseSegmentTree(rect, NULL, stopAtFirst, NULL) > 0;
+}
+
+// 边的包络框层次索引：底层每 kSegGroup 条相邻边合并为一个节点，上层每两个节点合并，
+// 各层依次存放在同一数组中。笔迹的相邻边在空间上也相邻，按顺序分组即可得到紧凑的包络框。
+enum { kSegGroup = 8, kMinTreeSegs = 32, kMaxTreeLevels = 32 };
+
+static int segTreeLevels(int n, int offsets[kMaxTreeLevels + 1])
+{
+    int levels = 0, size = (n + kSegGroup - 1) / kSegGroup, total = 0;
+    
+    for (;;) {
+        offsets[levels++] = total;
+        total += size;
+        if (size < 2)
+            break;
+        size = (size + 1) / 2;
+    }
+    offsets[levels] = total;
     
-    for (int i = 0; i + 1 < _count; i++) {
-        if (Box2d(_points[i], _points[i + 1]).isIntersect(rect))
+    return levels;
+}
+
+static void unionBox(Box2d& box, const Box2d& r)  // 不同于 unionWith，水平或竖直边的框也合并
+{
+    box.xmin = mgMin(box.xmin, r.xmin);
+    box.ymin = mgMin(box.ymin, r.ymin);
+    box.xmax = mgMax(box.xmax, r.xmax);
+    box.ymax = mgMax(box.ymax, r.ymax);
+}
+
+struct SegTreeQuery {
+    const Box2d*    tree;
+    const int*      offsets;
+    const Box2d*    boxes;
+    const Point2d*  points;
+    int             count;
+    int             n;
+    Box2d           rect;
+    bool            (*c)(int, void*);
+    void*           d;
+    int             visited;
+    
+    Box2d segBox(int i) const {
+        return boxes ? boxes[i] : Box2d(points[i], points[(i + 1) % count]);
+    }
+    bool visitSegment(int i) {
+        if (!rect.isIntersect(segBox(i)))
+            return true;
+        visited++;
+        return c(i, d);
+    }
+    bool visit(int level, int j) {
+        if (!rect.isIntersect(tree[offsets[level] + j]))
+            return true;
+        if (level == 0) {
+            for (int i = j * kSegGroup; i < n && i < (j + 1) * kSegGroup; i++) {
+                if (!visitSegment(i))
+                    return false;
+            }
             return true;
+        }
+        return (visit(level - 1, 2 * j)
+                && (offsets[level - 1] + 2 * j + 1 >= offsets[level]
+                    || visit(level - 1, 2 * j + 1)));
+    }
+};
+
+bool MgBaseLines::buildSegmentTree(const Box2d* boxes) const
+{
+    if (mgPinCache(&_segstate)) {
+        return true;
+    }
+    int n = getSegmentCount();
+    if (n < kMinTreeSegs) {
+        return false;
+    }
+    
+    // 图形可能被前台文档共享显示，只允许一个线程生成索引，其余线程逐边查找
+    MgBaseLines* p = const_cast<MgBaseLines*>(this);
+    if (!giAtomicCompareAndSwap(&p->_segstate, 1, 0)) {
+        return false;
+    }
+    
+    int offsets[kMaxTreeLevels + 1];
+    int levels = segTreeLevels(n, offsets);
+    SegTreeQuery q = { NULL, NULL, boxes, _points, _count, n };
+    Box2d* tree = new Box2d[offsets[levels]];
+    
+    for (int i = 0; i < n; i++) {
+        if (i % kSegGroup == 0)
+            tree[i / kSegGroup] = q.segBox(i);
+        else
+            unionBox(tree[i / kSegGroup], q.segBox(i));
+    }
+    for (int k = 1; k < levels; k++) {
+        for (int j = offsets[k]; j < offsets[k + 1]; j++) {
+            int child = offsets[k - 1] + 2 * (j - offsets[k]);
+            tree[j] = tree[child];
+            if (child + 1 < offsets[k])
+                unionBox(tree[j], tree[child + 1]);
+        }
+    }
+    p->_segtree = tree;
+    p->_segcount = n;
+    giAtomicCompareAndSwap(&p->_segstate, 3, 1);  // 缓存有效，且由本线程读取
+    
+    return true;
+}
+
+void MgBaseLines::freeSegmentTree(bool wait)
+{
+    if (mgLockCacheForFree(&_segstate, wait)) {
+        delete[] _segtree;
+        _segtree = NULL;
+        _segcount = 0;
+        giAtomicCompareAndSwap(&_segstate, 0, 1);
+    }
+}
+
+int MgBaseLines::traverseSegmentTree(const Box2d& rect, const Box2d* boxes,
+                                     bool (*c)(int, void*), void* d) const
+{
+    int n = getSegmentCount();
+    SegTreeQuery q = { NULL, NULL, boxes, _points, _count, n, rect, c, d, 0 };
+    
+    if (buildSegmentTree(boxes)) {
+        if (_segcount == n) {
+            int offsets[kMaxTreeLevels + 1];
+            int levels = segTreeLevels(n, offsets);
+            
+            q.tree = _segtree;
+            q.offsets = offsets;
+            q.visit(levels - 1, 0);
+        }
+        else {
+            for (int i = 0; i < n && q.visitSegment(i); i++) ;
+        }
+        mgUnpinCache(&_segstate);
+    }
+    else {
+        for (int i = 0; i < n && q.visitSegment(i); i++) ;
     }
     
-    return _count < 2;
+    return q.visited;
+}
+
+int MgBaseLines::traverseSegments(const Box2d& rect, bool (*c)(int, void*), void* d) const
+{
+    return traverseSegmentTree(rect, NULL, c, d);
 }
 
 bool MgBaseLines::_save(MgStorage* s) const
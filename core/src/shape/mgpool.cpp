@@ -0,0 +1,252 @@
+// mgpool.cpp: 实现小块内存分配器 MgPool
+// Copyright (c) 2004-2013, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#include "mgpool.h"
+#include "gilock.h"
+#include "githread.h"
+#include <new>
+#include <algorithm>
+
+// 空闲内存块，其开头存放下一个空闲块的地址
+struct MgPoolBlock {
+    MgPoolBlock* next;
+};
+
+// 整块内存的头部，其后为切分出的内存块
+struct MgPoolChunk {
+    MgPoolChunk* next;
+};
+
+// 一级内存块的空闲链表和整块内存链表，lock 为 1 时表示正在操作
+struct MgPoolLevel {
+    MgPoolBlock*    head;
+    MgPoolChunk*    chunks;
+    long            freeCount;      // 空闲链表中的块数
+    long            chunkCount;     // 整块内存的个数
+    bool            trimming;       // 正在整理，链表已取下
+    volatile long   lock;
+};
+
+static const size_t kGranularity = 16;
+static const size_t kChunkSize = 16 * 1024;
+static const size_t kLevels = MgPool::kMaxSize / kGranularity + 1;
+static const int kSpinCount = 64;
+static MgPoolLevel s_levels[kLevels];
+
+static inline size_t levelOf(size_t size)
+{
+    return (size + kGranularity - 1) / kGranularity;
+}
+
+static inline size_t blocksPerChunk(size_t blockSize)
+{
+    return (kChunkSize - kGranularity) / blockSize;     // 头部占一个粒度，内存块仍按16字节对齐
+}
+
+static inline MgPoolBlock* blockAt(MgPoolChunk* chunk, size_t blockSize, size_t i)
+{
+    return (MgPoolBlock*)((char*)chunk + kGranularity + i * blockSize);
+}
+
+// 持有锁的时间很短，先自旋几次，仍未得到就让出时间片，以免空等被抢占的持有线程
+static inline void lockLevel(MgPoolLevel& level)
+{
+    for (int i = 0; !giAtomicCompareAndSwap(&level.lock, 1, 0); i++) {
+        if (i >= kSpinCount) {
+            giYieldThread();
+        }
+    }
+}
+
+static inline void unlockLevel(MgPoolLevel& level)
+{
+    giAtomicCompareAndSwap(&level.lock, 0, 1);
+}
+
+// 在锁外申请一整块内存并切分，加锁后放入本级链表，返回其中第一个内存块
+static MgPoolBlock* addChunk(MgPoolLevel& level, size_t blockSize)
+{
+    size_t count = blocksPerChunk(blockSize);
+    MgPoolChunk* chunk = (MgPoolChunk*)::operator new(kChunkSize);
+    MgPoolBlock* head = NULL;
+
+    for (size_t i = count - 1; i > 0; i--) {
+        MgPoolBlock* block = blockAt(chunk, blockSize, i);
+        block->next = head;
+        head = block;
+    }
+
+    lockLevel(level);
+    chunk->next = level.chunks;
+    level.chunks = chunk;
+    level.chunkCount++;
+    if (head) {
+        blockAt(chunk, blockSize, count - 1)->next = level.head;
+        level.head = head;
+        level.freeCount += (long)count - 1;
+    }
+    unlockLevel(level);
+
+    return blockAt(chunk, blockSize, 0);
+}
+
+void* MgPool::allocate(size_t size)
+{
+    if (size == 0 || size > kMaxSize) {
+        return ::operator new(size);
+    }
+
+    MgPoolLevel& level = s_levels[levelOf(size)];
+    MgPoolBlock* block;
+
+    lockLevel(level);
+    block = level.head;
+    if (block) {
+        level.head = block->next;
+        level.freeCount--;
+    }
+    unlockLevel(level);
+
+    return block ? block : addChunk(level, levelOf(size) * kGranularity);
+}
+
+void MgPool::deallocate(void* p, size_t size)
+{
+    if (!p) {
+        return;
+    }
+    if (size == 0 || size > kMaxSize) {
+        ::operator delete(p);
+        return;
+    }
+
+    MgPoolLevel& level = s_levels[levelOf(size)];
+    MgPoolBlock* block = (MgPoolBlock*)p;
+
+    lockLevel(level);
+    block->next = level.head;
+    level.head = block;
+    level.freeCount++;
+    unlockLevel(level);
+}
+
+// 返回内存块所在的整块内存在有序数组中的序号
+static inline size_t chunkOf(MgPoolChunk** chunks, size_t n, MgPoolBlock* block)
+{
+    return std::upper_bound(chunks, chunks + n, (MgPoolChunk*)block) - chunks - 1;
+}
+
+// 释放本级中全部内存块都空闲的整块内存
+static void trimLevel(MgPoolLevel& level, size_t blockSize)
+{
+    const long perChunk = (long)blocksPerChunk(blockSize);
+    MgPoolBlock* head;
+    MgPoolChunk* chunk;
+    size_t n;
+
+    // 空闲块不到一半时整块空闲的很少，不必整理
+    lockLevel(level);
+    if (level.trimming || level.freeCount < 2 * perChunk
+        || level.freeCount * 2 < level.chunkCount * perChunk) {
+        unlockLevel(level);
+        return;
+    }
+    n = (size_t)level.chunkCount;
+    unlockLevel(level);
+
+    MgPoolChunk** chunks = new (std::nothrow) MgPoolChunk*[n];
+    long* counts = new (std::nothrow) long[n];
+
+    if (!chunks || !counts) {
+        delete[] chunks;
+        delete[] counts;
+        return;
+    }
+
+    // 取下两个链表，整理期间其他线程照常分配和释放，需要时另申请整块内存。
+    // 这期间释放的内存块可能属于已取下的整块内存，所以同一级不能同时整理。
+    lockLevel(level);
+    if (level.trimming || (size_t)level.chunkCount > n) {
+        unlockLevel(level);
+        delete[] chunks;
+        delete[] counts;
+        return;
+    }
+    head = level.head;
+    chunk = level.chunks;
+    n = (size_t)level.chunkCount;
+    level.freeCount = 0;
+    level.chunkCount = 0;
+    level.head = NULL;
+    level.chunks = NULL;
+    level.trimming = true;
+    unlockLevel(level);
+
+    size_t i = 0;
+    for (; chunk; chunk = chunk->next) {
+        chunks[i] = chunk;
+        counts[i++] = 0;
+    }
+    std::sort(chunks, chunks + n);
+    for (MgPoolBlock* block = head; block; block = block->next) {
+        counts[chunkOf(chunks, n, block)]++;
+    }
+
+    MgPoolBlock* keptHead = NULL;
+    MgPoolBlock* keptTail = NULL;
+    MgPoolChunk* keptChunks = NULL;
+    MgPoolChunk* keptLast = NULL;
+    long freeCount = 0;
+    long chunkCount = 0;
+
+    for (MgPoolBlock* block = head; block; ) {
+        MgPoolBlock* next = block->next;
+        if (counts[chunkOf(chunks, n, block)] < perChunk) {
+            block->next = NULL;
+            if (keptTail) {
+                keptTail->next = block;
+            } else {
+                keptHead = block;
+            }
+            keptTail = block;
+            freeCount++;
+        }
+        block = next;
+    }
+    for (i = 0; i < n; i++) {
+        if (counts[i] == perChunk) {
+            ::operator delete(chunks[i]);
+        } else {
+            chunks[i]->next = keptChunks;
+            keptChunks = chunks[i];
+            if (!keptLast) {
+                keptLast = chunks[i];
+            }
+            chunkCount++;
+        }
+    }
+    delete[] chunks;
+    delete[] counts;
+
+    lockLevel(level);
+    if (keptTail) {
+        keptTail->next = level.head;
+        level.head = keptHead;
+        level.freeCount += freeCount;
+    }
+    if (keptLast) {
+        keptLast->next = level.chunks;
+        level.chunks = keptChunks;
+        level.chunkCount += chunkCount;
+    }
+    level.trimming = false;
+    unlockLevel(level);
+}
+
+void MgPool::trim()
+{
+    for (size_t i = 1; i < kLevels; i++) {
+        trimLevel(s_levels[i], i * kGranularity);
+    }
+}
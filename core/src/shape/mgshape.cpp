@@ -83,17 +83,19 @@ bool MgBaseShape::_equals(const MgBaseShape& src) const
 
 Box2d MgBaseShape::_getExtent() const
 {
-    if (_extent.isNull() || !_extent.isEmpty(minTol())) {
+    const Tol tol(minTol());
+    
+    if (_extent.isNull() || !_extent.isEmpty(tol)) {
         return _extent;
     }
     
     Box2d rect(_extent);
     
-    if (rect.width() < minTol().equalPoint() && getPointCount() > 0) {
-        rect.inflate(minTol().equalPoint() / 2.f, 0);
+    if (rect.width() < tol.equalPoint() && getPointCount() > 0) {
+        rect.inflate(tol.equalPoint() / 2.f, 0);
     }
-    if (rect.height() < minTol().equalPoint() && getPointCount() > 0) {
-        rect.inflate(0, minTol().equalPoint() / 2.f);
+    if (rect.height() < tol.equalPoint() && getPointCount() > 0) {
+        rect.inflate(0, tol.equalPoint() / 2.f);
     }
     
     return rect;
@@ -212,7 +214,7 @@ bool MgShape::draw(int mode, GiGraphics& gs, const GiContext *ctx, int segment)
 {
     GiContext tmpctx(context());
 
-    if (shapec()->isKindOf(6)) { // MgComposite
+    if (shapec()->isKindOf(6) || shapec()->isKindOf(33)) { // MgComposite, MgSymbolShape
         tmpctx = ctx ? *ctx : GiContext(0, GiColor(), GiContext::kNullLine);
     }
     else {
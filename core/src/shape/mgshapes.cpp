@@ -6,15 +6,19 @@
 #include "mgspfactory.h"
 #include "mglog.h"
 #include "mgcomposite.h"
+#include "githread.h"
 #include <list>
 #include <map>
+#include <vector>
+
+typedef void (*MgShapeOp)(MgShape* sp, void* data);    // 批量修改图形的函数
 
 struct MgShapes::I
 {
     typedef std::list<MgShape*> Container;
     typedef Container::const_iterator citerator;
     typedef Container::iterator iterator;
-    typedef std::map<int, MgShape*>  ID2SHAPE;
+    typedef std::map<int, iterator>  ID2SHAPE;  // 图形ID对应在列表中的位置
     
     Container   shapes;
     ID2SHAPE    id2shape;
@@ -22,14 +26,19 @@ struct MgShapes::I
     int         index;
     int         newShapeID;
     volatile long refcount;
+    long        changeCount;
     
     MgShape* findShape(int sid) const;
     int getNewID(int sid);
+    void replaceAll(MgShapes* owner, MgShapeOp op, void* data);
     
     iterator findPosition(int sid) {
-        iterator it = shapes.begin();
-        for (; it != shapes.end() && (*it)->getID() != sid; ++it) ;
-        return it;
+        ID2SHAPE::iterator it = id2shape.find(sid);
+        return it != id2shape.end() ? it->second : shapes.end();
+    }
+    void pushBack(MgShape* sp) {
+        shapes.push_back(sp);
+        id2shape[sp->getID()] = --shapes.end();
     }
 };
 
@@ -48,6 +57,7 @@ MgShapes::MgShapes(MgObject* owner, int index)
     im->index = index;
     im->newShapeID = 1;
     im->refcount = 1;
+    im->changeCount = 0;
 }
 
 MgShapes::~MgShapes()
@@ -99,11 +109,11 @@ int MgShapes::copyShapes(const MgShapes* src, bool deeply, bool needClear)
             ret += addShape(*sp) ? 1 : 0;
         } else {
             sp->addRef();
-            im->shapes.push_back(sp);
-            im->id2shape[sp->getID()] = sp;
+            im->pushBack(sp);
             ret++;
         }
     }
+    im->changeCount = needClear ? src->im->changeCount : im->changeCount + 1;
     
     return ret;
 }
@@ -127,6 +137,7 @@ void MgShapes::clear()
     }
     im->shapes.clear();
     im->id2shape.clear();
+    im->changeCount++;
 }
 
 void MgShapes::clearCachedData()
@@ -146,6 +157,21 @@ int MgShapes::getIndex() const
     return im->index;
 }
 
+long MgShapes::getChangeCount() const
+{
+    return im->changeCount;
+}
+
+MgSymbol* MgShapes::findSymbol(const char* name) const
+{
+    const MgShape* owner = NULL;
+    
+    if (im->owner && im->owner->isKindOf(MgComposite::Type())) {
+        owner = ((const MgComposite*)im->owner)->getOwnerShape();
+    }
+    return owner && owner->getParent() ? owner->getParent()->findSymbol(name) : NULL;
+}
+
 bool MgShapes::updateShape(MgShape* shape, bool force)
 {
     if (shape && (force || !shape->getParent() || shape->getParent() == this)) {
@@ -155,21 +181,111 @@ bool MgShapes::updateShape(MgShape* shape, bool force)
             (*it)->release();
             *it = shape;
             shape->setParent(this, shape->getID());
-            im->id2shape[shape->getID()] = shape;
+            im->changeCount++;
             return true;
         }
     }
     return false;
 }
 
-void MgShapes::transform(const Matrix2d& mat)
+// 批量克隆并修改图形的任务，各线程按块领取图形序号，结果按原顺序存放
+struct MgShapesTask {
+    enum { kChunk = 64, kMinCount = 256, kMaxThreads = 8 };
+    const MgShape**     olds;
+    MgShape**           news;
+    MgShapeOp           op;
+    void*               data;
+    long                count;
+    volatile long       next;           // 下一个待领取的块序号
+    
+    void run() {
+        for (long i = (giAtomicIncrement(&next) - 1) * kChunk; i < count;
+             i = (giAtomicIncrement(&next) - 1) * kChunk) {
+            for (long j = i; j < i + kChunk && j < count; j++) {
+                news[j] = olds[j]->cloneShape();
+                (*op)(news[j], data);
+            }
+        }
+    }
+};
+
+static void shapesTaskProc(void* data)
 {
-    for (I::iterator it = im->shapes.begin(); it != im->shapes.end(); ++it) {
-        MgShape* newsp = (*it)->cloneShape();
-        newsp->shape()->transform(mat);
-        if (!updateShape(newsp, true))
-            MgObject::release_pointer(newsp);
+    ((MgShapesTask*)data)->run();
+}
+
+static int getTaskThreads(long count)
+{
+    int n = giGetProcessorCount();
+    
+    if (n > MgShapesTask::kMaxThreads)
+        n = MgShapesTask::kMaxThreads;
+    if (n > count / MgShapesTask::kChunk)
+        n = (int)(count / MgShapesTask::kChunk);
+    return n < 1 ? 1 : n;
+}
+
+static void runShapesTask(MgShapesTask& task)
+{
+    int threads = task.count < MgShapesTask::kMinCount ? 1 : getTaskThreads(task.count);
+    
+    GiThreadPool::run(shapesTaskProc, &task, threads);  // 各调用者共用常驻线程池，无空闲线程时在当前线程完成
+}
+
+void MgShapes::I::replaceAll(MgShapes* owner, MgShapeOp op, void* data)
+{
+    if (shapes.empty())
+        return;
+    
+    std::vector<const MgShape*> olds(shapes.begin(), shapes.end());
+    std::vector<MgShape*> news(olds.size());
+    MgShapesTask task;
+    
+    task.olds = &olds.front();
+    task.news = &news.front();
+    task.op = op;
+    task.data = data;
+    task.count = (long)olds.size();
+    task.next = 0;
+    runShapesTask(task);
+    
+    // 按原顺序换入新图形，位置不变，ID索引无需重建
+    size_t i = 0;
+    for (iterator it = shapes.begin(); it != shapes.end(); ++it, ++i) {
+        MgShape* newsp = news[i];
+        newsp->shape()->resetChangeCount((*it)->shapec()->getChangeCount() + 1);
+        (*it)->release();
+        *it = newsp;
+        newsp->setParent(owner, newsp->getID());
     }
+    changeCount++;
+}
+
+static void transformShape(MgShape* sp, void* data)
+{
+    sp->shape()->transform(*(const Matrix2d*)data);
+}
+
+static void setShapeContext(MgShape* sp, void* data)
+{
+    const std::pair<const GiContext*, int>& p = *(const std::pair<const GiContext*, int>*)data;
+    sp->setContext(*p.first, p.second);
+}
+
+void MgShapes::transform(const Matrix2d& mat)
+{
+    im->replaceAll(this, transformShape, (void*)&mat);
+}
+
+void MgShapes::offset(const Vector2d& vec)
+{
+    transform(Matrix2d::translation(vec));
+}
+
+void MgShapes::setContext(const GiContext& ctx, int mask)
+{
+    std::pair<const GiContext*, int> p(&ctx, mask);
+    im->replaceAll(this, setShapeContext, &p);
 }
 
 MgShape* MgShapes::cloneShape(int sid) const
@@ -183,8 +299,8 @@ MgShape* MgShapes::addShape(const MgShape& src)
     MgShape* p = src.cloneShape();
     if (p) {
         p->setParent(this, im->getNewID(src.getID()));
-        im->shapes.push_back(p);
-        im->id2shape[p->getID()] = p;
+        im->pushBack(p);
+        im->changeCount++;
     }
     return p;
 }
@@ -194,8 +310,8 @@ bool MgShapes::addShapeDirect(MgShape* shape, bool force)
     if (shape && (force || !shape->getParent() || shape->getParent() == this)) {
         shape->shape()->update();
         shape->setParent(this, im->getNewID(0));
-        im->shapes.push_back(shape);
-        im->id2shape[shape->getID()] = shape;
+        im->pushBack(shape);
+        im->changeCount++;
         return true;
     }
     return false;
@@ -207,9 +323,10 @@ bool MgShapes::removeShape(int sid)
     
     if (it != im->shapes.end()) {
         MgShape* shape = *it;
-        im->shapes.erase(it);
         im->id2shape.erase(shape->getID());
+        im->shapes.erase(it);
         shape->release();
+        im->changeCount++;
         return true;
     }
     
@@ -223,8 +340,8 @@ bool MgShapes::moveShapeTo(int sid, MgShapes* dest)
     if (dest && dest != this && it != im->shapes.end()) {
         MgShape* newsp = (*it)->cloneShape();
         newsp->setParent(dest, dest->im->getNewID(newsp->getID()));
-        dest->im->shapes.push_back(newsp);
-        dest->im->id2shape[newsp->getID()] = newsp;
+        dest->im->pushBack(newsp);
+        dest->im->changeCount++;
         
         return removeShape(sid);
     }
@@ -238,9 +355,9 @@ void MgShapes::copyShapesTo(MgShapes* dest) const
         for (I::iterator it = im->shapes.begin(); it != im->shapes.end(); ++it) {
             MgShape* newsp = (*it)->cloneShape();
             newsp->setParent(dest, dest->im->getNewID(newsp->getID()));
-            dest->im->shapes.push_back(newsp);
-            dest->im->id2shape[newsp->getID()] = newsp;
+            dest->im->pushBack(newsp);
         }
+        dest->im->changeCount++;
     }
 }
 
@@ -249,9 +366,8 @@ bool MgShapes::bringToFront(int sid)
     I::iterator it = im->findPosition(sid);
     
     if (it != im->shapes.end()) {
-        MgShape* shape = *it;
-        im->shapes.erase(it);
-        im->shapes.push_back(shape);
+        im->shapes.splice(im->shapes.end(), im->shapes, it);    // 位置迭代器仍有效
+        im->changeCount++;
         return true;
     }
     
@@ -515,12 +631,11 @@ int MgShapes::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
                 if (ret) {
                     count++;
                     newsp->shape()->setFlag(kMgClosed, newsp->shape()->isClosed());
-                    im->id2shape[newsp->getID()] = newsp;
                     if (oldsp) {
                         updateShape(newsp);
                     }
                     else {
-                        im->shapes.push_back(newsp);
+                        im->pushBack(newsp);
                     }
                 }
                 else {
@@ -533,6 +648,7 @@ int MgShapes::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
             s->readNode("shape", index++, true);
         }
         s->readNode("shapes", im->index, true);
+        im->changeCount++;
     }
     else if (s && im->index == 0) {
         s->setError("No shapes node.");
@@ -551,7 +667,7 @@ MgShape* MgShapes::I::findShape(int sid) const
     if (!this || 0 == sid)
         return NULL;
     ID2SHAPE::const_iterator it = id2shape.find(sid);
-    return it != id2shape.end() ? it->second : NULL;
+    return it != id2shape.end() ? *it->second : NULL;
 }
 
 int MgShapes::I::getNewID(int sid)
@@ -4,17 +4,81 @@
 
 #include "mgbasicsp.h"
 #include "mgshape_.h"
+#include "mgpool.h"
 #include "mglog.h"
+#include <new>
 
 MG_IMPLEMENT_CREATE(MgSplines)
 
-MgSplines::MgSplines() : _knotvs(NULL)
+MgSplines::MgSplines()
+    : _knotvs(NULL), _knotins(NULL), _bzpts(NULL), _bzboxes(NULL), _bzcount(0), _bzstate(0)
 {
 }
 
 MgSplines::~MgSplines()
 {
+    freeBeziers();
     delete[] _knotvs;
+    delete[] _knotins;
+}
+
+void MgSplines::bezierAt(int i, Point2d points[4]) const
+{
+    mgcurv::cubicSplineToBezier(_count, _points, _knotvs, i, points, false);
+    if (_knotins) {                     // 两侧控制边长度不同
+        points[2] = points[3] - _knotins[(i + 1) % _count];
+    }
+}
+
+void MgSplines::getBeziers(Point2d* points) const
+{
+    int n = getSegmentCount();
+    
+    for (int i = 0; i < n; i++) {
+        bezierAt(i, points + 3 * i);
+    }
+}
+
+bool MgSplines::buildBeziers() const
+{
+    if (mgPinCache(&_bzstate)) {
+        return true;
+    }
+    if (!_knotvs || _count < 3) {
+        return false;
+    }
+    
+    // 图形可能被前台文档共享显示，只允许一个线程生成缓存，其余线程按型值点直接计算
+    MgSplines* p = const_cast<MgSplines*>(this);
+    if (!giAtomicCompareAndSwap(&p->_bzstate, 1, 0)) {
+        return false;
+    }
+    
+    int n = isClosed() ? _count : _count - 1;
+    
+    p->_bzpts = new Point2d[1 + 3 * n];
+    p->_bzboxes = new Box2d[n];
+    for (int i = 0; i < n; i++) {
+        bezierAt(i, p->_bzpts + 3 * i);
+        p->_bzboxes[i] = mgnear::bezierBox1(p->_bzpts + 3 * i);
+    }
+    p->_bzcount = n;
+    giAtomicCompareAndSwap(&p->_bzstate, 3, 1);   // 缓存有效，且由本线程读取
+    
+    return true;
+}
+
+void MgSplines::freeBeziers(bool wait)
+{
+    freeSegmentTree(wait);              // 索引可能由贝塞尔段包络框生成
+    if (mgLockCacheForFree(&_bzstate, wait)) {  // 修改图形前等其他线程读完
+        delete[] _bzpts;
+        delete[] _bzboxes;
+        _bzpts = NULL;
+        _bzboxes = NULL;
+        _bzcount = 0;
+        giAtomicCompareAndSwap(&_bzstate, 0, 1);
+    }
 }
 
 float MgSplines::_hitTest(const Point2d& pt, float tol, MgHitResult& res) const
@@ -22,6 +86,41 @@ float MgSplines::_hitTest(const Point2d& pt, float tol, MgHitResult& res) const
     if (_count == 2) {
         return mglnrel::ptToLine(_points[0], _points[1], pt, res.nearpt);
     }
+    if (buildBeziers()) {
+        Point2d ptTemp;
+        float dist, distMin = _FLT_MAX;
+        const Box2d rect (pt, 2 * tol, 2 * tol);
+        
+        res.segment = -1;
+        for (int i = 0; i < _bzcount; i++) {
+            if (rect.isIntersect(_bzboxes[i])) {
+                dist = mgnear::nearestOnBezier(pt, _bzpts + 3 * i, ptTemp);
+                if (dist < distMin) {
+                    distMin = dist;
+                    res.nearpt = ptTemp;
+                    res.segment = i;
+                }
+            }
+        }
+        mgUnpinCache(&_bzstate);
+        return distMin;
+    }
+    if (_knotins) {                     // 其他线程正在生成缓存，逐段计算
+        Point2d bz[4], ptTemp;
+        float dist, distMin = _FLT_MAX;
+        
+        res.segment = -1;
+        for (int i = 0; i < getSegmentCount(); i++) {
+            bezierAt(i, bz);
+            dist = mgnear::nearestOnBezier(pt, bz, ptTemp);
+            if (dist < distMin) {
+                distMin = dist;
+                res.nearpt = ptTemp;
+                res.segment = i;
+            }
+        }
+        return distMin;
+    }
     if (_knotvs) {
         return mgnear::cubicSplinesHit(_count, _points, _knotvs, isClosed(),
                                        pt, tol, res.nearpt, res.segment, false);
@@ -30,21 +129,75 @@ float MgSplines::_hitTest(const Point2d& pt, float tol, MgHitResult& res) const
                                   pt, tol, res.nearpt, res.segment);
 }
 
+static bool stopAtFirst(int, void*) { return false; }
+
 bool MgSplines::_hitTestBox(const Box2d& rect) const
 {
-    if (!__super::_hitTestBox(rect))
+    if (!MgBaseShape::_hitTestBox(rect))
         return false;
+    if (buildBeziers()) {
+        bool ret = traverseSegmentTree(rect, _bzboxes, stopAtFirst, NULL) > 0;
+        mgUnpinCache(&_bzstate);
+        return ret;
+    }
+    if (_knotins) {
+        Point2d* pts = new Point2d[1 + 3 * getSegmentCount()];
+        getBeziers(pts);
+        bool ret = mgnear::beziersIntersectBox(rect, 1 + 3 * getSegmentCount(), pts, false);
+        delete[] pts;
+        return ret;
+    }
     if (_knotvs) {
         return mgnear::cubicSplinesIntersectBox(rect, _count, _points, _knotvs, isClosed(), false);
     }
+    return __super::_hitTestBox(rect);
+}
+
+int MgSplines::traverseSegments(const Box2d& rect, bool (*c)(int, void*), void* d) const
+{
+    if (buildBeziers()) {
+        int ret = traverseSegmentTree(rect, _bzboxes, c, d);
+        mgUnpinCache(&_bzstate);
+        return ret;
+    }
+    if (!_knotvs) {                     // 二次样条按控制边查找
+        return __super::traverseSegments(rect, c, d);
+    }
+    
+    int i, n = getSegmentCount();       // 其他线程正在生成缓存，逐段回调
+    for (i = 0; i < n && c(i, d); i++) ;
+    return i < n ? i + 1 : n;
+}
+
+bool MgSplines::getBezier(int segment, Point2d points[4]) const
+{
+    if (!_knotvs || segment < 0 || segment >= getSegmentCount()) {
+        return false;
+    }
+    bezierAt(segment, points);
     return true;
 }
 
 bool MgSplines::_draw(int mode, GiGraphics& gs, const GiContext& ctx, int segment) const
 {
-    bool ret = (_count == 2 ? gs.drawLine(&ctx, _points[0], _points[1])
-                : (_knotvs ? gs.drawBeziers(&ctx, _count, _points, _knotvs, isClosed())
-                   : gs.drawQuadSplines(&ctx, _count, _points, isClosed())));
+    bool ret;
+    
+    if (_count == 2) {
+        ret = gs.drawLine(&ctx, _points[0], _points[1]);
+    }
+    else if (buildBeziers()) {      // 闭合时首末连接段由 closed 参数绘制
+        ret = gs.drawBeziers(&ctx, 1 + 3 * (_count - 1), _bzpts, isClosed());
+        mgUnpinCache(&_bzstate);
+    }
+    else if (_knotins) {
+        GiPath path;
+        _output(path);
+        ret = gs.drawPath(&ctx, path, false);
+    }
+    else {
+        ret = (_knotvs ? gs.drawBeziers(&ctx, _count, _points, _knotvs, isClosed())
+               : gs.drawQuadSplines(&ctx, _count, _points, isClosed()));
+    }
     return __super::_draw(mode, gs, ctx, segment) || ret;
 }
 
@@ -57,10 +210,12 @@ void MgSplines::_output(GiPath& path) const
         path.lineTo(_points[1]);
     }
     else if (_knotvs) {
+        Point2d bz[4];
+        
         path.moveTo(_points[0]);
-        for (int i = 1; i + 1 < _count; i++) {
-            path.bezierTo(_points[i] + _knotvs[i],
-                          _points[i+1] - _knotvs[i+1], _points[i+1]);
+        for (int i = 0; i < getSegmentCount(); i++) {
+            bezierAt(i, bz);
+            path.bezierTo(bz[1], bz[2], bz[3]);
         }
         if (isClosed()) {
             path.closeFigure();
@@ -87,34 +242,48 @@ void MgSplines::_output(GiPath& path) const
 
 void MgSplines::_copy(const MgSplines& src)
 {
-    __super::_copy(src);    // will clear _knotvs via MgSplines::resize
+    clearVectors();
+    __super::_copy(src);
     if (src._knotvs) {
-        _knotvs = new Vector2d[_count];
+        _knotvs = new Vector2d[_maxCount];
         for (int i = 0; i < _count; i++)
             _knotvs[i] = src._knotvs[i];
     }
+    if (src._knotins) {
+        _knotins = new Vector2d[_maxCount];
+        for (int i = 0; i < _count; i++)
+            _knotins[i] = src._knotins[i];
+    }
 }
 
 bool MgSplines::_equals(const MgSplines& src) const
 {
-    if (!__super::_equals(src) || !_knotvs != !src._knotvs)
+    if (!__super::_equals(src) || !_knotvs != !src._knotvs || !_knotins != !src._knotins)
         return false;
     
-    if (_knotvs) {
-        for (int i = 0; i < _count; i++) {
-            if (_knotvs[i] != src._knotvs[i])
-                return false;
-        }
+    for (int i = 0; i < _count; i++) {
+        if ((_knotvs && _knotvs[i] != src._knotvs[i])
+            || (_knotins && _knotins[i] != src._knotins[i]))
+            return false;
     }
     
     return true;
 }
 
+void MgSplines::_update()
+{
+    freeBeziers();
+    __super::_update();
+}
+
 void MgSplines::_transform(const Matrix2d& mat)
 {
-    if (_knotvs) {
-        for (int i = 0; i < _count; i++)
+    freeBeziers();
+    for (int i = 0; i < _count; i++) {
+        if (_knotvs)
             _knotvs[i] *= mat;
+        if (_knotins)
+            _knotins[i] *= mat;
     }
     __super::_transform(mat);
 }
@@ -125,6 +294,12 @@ void MgSplines::_clear()
     __super::_clear();
 }
 
+void MgSplines::_clearCachedData()
+{
+    freeBeziers(false);
+    __super::_clearCachedData();
+}
+
 void MgSplines::_setPoint(int index, const Point2d& pt)
 {
     clearVectors();
@@ -133,10 +308,15 @@ void MgSplines::_setPoint(int index, const Point2d& pt)
 
 void MgSplines::clearVectors()
 {
+    freeBeziers();
     if (_knotvs) {
         delete[] _knotvs;
         _knotvs = NULL;
     }
+    if (_knotins) {
+        delete[] _knotins;
+        _knotins = NULL;
+    }
 }
 
 bool MgSplines::_save(MgStorage* s) const
@@ -145,19 +325,30 @@ bool MgSplines::_save(MgStorage* s) const
     if (_knotvs) {
         s->writeFloatArray("vec", (const float*)_knotvs, _count * 2);
     }
+    if (_knotvs && _knotins) {
+        s->writeFloatArray("invec", (const float*)_knotins, _count * 2);
+    }
     return ret;
 }
 
 bool MgSplines::_load(MgShapeFactory* factory, MgStorage* s)
 {
+    clearVectors();
     bool ret = __super::_load(factory, s);
     if (ret && _count > 0 && s->readFloatArray("vec", NULL, 0) > 0) {
-        _knotvs = new Vector2d[_count];
+        _knotvs = new Vector2d[_maxCount];
         if (s->readFloatArray("vec", (float*)_knotvs, _count * 2) != _count * 2) {
             delete[] _knotvs;
             _knotvs = NULL;
         }
     }
+    if (_knotvs && s->readFloatArray("invec", NULL, 0) > 0) {
+        _knotins = new Vector2d[_maxCount];
+        if (s->readFloatArray("invec", (float*)_knotins, _count * 2) != _count * 2) {
+            delete[] _knotins;
+            _knotins = NULL;
+        }
+    }
     return ret;
 }
 
@@ -165,6 +356,8 @@ bool MgSplines::resize(int count)
 {
     if (count != _count)
         clearVectors();
+    else
+        freeBeziers();
     return __super::resize(count);
 }
 
@@ -191,6 +384,85 @@ bool MgSplines::smooth(const Matrix2d& m2d, float tol)
     return smoothForPoints(_count, _points, m2d, tol) > 0;
 }
 
+bool MgSplines::setBeziers(int count, const Point2d* points)
+{
+    if (count < 4 || !points)
+        return false;
+    
+    clearVectors();
+    _count = 0;
+    setTailBeziers(0, count, points);
+    
+    return true;
+}
+
+bool MgSplines::setTailBeziers(int from, int count, const Point2d* points)
+{
+    int n = (count - 1) / 3;
+    int oldMax = _maxCount;
+    
+    if (!points || n < (from > 0 ? 0 : 1) || from < 0
+        || (from > 0 && (!_knotvs || from >= _count))) {
+        return false;
+    }
+    
+    // 起始型值点保留进入的控制边，离开的控制边取新的第一段
+    Vector2d vin(from > 0 ? (_knotins ? _knotins[from] : _knotvs[from]) : points[1] - points[0]);
+    
+    freeBeziers();
+    MgBaseLines::resize(from + n + 1);  // 保留前面的型值点和切矢量
+    if (!_knotvs || _maxCount != oldMax) {
+        reserveVectors(oldMax);
+    }
+    
+    // 切矢量取离开型值点的控制边，两侧控制边不同时另存进入的控制边，显示的曲线与贝塞尔段相同
+    for (int i = 0; i <= n; i++) {
+        int k = from + i;
+        
+        if (i > 0)
+            vin = points[3 * i] - points[3 * i - 1];
+        _points[k] = points[3 * i];
+        _knotvs[k] = i < n ? points[3 * i + 1] - points[3 * i] : vin;
+        
+        if (!_knotins && vin != _knotvs[k]) {
+            _knotins = new Vector2d[_maxCount];
+            for (int j = 0; j < k; j++)
+                _knotins[j] = _knotvs[j];
+        }
+        if (_knotins)
+            _knotins[k] = vin;
+    }
+    
+    if (from > 0) {                     // 前面的段不变，只将新型值点并入范围
+        for (int i = 1; i <= n; i++)
+            _extent.unionWith(_points[from + i]);
+        afterChanged();
+    }
+    else {
+        update();
+    }
+    
+    return true;
+}
+
+void MgSplines::reserveVectors(int oldMax)
+{
+    Vector2d* vs = new Vector2d[_maxCount];
+    
+    for (int i = 0; _knotvs && i < oldMax && i < _maxCount; i++)
+        vs[i] = _knotvs[i];
+    delete[] _knotvs;
+    _knotvs = vs;
+    
+    if (_knotins) {
+        vs = new Vector2d[_maxCount];
+        for (int i = 0; i < oldMax && i < _maxCount; i++)
+            vs[i] = _knotins[i];
+        delete[] _knotins;
+        _knotins = vs;
+    }
+}
+
 int MgSplines::smoothForPoints(int count, const Point2d* points, const Matrix2d& m2d, float tol)
 {
     if (count < 3 || !points || tol < _MGZERO)
@@ -198,15 +470,16 @@ int MgSplines::smoothForPoints(int count, const Point2d* points, const Matrix2d&
     
     int i, knotCount = count + 1;
     Point2d* ptx = new Point2d[count];
-    Point2d* knots = new Point2d[knotCount];
+    Point2d* knots = (Point2d*)MgPool::allocate(knotCount * sizeof(Point2d));
     Vector2d* knotvs = new Vector2d[knotCount];
     Matrix2d d2m(m2d.inverse());
     
+    for (i = 0; i < knotCount; i++)
+        new (knots + i) Point2d();
     for (i = 0; i < count; i++)
         ptx[i] = points[i] * m2d;
     
     _count = mgcurv::fitCurve(knotCount, knots, knotvs, count, ptx, tol);
-    _maxCount = knotCount;
     LOGD("smoothForPoints: %d -> %d", count, _count);
     
     for (i = 0; i < _count; i++) {
@@ -214,10 +487,13 @@ int MgSplines::smoothForPoints(int count, const Point2d* points, const Matrix2d&
         knotvs[i] *= d2m;
     }
     delete[] ptx;
-    delete[] _points;
+    MgPool::deallocate(_points, _maxCount * sizeof(Point2d));
     _points = knots;
+    _maxCount = knotCount;
     delete[] _knotvs;
+    delete[] _knotins;
     _knotvs = knotvs;
+    _knotins = NULL;
     update();
     
     return _count;
@@ -0,0 +1,409 @@
+// mgsymbol.cpp: 实现图元定义类 MgSymbol 和图元引用图形类 MgSymbolShape
+// Copyright (c) 2004-2013, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#include "mgsymbol.h"
+#include "mgshapes.h"
+#include "mgshapetype.h"
+#include "mgshape_.h"
+#include <string>
+#include <vector>
+
+// 定义中的图形列表，加载时由 lookup 查找嵌套引用的其他定义
+class MgSymbolShapes : public MgShapes
+{
+public:
+    MgSymbolShapes() : MgShapes(NULL, -1), lookup(NULL) {}
+
+    virtual MgSymbol* findSymbol(const char* name) const {
+        return lookup ? lookup->findSymbol(name) : NULL;
+    }
+
+    const MgShapes* lookup;
+};
+
+// MgSymbol
+//
+
+struct MgSymbol::Impl {
+    std::string     name;
+    MgSymbolShapes* shapes;
+    Box2d           extent;
+    long            changeCount;
+    volatile long   refcount;
+    GiPath          path;       // 可合并显示时所有图形的轮廓路径
+    GiContext       ctx;        // 合并显示用的绘图属性
+    bool            merged;
+    bool            frozen;     // 已添加到文档，显示时可能被多个线程共享
+};
+
+MgSymbol::MgSymbol(const char* name)
+{
+    im = new Impl();
+    im->name = name ? name : "";
+    im->shapes = new MgSymbolShapes();
+    im->changeCount = 0;
+    im->refcount = 1;
+    im->merged = false;
+    im->frozen = false;
+}
+
+MgSymbol::~MgSymbol()
+{
+    im->shapes->release();
+    delete im;
+}
+
+MgSymbol* MgSymbol::create(const char* name)
+{
+    return new MgSymbol(name);
+}
+
+MgSymbol* MgSymbol::clone() const
+{
+    MgSymbol* p = new MgSymbol(im->name.c_str());
+    p->im->shapes->copyShapes(im->shapes);
+    p->update();
+    return p;
+}
+
+void MgSymbol::addRef()
+{
+    giAtomicIncrement(&im->refcount);
+}
+
+void MgSymbol::release()
+{
+    if (giAtomicDecrement(&im->refcount) == 0)
+        delete this;
+}
+
+const char* MgSymbol::getName() const
+{
+    return im->name.c_str();
+}
+
+void MgSymbol::setName(const char* name)
+{
+    if (!im->frozen) {
+        im->name = name ? name : "";
+    }
+}
+
+const MgShapes* MgSymbol::shapes() const
+{
+    return im->shapes;
+}
+
+MgShapes* MgSymbol::editShapes()
+{
+    return im->frozen ? NULL : im->shapes;
+}
+
+bool MgSymbol::isFrozen() const
+{
+    return im->frozen;
+}
+
+void MgSymbol::freeze()
+{
+    im->frozen = true;
+}
+
+int MgSymbol::getShapeCount() const
+{
+    return im->shapes->getShapeCount();
+}
+
+Box2d MgSymbol::getExtent() const
+{
+    return im->extent;
+}
+
+long MgSymbol::getChangeCount() const
+{
+    return im->changeCount;
+}
+
+// 这些图形的显示结果与其轮廓路径相同，可合并为一个路径显示
+static bool canMerge(int type)
+{
+    return (type >= kMgShapeLine && type <= kMgShapeParallel) || type == kMgShapeArc;
+}
+
+void MgSymbol::update()
+{
+    if (im->frozen) {               // 可能正在其他线程中显示
+        return;
+    }
+
+    MgShapeIterator it(im->shapes);
+    bool first = true;
+    bool closed = true;
+
+    im->extent = im->shapes->getExtent();
+    im->path.clear();
+    im->merged = im->shapes->getShapeCount() > 0;
+
+    while (const MgShape* sp = it.getNext()) {
+        if (!canMerge(sp->shapec()->getType()) || (!first && sp->context() != im->ctx)) {
+            im->merged = false;
+            break;
+        }
+        im->ctx = sp->context();
+        closed = closed && sp->shapec()->isClosed();
+        sp->shapec()->output(im->path);
+        first = false;
+    }
+    if (im->merged && im->ctx.hasFillColor() && !closed) {  // 有开口图形时不能整体填充
+        im->merged = false;
+    }
+    if (!im->merged) {
+        im->path.clear();
+    }
+    im->changeCount++;
+}
+
+bool MgSymbol::draw(int mode, GiGraphics& gs, const GiContext* ctx) const
+{
+    if (mode == 0 && !ctx && im->merged) {
+        return gs.drawPath(&im->ctx, im->path, im->ctx.hasFillColor());
+    }
+    return im->shapes->dyndraw(mode, gs, ctx, -1) > 0;
+}
+
+bool MgSymbol::save(MgStorage* s) const
+{
+    s->writeString("name", im->name.c_str());
+    return im->shapes->save(s);
+}
+
+bool MgSymbol::load(MgShapeFactory* factory, MgStorage* s, const MgShapes* lookup)
+{
+    if (im->frozen) {
+        return false;
+    }
+
+    int len = s->readString("name", NULL, 0);
+    std::vector<char> name(len + 1, 0);
+
+    if (len > 0) {
+        s->readString("name", &name.front(), len);
+    }
+    im->name = &name.front();
+
+    im->shapes->lookup = lookup;
+    bool ret = im->shapes->load(factory, s) >= 0;
+    im->shapes->lookup = NULL;
+    update();
+
+    return ret;
+}
+
+// MgSymbolShape
+//
+
+MG_IMPLEMENT_CREATE(MgSymbolShape)
+
+MgSymbolShape::MgSymbolShape() : _symbol(NULL), _symbolChange(0), _owner(NULL)
+{
+}
+
+MgSymbolShape::~MgSymbolShape()
+{
+    if (_symbol)
+        _symbol->release();
+}
+
+void MgSymbolShape::setSymbol(MgSymbol* symbol, const Matrix2d& mat)
+{
+    if (symbol)
+        symbol->addRef();
+    if (_symbol)
+        _symbol->release();
+    _symbol = symbol;
+    _mat = mat;
+    _symbolChange = -1;             // 在 update() 中按放置矩阵计算角点
+}
+
+// 返回定义的范围，宽或高为零时(如水平线)取最小尺寸，以便由角点反算放置矩阵
+static Box2d symbolBox(const MgSymbol* symbol)
+{
+    Box2d box(symbol ? symbol->getExtent() : Box2d());
+    float minsize = mgMax(mgMax(box.width(), box.height()) * 1e-3f, 1e-3f);
+
+    if (box.width() < minsize)
+        box.inflate(minsize / 2, 0);
+    if (box.height() < minsize)
+        box.inflate(0, minsize / 2);
+
+    return box;
+}
+
+void MgSymbolShape::_update()
+{
+    Box2d box(symbolBox(_symbol));
+
+    if (_symbol && _symbolChange != _symbol->getChangeCount()) {
+        _symbolChange = _symbol->getChangeCount();  // 新设置或修改了定义，按放置矩阵重新计算角点
+        _points[0] = box.leftTop() * _mat;
+        _points[1] = box.rightTop() * _mat;
+        _points[2] = box.rightBottom() * _mat;
+        _points[3] = box.leftBottom() * _mat;
+    }
+    __super::_update();
+
+    // 由角点反算放置矩阵，拖动控制点或变形后定义的范围仍对应四个角点
+    _mat = (Matrix2d::translation(Vector2d(-box.xmin, -box.ymin))
+            * Matrix2d::coordSystem((_points[2] - _points[3]) / box.width(),
+                                    (_points[0] - _points[3]) / box.height(), _points[3]));
+}
+
+void MgSymbolShape::_transform(const Matrix2d& mat)
+{
+    _mat *= mat;
+    __super::_transform(mat);
+}
+
+void MgSymbolShape::_copy(const MgSymbolShape& src)
+{
+    if (src._symbol)
+        src._symbol->addRef();
+    if (_symbol)
+        _symbol->release();
+    _symbol = src._symbol;
+    _mat = src._mat;
+    _symbolChange = src._symbolChange;
+    __super::_copy(src);
+}
+
+bool MgSymbolShape::_equals(const MgSymbolShape& src) const
+{
+    return _symbol == src._symbol && __super::_equals(src);
+}
+
+void MgSymbolShape::_clear()
+{
+    if (_symbol)
+        _symbol->release();
+    _symbol = NULL;
+    __super::_clear();
+}
+
+bool MgSymbolShape::_draw(int mode, GiGraphics& gs, const GiContext& ctx, int segment) const
+{
+    bool ret = false;
+
+    if (_symbol && _symbol->getShapeCount() > 0 && _mat.isInvertible()) {
+        GiSaveModelTransform xf(&gs.xf(), gs.xf().worldToModel() * _mat * gs.xf().modelToWorld());
+        ret = _symbol->draw(mode, gs, ctx.isNullLine() && !ctx.hasFillColor() ? NULL : &ctx);
+    }
+    else {                          // 定义缺失时显示占位框
+        GiContext tmpctx(ctx.isNullLine() ? GiContext(0, GiColor(128, 128, 128)) : ctx);
+        tmpctx.setNoFillColor();
+        ret = (gs.drawPolygon(&tmpctx, 4, _points)
+               && gs.drawLine(&tmpctx, _points[0], _points[2])
+               && gs.drawLine(&tmpctx, _points[1], _points[3]));
+    }
+
+    return __super::_draw(mode, gs, ctx, segment) || ret;
+}
+
+float MgSymbolShape::_hitTest(const Point2d& pt, float tol, MgHitResult& res) const
+{
+    if (!_symbol || _symbol->getShapeCount() == 0 || !_mat.isInvertible()) {
+        return __super::_hitTest(pt, tol, res);
+    }
+
+    Point2d ptsym(pt * _mat.inverse());         // 在定义坐标系中检测
+    float tolsym = tol / mgMax(mgMin(_mat.scaleX(), _mat.scaleY()), _MGZERO);
+    Box2d limits(ptsym, 2 * tolsym, 0);
+    MgShapeIterator it(_symbol->shapes());
+
+    res.dist = _FLT_MAX;
+    while (const MgShape* sp = it.getNext()) {
+        if (sp->shapec()->getExtent().isIntersect(limits)) {
+            MgHitResult tmpRes;
+            sp->shapec()->hitTest(ptsym, tolsym, tmpRes);
+
+            Point2d nearpt(tmpRes.nearpt * _mat);
+            float dist = nearpt.distanceTo(pt);
+
+            if (res.dist > dist - _MGZERO) {
+                res.nearpt = nearpt;
+                res.inside = tmpRes.inside;
+                res.dist = dist;
+            }
+        }
+    }
+    res.segment = -1;
+
+    return res.dist;
+}
+
+bool MgSymbolShape::_hitTestBox(const Box2d& rect) const
+{
+    if (!getExtent().isIntersect(rect))         // 不用矩形边框检测，框选范围可在图形内部
+        return false;
+    if (!_symbol || _symbol->getShapeCount() == 0 || !_mat.isInvertible())
+        return true;
+
+    Box2d rectsym(rect * _mat.inverse());       // 旋转时为外接框，可能略大
+    MgShapeIterator it(_symbol->shapes());
+
+    while (const MgShape* sp = it.getNext()) {
+        if (sp->shapec()->hitTestBox(rectsym))
+            return true;
+    }
+    return false;
+}
+
+void MgSymbolShape::_output(GiPath& path) const
+{
+    if (_symbol && _symbol->getShapeCount() > 0) {
+        GiPath tmppath;
+        MgShapeIterator it(_symbol->shapes());
+
+        while (const MgShape* sp = it.getNext()) {
+            sp->shapec()->output(tmppath);
+        }
+        tmppath.transform(_mat);
+        path.append(tmppath);
+    }
+    else {
+        __super::_output(path);
+    }
+}
+
+bool MgSymbolShape::_save(MgStorage* s) const
+{
+    s->writeString("symbol", _symbol ? _symbol->getName() : "");
+    return __super::_save(s);
+}
+
+bool MgSymbolShape::_load(MgShapeFactory* factory, MgStorage* s)
+{
+    int len = s->readString("symbol", NULL, 0);
+    std::vector<char> name(len + 1, 0);
+
+    if (len > 0) {
+        s->readString("symbol", &name.front(), len);
+    }
+
+    MgShapes* parent = _owner ? _owner->getParent() : NULL;
+    MgSymbol* symbol = parent ? parent->findSymbol(&name.front()) : NULL;
+
+    if (symbol) {
+        symbol->addRef();
+    } else {
+        symbol = MgSymbol::create(&name.front());   // 定义缺失时保留名称，显示占位框
+    }
+    if (_symbol)
+        _symbol->release();
+    _symbol = symbol;
+
+    bool ret = __super::_load(factory, s);
+    _symbolChange = _symbol->getChangeCount();      // 以加载的角点为准反算放置矩阵
+
+    return ret;
+}
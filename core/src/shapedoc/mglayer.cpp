@@ -30,6 +30,11 @@ MgShapeDoc* MgLayer::doc() const
     return (MgShapeDoc*)getOwner();
 }
 
+MgSymbol* MgLayer::findSymbol(const char* name) const
+{
+    return doc() ? doc()->findSymbol(name) : NULL;
+}
+
 MgObject* MgLayer::clone() const
 {
     MgObject* p = new MgLayer(doc(), -1);
@@ -8,10 +8,19 @@
 #include <vector>
 #include "mglayer.h"
 #include "mgcomposite.h"
+#include "mgsymbol.h"
 #include "mglog.h"
+#include "gitick.h"
+#include "mgpool.h"
+#include <algorithm>
+#include <string>
+#include <string.h>
+#include <stdio.h>
 
 struct MgShapeDoc::Impl {
     std::vector<MgLayer*> layers;
+    std::vector<MgSymbol*> symbols;     // 冻结的图元定义，与浅拷贝的文档共享，名称各不相同
+    std::vector<std::pair<std::string, MgSymbol*> > renamed;  // 加载中因重名而改名的定义及其原名
     MgLayer*    curLayer;
     MgShapes*   curShapes;
     GiContext   context;
@@ -19,6 +28,8 @@ struct MgShapeDoc::Impl {
     Box2d       rectW;
     Box2d       rectWInitial;
     float       viewScale;
+    double      originX;        // 文档原点的绝对坐标
+    double      originY;
     volatile long   refcount;
     bool        readOnly;
 };
@@ -33,6 +44,8 @@ MgShapeDoc::MgShapeDoc()
     im->layers.push_back(im->curLayer);
     im->curShapes = im->curLayer;
     im->viewScale = 0;
+    im->originX = 0;
+    im->originY = 0;
     im->readOnly = false;
     im->refcount = 1;
 }
@@ -42,7 +55,11 @@ MgShapeDoc::~MgShapeDoc()
     for (unsigned i = 0; i < im->layers.size(); i++) {
         im->layers[i]->release();
     }
+    for (unsigned i = 0; i < im->symbols.size(); i++) {
+        im->symbols[i]->release();
+    }
     delete im;
+    MgPool::trim();     // 关闭大文档后归还整块空闲的内存
     //LOGD("-MgShapeDoc %ld", giAtomicDecrement(&_n));
 }
 
@@ -79,6 +96,8 @@ void MgShapeDoc::copy(const MgObject& src)
         im->rectW = doc.im->rectW;
         im->viewScale = doc.im->viewScale;
         im->context = doc.im->context;
+        im->originX = doc.im->originX;
+        im->originY = doc.im->originY;
     }
 }
 
@@ -89,13 +108,111 @@ MgShapeDoc* MgShapeDoc::shallowCopy() const
     return p;
 }
 
+typedef std::vector<std::pair<MgSymbol*, MgSymbol*> > SymbolMap;  // 原定义和替换它的新定义
+
+static MgSymbol* mappedSymbol(const SymbolMap& symmap, const MgSymbol* symbol)
+{
+    for (unsigned i = 0; i < symmap.size(); i++) {
+        if (symmap[i].first == symbol) {
+            return symmap[i].second;
+        }
+    }
+    return NULL;
+}
+
+// 返回图形或成组图形中的子图形是否引用了要替换的定义
+static bool hasMappedSymbol(const MgBaseShape* shape, const SymbolMap& symmap)
+{
+    if (shape->isKindOf(MgSymbolShape::Type())) {
+        return mappedSymbol(symmap, ((const MgSymbolShape*)shape)->getSymbol()) != NULL;
+    }
+    if (shape->isKindOf(MgComposite::Type())) {
+        MgShapeIterator it(((const MgComposite*)shape)->shapes());
+        while (const MgShape* sp = it.getNext()) {
+            if (hasMappedSymbol(sp->shapec(), symmap))
+                return true;
+        }
+    }
+    return false;
+}
+
+// 将图形中的引用改为新定义，图形须是未共享的副本
+static void remapSymbols(MgBaseShape* shape, const SymbolMap& symmap)
+{
+    if (shape->isKindOf(MgSymbolShape::Type())) {
+        MgSymbolShape* ref = (MgSymbolShape*)shape;
+        MgSymbol* symbol = mappedSymbol(symmap, ref->getSymbol());
+        
+        if (symbol) {
+            ref->setSymbol(symbol, ref->getMatrix());
+            ref->update();
+        }
+    }
+    else if (shape->isKindOf(MgComposite::Type())) {
+        MgShapeIterator it(((const MgComposite*)shape)->shapes());
+        while (MgShape* sp = const_cast<MgShape*>(it.getNext())) {
+            remapSymbols(sp->shape(), symmap);
+        }
+        shape->update();
+    }
+}
+
+// 将图形列表中的引用改为新定义，shared 为 true 时图形可能被其他文档共享，复制后再替换
+static void remapShapes(MgShapes* shapes, const SymbolMap& symmap, bool shared)
+{
+    std::vector<const MgShape*> found;
+    MgShapeIterator it(shapes);
+    
+    while (const MgShape* sp = it.getNext()) {
+        if (hasMappedSymbol(sp->shapec(), symmap))
+            found.push_back(sp);
+    }
+    for (unsigned i = 0; i < found.size(); i++) {
+        if (shared) {
+            MgShape* newsp = found[i]->cloneShape();
+            remapSymbols(newsp->shape(), symmap);
+            shapes->updateShape(newsp, true);
+        } else {
+            remapSymbols(const_cast<MgShape*>(found[i])->shape(), symmap);
+        }
+    }
+}
+
 int MgShapeDoc::copyShapes(const MgShapeDoc* src, bool deeply)
 {
     unsigned i;
     int ret = 0;
+    SymbolMap symmap;
     
     copy(*src);
     
+    if (deeply) {       // 定义也复制，与源文档互不影响
+        std::vector<MgSymbol*> old(im->symbols);
+        im->symbols.clear();
+        for (i = 0; i < src->im->symbols.size(); i++) {
+            MgSymbol* symbol = src->im->symbols[i]->clone();
+            symmap.push_back(std::pair<MgSymbol*, MgSymbol*>(src->im->symbols[i], symbol));
+            im->symbols.push_back(symbol);
+        }
+        for (i = 0; i < im->symbols.size(); i++) {      // 嵌套的引用也改为复制的定义
+            remapShapes(im->symbols[i]->editShapes(), symmap, false);
+            im->symbols[i]->freeze();
+        }
+        for (i = 0; i < old.size(); i++) {
+            old[i]->release();
+        }
+    }
+    else if (im->symbols != src->im->symbols) {
+        std::vector<MgSymbol*> old(im->symbols);
+        im->symbols = src->im->symbols;
+        for (i = 0; i < im->symbols.size(); i++) {
+            im->symbols[i]->addRef();
+        }
+        for (i = 0; i < old.size(); i++) {
+            old[i]->release();
+        }
+    }
+    
     for (i = 0; i < im->layers.size() && i < src->im->layers.size(); i++) {
         ret += im->layers[i]->copyShapes(src->im->layers[i], deeply);
     }
@@ -108,6 +225,9 @@ int MgShapeDoc::copyShapes(const MgShapeDoc* src, bool deeply)
         im->layers.back()->release();
         im->layers.pop_back();
     }
+    for (i = 0; !symmap.empty() && i < im->layers.size(); i++) {
+        remapShapes(im->layers[i], symmap, false);
+    }
     
     im->curLayer = im->layers[src->im->curLayer->getIndex()];
     im->curShapes = im->curLayer;
@@ -131,6 +251,7 @@ bool MgShapeDoc::equals(const MgObject& src) const
         const MgShapeDoc& doc = (const MgShapeDoc&)src;
 
         if (im->xf != doc.im->xf
+            || im->originX != doc.im->originX || im->originY != doc.im->originY
             || im->layers.size() != doc.im->layers.size()) {
             return false;
         }
@@ -154,6 +275,28 @@ float MgShapeDoc::getViewScale() const { return im->viewScale; }
 bool MgShapeDoc::isReadOnly() const { return im->readOnly; }
 void MgShapeDoc::setReadOnly(bool readOnly) { im->readOnly = readOnly; }
 
+double MgShapeDoc::getOriginX() const { return im->originX; }
+double MgShapeDoc::getOriginY() const { return im->originY; }
+
+void MgShapeDoc::setOrigin(double x, double y, bool moveShapes)
+{
+    if (moveShapes && (x != im->originX || y != im->originY)) {
+        // 原点差值用双精度计算后再转为单精度平移量
+        Matrix2d mat(Matrix2d::translation(Vector2d((float)(im->originX - x),
+                                                    (float)(im->originY - y))));
+        for (unsigned i = 0; i < im->layers.size(); i++) {
+            im->layers[i]->transform(mat);
+        }
+    }
+    im->originX = x;
+    im->originY = y;
+}
+
+Point2d MgShapeDoc::toLocal(double x, double y) const
+{
+    return Point2d((float)(x - im->originX), (float)(y - im->originY));
+}
+
 void MgShapeDoc::setPageRectW(const Box2d& rectW, float viewScale, bool resetInitial)
 {
     im->rectW = rectW;
@@ -172,6 +315,10 @@ void MgShapeDoc::clear()
     im->layers[0]->clear();
     im->curLayer = im->layers[0];
     im->curShapes = im->curLayer;
+    while (!im->symbols.empty()) {
+        im->symbols.back()->release();
+        im->symbols.pop_back();
+    }
 }
 
 void MgShapeDoc::clearCachedData()
@@ -242,6 +389,126 @@ int MgShapeDoc::getLayerCount() const
     return (int)im->layers.size();
 }
 
+const MgLayer* MgShapeDoc::getLayer(int index) const
+{
+    return index >= 0 && index < getLayerCount() ? im->layers[index] : NULL;
+}
+
+static MgSymbol* findSymbolInList(const std::vector<MgSymbol*>& symbols, const char* name)
+{
+    for (unsigned i = 0; i < symbols.size(); i++) {
+        if (strcmp(symbols[i]->getName(), name) == 0) {
+            return symbols[i];
+        }
+    }
+    return NULL;
+}
+
+MgSymbol* MgShapeDoc::findSymbol(const char* name) const
+{
+    for (size_t i = im->renamed.size(); name && i > 0; i--) {  // 加载中按文件中的原名查找
+        if (im->renamed[i - 1].first == name) {
+            return im->renamed[i - 1].second;
+        }
+    }
+    return name ? findSymbolInList(im->symbols, name) : NULL;
+}
+
+MgSymbol* MgShapeDoc::addSymbol(MgSymbol* symbol)
+{
+    if (!symbol) {
+        return NULL;
+    }
+    if (std::find(im->symbols.begin(), im->symbols.end(), symbol) != im->symbols.end()) {
+        return symbol;
+    }
+    
+    if (findSymbolInList(im->symbols, symbol->getName())) {
+        // 与其他定义重名时添加名为“原名_序号”的副本，原定义可能还在其他文档中使用
+        std::string name(symbol->getName());
+        char suffix[16];
+        
+        symbol = symbol->clone();
+        for (int n = 2; findSymbolInList(im->symbols, symbol->getName()); n++) {
+#if defined(_MSC_VER) && _MSC_VER >= 1400 // VC8
+            sprintf_s(suffix, sizeof(suffix), "_%d", n);
+#else
+            snprintf(suffix, sizeof(suffix), "_%d", n);
+#endif
+            symbol->setName((name + suffix).c_str());
+        }
+    }
+    else {
+        symbol->addRef();
+    }
+    symbol->freeze();
+    im->symbols.push_back(symbol);
+    
+    return symbol;
+}
+
+bool MgShapeDoc::replaceSymbol(MgSymbol* oldsym, MgSymbol* newsym)
+{
+    std::vector<MgSymbol*>::iterator pos = std::find(im->symbols.begin(), im->symbols.end(), oldsym);
+    unsigned i, j;
+    SymbolMap symmap;
+    
+    if (pos == im->symbols.end() || !newsym || newsym->isFrozen()) {
+        return false;
+    }
+    newsym->setName(oldsym->getName());     // 引用图形按名称保存
+    symmap.push_back(std::pair<MgSymbol*, MgSymbol*>(oldsym, newsym));
+    
+    // 嵌套引用了被替换定义的其他定义也要替换，先找全再复制，以便副本之间的引用都改为新定义
+    for (bool found = true; found; ) {
+        found = false;
+        for (i = 0; i < im->symbols.size(); i++) {
+            MgSymbol* symbol = im->symbols[i];
+            if (mappedSymbol(symmap, symbol))
+                continue;
+            MgShapeIterator it(symbol->shapes());
+            while (const MgShape* sp = it.getNext()) {
+                if (hasMappedSymbol(sp->shapec(), symmap)) {
+                    symmap.push_back(std::pair<MgSymbol*, MgSymbol*>(symbol, symbol));
+                    found = true;
+                    break;
+                }
+            }
+        }
+    }
+    for (j = 1; j < symmap.size(); j++) {
+        symmap[j].second = symmap[j].first->clone();
+    }
+    for (j = 0; j < symmap.size(); j++) {       // 按查找次序处理，被嵌套的定义先更新范围
+        remapShapes(symmap[j].second->editShapes(), symmap, false);
+        symmap[j].second->update();
+        symmap[j].second->freeze();
+    }
+    
+    // 在本文档中换为新定义，原定义和引用它的图形仍由其他文档和撤销快照持有
+    newsym->addRef();
+    for (j = 0; j < symmap.size(); j++) {
+        pos = std::find(im->symbols.begin(), im->symbols.end(), symmap[j].first);
+        (*pos)->release();
+        *pos = symmap[j].second;
+    }
+    for (i = 0; i < im->layers.size(); i++) {
+        remapShapes(im->layers[i], symmap, true);
+    }
+    
+    return true;
+}
+
+int MgShapeDoc::getSymbolCount() const
+{
+    return (int)im->symbols.size();
+}
+
+MgSymbol* MgShapeDoc::getSymbol(int index) const
+{
+    return index >= 0 && index < getSymbolCount() ? im->symbols[index] : NULL;
+}
+
 bool MgShapeDoc::switchLayer(int index)
 {
     bool ret = false;
@@ -285,6 +552,136 @@ int MgShapeDoc::dyndraw(int mode, GiGraphics& gs) const
     return n;
 }
 
+
+//! 分帧显示的游标，记录按图层和图形的层次次序遍历到的位置
+/*! 边遍历边显示，不预先收集可见图形，因此每帧的耗时不随图形总数增长。
+ */
+struct MgDrawCursor {
+    const MgShapeDoc*   doc;        // 添加了引用，保证图形在分帧显示期间有效
+    long                zoomTimes;  // 视图放缩后重新开始
+    Box2d               clip;
+    unsigned            layer;      // 正在遍历的图层序号
+    MgShapeIterator*    it;         // 在该图层中的遍历位置，尚未开始遍历时为NULL
+    
+    MgDrawCursor(const MgShapeDoc* d, GiGraphics& gs) : doc(d), layer(0), it(NULL) {
+        const_cast<MgShapeDoc*>(doc)->addRef();
+        restart(gs);
+    }
+    ~MgDrawCursor() {
+        delete it;
+        const_cast<MgShapeDoc*>(doc)->release();
+    }
+    bool isSameView(GiGraphics& gs) const {
+        return zoomTimes == gs.xf().getZoomTimes() && clip == gs.getClipModel();
+    }
+    // 视图改变后只重置遍历位置，仍在后续帧中逐步显示
+    void restart(GiGraphics& gs) {
+        zoomTimes = gs.xf().getZoomTimes();
+        clip = gs.getClipModel();
+        layer = 0;
+        delete it;
+        it = NULL;
+    }
+    // 返回下一个图形，跳过隐藏的图层，遍历完则返回NULL
+    const MgShape* next(const std::vector<MgLayer*>& layers) {
+        for (; layer < layers.size(); layer++) {
+            if (!it) {
+                if (layers[layer]->isHided())
+                    continue;
+                it = new MgShapeIterator(layers[layer]);
+            }
+            if (const MgShape* sp = it->getNext())
+                return sp;
+            delete it;
+            it = NULL;
+        }
+        return NULL;
+    }
+};
+
+int MgShapeDoc::dyndraw(int mode, GiGraphics& gs, long& cursor, int budget) const
+{
+    MgDrawCursor* c = (MgDrawCursor*)cursor;
+    
+    if (c && c->doc != this) {
+        delete c;
+        c = NULL;
+    }
+    if (!c) {
+        c = new MgDrawCursor(this, gs);
+    }
+    else if (!c->isSameView(gs)) {
+        c->restart(gs);
+    }
+    
+    // 按层次次序显示，续显示只在已显示图形之上叠加，最终结果与 dyndraw 一致
+    unsigned start = giGetTickCount();
+    bool done = false;
+    int n = 0;
+    int skipped = 0;
+    
+    while (!gs.isStopping()) {
+        const MgShape* sp = c->next(im->layers);
+        
+        if (!sp) {
+            done = true;
+            break;
+        }
+        if (sp->shapec()->getExtent().isIntersect(c->clip)) {
+            if (sp->draw(mode, gs, NULL, -1))
+                n++;
+        }
+        else if (++skipped % 64 != 0) {             // 跳过不可见的图形时不必每次计时
+            continue;
+        }
+        if (giGetTickCount() - start >= (unsigned)budget)  // 每次至少显示一个图形
+            break;
+    }
+    if (!done) {
+        cursor = (long)c;
+    } else {
+        delete c;
+        cursor = 0;
+    }
+    
+    return n;
+}
+
+void MgShapeDoc::releaseDrawCursor(long cursor)
+{
+    delete (MgDrawCursor*)cursor;
+}
+
+typedef std::pair<std::vector<MgSymbol*>*, int> SymbolsToSave;   // 已收集的定义和嵌套深度
+static void collectSymbol(const MgShape* sp, void* data);
+
+static bool hasSymbol(const std::vector<MgSymbol*>& symbols, const MgSymbol* symbol)
+{
+    return std::find(symbols.begin(), symbols.end(), symbol) != symbols.end();
+}
+
+// 按依赖次序收集要保存的图元定义，被嵌套引用的定义在前
+static void addSymbolToSave(MgSymbol* symbol, std::vector<MgSymbol*>& symbols, int depth)
+{
+    if (!symbol || symbol->getShapeCount() == 0 || depth > 20   // 跳过缺失的定义，避免循环引用
+        || hasSymbol(symbols, symbol)) {
+        return;
+    }
+    
+    SymbolsToSave data(&symbols, depth + 1);
+    const_cast<MgShapes*>(symbol->shapes())->traverseByType(MgSymbolShape::Type(), collectSymbol, &data);
+    
+    if (!hasSymbol(symbols, symbol)) {
+        symbols.push_back(symbol);
+    }
+}
+
+static void collectSymbol(const MgShape* sp, void* data)
+{
+    SymbolsToSave* d = (SymbolsToSave*)data;
+    addSymbolToSave(((const MgSymbolShape*)sp->shapec())->getSymbol(), *d->first, d->second);
+}
+
 bool MgShapeDoc::save(MgStorage* s, int startIndex) const
 {
     bool ret = true;
@@ -299,9 +696,35 @@ bool MgShapeDoc::save(MgStorage* s, int startIndex) const
         s->writeFloatArray("pageExtent", im->rectWInitial.isEmpty() ?
                            &im->rectW.xmin : &im->rectWInitial.xmin, 4);
         s->writeFloat("viewScale", im->viewScale);
+        if (im->originX != 0 || im->originY != 0) {
+            // 双精度原点拆分为高低两部分单精度数保存
+            float origin[4] = { (float)im->originX, (float)im->originY };
+            origin[2] = (float)(im->originX - origin[0]);
+            origin[3] = (float)(im->originY - origin[1]);
+            s->writeFloatArray("origin", origin, 4);
+        }
         rect = getExtent();
         s->writeFloatArray("extent", &rect.xmin, 4);
         s->writeInt("count", (int)im->layers.size());
+        
+        std::vector<MgSymbol*> symbols;
+        SymbolsToSave data(&symbols, 0);
+        
+        for (unsigned i = 0; i < im->symbols.size(); i++) {
+            addSymbolToSave(im->symbols[i], symbols, 0);
+        }
+        for (unsigned i = 0; i < im->layers.size(); i++) {   // 文档中没有的定义也随引用图形保存
+            im->layers[i]->traverseByType(MgSymbolShape::Type(), collectSymbol, &data);
+        }
+        if (!symbols.empty() && s->writeNode("symbols", -1, false)) {
+            for (unsigned i = 0; i < symbols.size(); i++) {
+                if (s->writeNode("symbol", i, false)) {
+                    symbols[i]->save(s);
+                    s->writeNode("symbol", i, true);
+                }
+            }
+            s->writeNode("symbols", -1, true);
+        }
     }
 
     for (unsigned i = 0; i < im->layers.size(); i++) {
@@ -331,8 +754,33 @@ bool MgShapeDoc::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
             im->rectWInitial = im->rectW;
         }
         im->viewScale = s->readFloat("viewScale", im->viewScale);
+        
+        float origin[4] = { 0, 0, 0, 0 };
+        s->readFloatArray("origin", origin, 4, false);
+        im->originX = (double)origin[0] + origin[2];
+        im->originY = (double)origin[1] + origin[3];
+        
         s->readFloatArray("extent", &rect.xmin, 4, false);
         s->readInt("count", 0);
+        
+        while (!im->symbols.empty()) {
+            im->symbols.back()->release();
+            im->symbols.pop_back();
+        }
+    }
+    if (s->readNode("symbols", -1, false)) {        // 先加载图元定义，以便引用图形按名称查找
+        for (int i = 0; s->readNode("symbol", i, false); i++) {
+            MgSymbol* symbol = MgSymbol::create("");
+            if (symbol->load(factory, s, im->layers[0]) && *symbol->getName()) {
+                MgSymbol* added = addSymbol(symbol);
+                if (added != symbol) {              // 本次加载的图形仍按原名引用改名的定义
+                    im->renamed.push_back(std::pair<std::string, MgSymbol*>(symbol->getName(), added));
+                }
+            }
+            symbol->release();
+            s->readNode("symbol", i, true);
+        }
+        s->readNode("symbols", -1, true);
     }
 
     for (int i = 0; i < 99; i++) {
@@ -354,6 +802,7 @@ bool MgShapeDoc::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
     }
 
     s->readNode("shapedoc", -1, true);
+    im->renamed.clear();
 
     return ret;
 }
@@ -374,6 +823,12 @@ bool MgShapeDoc::loadAll(MgShapeFactory* factory, MgStorage* s, GiTransform* xfo
     
     bool ret = load(factory, s, false);
     if (ret && xform) {
+        Box2d limits(xform->getWorldLimits());
+        Box2d rectW(getExtent() * im->xf);
+        
+        if (!rectW.isEmpty() && !limits.contains(rectW)) {   // 扩大显示极限以容纳大范围图形
+            xform->setWorldLimits(limits.unionWith(rectW));
+        }
         xform->setModelTransform(im->xf);
         xform->zoomTo(im->rectWInitial.isEmpty() ? im->rectW : im->rectWInitial);
     }
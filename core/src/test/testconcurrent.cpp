@@ -0,0 +1,137 @@
+//! \file testconcurrent.cpp
+//! \brief Implement the stress testing class: TestConcurrentViews.
+// Copyright (c) 2012-2014, https://github.com/rhcad/touchvg
+
+#include "testconcurrent.h"
+#include "gicoreview.h"
+#include "girastercanvas.h"
+#include "githread.h"
+#include "gilock.h"
+#include "mglog.h"
+#include <vector>
+
+static const int kWidth = 200;
+static const int kHeight = 160;
+
+struct TestViewItem : public GiView {
+    GiCoreView*     coreView;
+    int             index;
+    int             rounds;
+    int             shapes;     // expected count of shapes
+    unsigned        checksum;   // of the last frame drawn in the thread
+    bool            failed;
+    std::vector<unsigned char> pixels;
+};
+
+static unsigned renderView(TestViewItem* item)
+{
+    GiRasterCanvas canvas;
+    unsigned sum = 0;
+    
+    canvas.attach(&item->pixels.front(), kWidth, kHeight);
+    canvas.clear(0xFFFFFFFF);
+    
+    long doc = item->coreView->acquireFrontDoc();
+    long gs = item->coreView->acquireGraphics(item);
+    
+    if (item->coreView->drawAll(doc, gs, &canvas) < 0) {
+        item->failed = true;
+    }
+    item->coreView->releaseGraphics(gs);
+    GiCoreView::releaseDoc(doc);
+    canvas.detach();
+    
+    for (size_t i = 0; i < item->pixels.size(); i++) {
+        sum = sum * 31 + item->pixels[i];
+    }
+    return sum;
+}
+
+static void drawLine(TestViewItem* item, int round)
+{
+    float x = (float)(10 + round * 7 % (kWidth - 40));
+    float y = (float)(10 + round * 13 % (kHeight - 40));
+    
+    item->coreView->onGesture(item, kGiGesturePan, kGiGestureBegan, x, y);
+    item->coreView->onGesture(item, kGiGesturePan, kGiGestureMoved, x + 15, y + 10);
+    item->coreView->onGesture(item, kGiGesturePan, kGiGestureEnded, x + 30, y + 20);
+}
+
+static void testView(TestViewItem* item)
+{
+    item->coreView->setDisplayDpi(96 + 64 * (item->index % 4), 1.f + 0.5f * (item->index % 3));
+    item->coreView->onSize(item, kWidth, kHeight);
+    item->coreView->setCommand("line");
+    
+    for (int i = 0; i < item->rounds; i++) {
+        item->shapes += item->coreView->addShapesForTest(4);
+        
+        int n = item->coreView->getShapeCount();
+        drawLine(item, i);
+        if (item->coreView->getShapeCount() == n + 1) {
+            item->shapes++;
+        }
+        item->coreView->submitBackDoc(item, true);
+        item->coreView->submitDynamicShapes(item);
+        item->checksum = renderView(item);
+    }
+    if (item->coreView->getShapeCount() != item->shapes) {
+        LOGE("View %d has %d shapes, expected %d", item->index,
+             item->coreView->getShapeCount(), item->shapes);
+        item->failed = true;
+    }
+}
+
+// Each pool thread takes the next view that is not tested yet.
+struct TestViewList {
+    std::vector<TestViewItem>*  items;
+    volatile long               next;
+};
+
+static void testTask(void* data)
+{
+    TestViewList* list = (TestViewList*)data;
+    
+    for (long i = giAtomicIncrement(&list->next) - 1; i < (long)list->items->size();
+         i = giAtomicIncrement(&list->next) - 1) {
+        testView(&(*list->items)[i]);
+    }
+}
+
+int TestConcurrentViews::run(int views, int rounds)
+{
+    std::vector<TestViewItem> items(views > 0 ? views : 1);
+    TestViewList list = { &items, 0 };
+    int failed = 0;
+    int i;
+    
+    for (i = 0; i < (int)items.size(); i++) {
+        TestViewItem& item = items[i];
+        item.coreView = GiCoreView::createView(&item);
+        item.index = i;
+        item.rounds = rounds;
+        item.shapes = 0;
+        item.checksum = 0;
+        item.failed = false;
+        item.pixels.resize(kWidth * kHeight * 4);
+    }
+    
+    GiThreadPool::run(testTask, &list, (int)items.size());
+    
+    // The views don't share any mutable state, so drawing them again alone gives the same pixels.
+    for (i = 0; i < (int)items.size(); i++) {
+        TestViewItem& item = items[i];
+        
+        if (renderView(&item) != item.checksum) {
+            LOGE("View %d draws differently after the concurrent test", i);
+            item.failed = true;
+        }
+        if (item.failed) {
+            failed++;
+        }
+        item.coreView->destoryView(&item);
+        item.coreView->release();
+    }
+    
+    return failed;
+}
@@ -8,6 +8,7 @@
 #include "gigesture.h"
 #include "mgcmd.h"
 #include "mgshapedoc.h"
+#include <vector>
 
 class GiView;
 
@@ -35,8 +36,24 @@ public:
     
     virtual bool onGesture(const MgMotion& motion);                 //!< 传递单指触摸手势消息
     virtual bool twoFingersMove(const MgMotion& motion);            //!< 传递双指移动手势(可放缩旋转)
+    
+    //! 显示文档的各图层，放缩平移手势中复用画布的图层快照
+    /*! 手势开始后首次显示时将各图层显示到画布的离屏图层中，之后仅按坐标系变化贴图，
+        图层内容改变、出现旋转或手势结束后重新显示图形。画布不支持离屏图层时直接显示图形。
+     */
+    int drawLayers(int mode, GiGraphics& gs, const MgShapeDoc* doc);
+    
+    long drawnInkSeq() const { return _inkSeq; }                    //!< 返回本视图笔迹层已显示到的序号
+    void setDrawnInkSeq(long seq) { _inkSeq = seq; }                //!< 记下本视图笔迹层已显示到的序号
 
 private:
+    struct LayerCache {                 //!< 图层快照的状态
+        bool        valid;              //!< 画布中是否有快照
+        long        changeCount;        //!< 快照时图层的改变计数
+        int         shapeCount;         //!< 快照时图层的图形数
+        Matrix2d    modelToDisplay;     //!< 快照时的坐标系
+    };
+    
     MgView*     _mgview;
     GiView*     _view;
     GiGraphics  _gsFront;
@@ -45,6 +62,8 @@ private:
     float       _lastScale;
     bool        _zooming;
     bool        _zoomEnabled;
+    long        _inkSeq;
+    std::vector<LayerCache> _layerCaches;
 };
 
 #endif // TOUCHVG_CORE_BASEVIEW_H
@@ -3,6 +3,8 @@
 // Copyright (c) 2012-2013, https://github.com/rhcad/touchvg
 
 #include "GcGraphView.h"
+#include "gicanvas.h"
+#include "mglayer.h"
 #include "mglog.h"
 
 // GcBaseView
@@ -74,6 +76,52 @@ bool GcBaseView::twoFingersMove(const MgMotion& motion)
     return true;
 }
 
+int GcBaseView::drawLayers(int mode, GiGraphics& gs, const MgShapeDoc* doc)
+{
+    GiCanvas* canvas = gs.getCanvas();
+    const Matrix2d& m2d = gs.xf().modelToDisplay();
+    int n = 0;
+    
+    if ((int)_layerCaches.size() < doc->getLayerCount()) {
+        LayerCache c = { false, 0, 0, Matrix2d() };
+        _layerCaches.resize(doc->getLayerCount(), c);
+    }
+    for (int i = 0; i < doc->getLayerCount(); i++) {
+        const MgLayer* layer = doc->getLayer(i);
+        LayerCache& c = _layerCaches[i];
+        
+        if (layer->isHided()) {
+            continue;
+        }
+        if (!_zooming || !canvas) {         // 手势结束后重新显示清晰的图形
+            c.valid = false;
+            n += layer->dyndraw(mode, gs, NULL, -1);
+            continue;
+        }
+        if (c.valid && c.changeCount == layer->getChangeCount()
+            && c.shapeCount == layer->getShapeCount()) {
+            Matrix2d mat(c.modelToDisplay.inverse() * m2d);     // 快照显示坐标到当前显示坐标
+            if (mat.isOrtho() && mgEquals(mat.m11, mat.m22) && mat.m11 > 0
+                && canvas->drawCachedLayer(i, mat.m11, mat.dx, mat.dy)) {
+                n += layer->getShapeCount();
+                continue;
+            }
+        }
+        
+        c.valid = canvas->beginLayerCache(i, (float)gs.xf().getWidth(), (float)gs.xf().getHeight());
+        n += layer->dyndraw(mode, gs, NULL, -1);
+        if (c.valid) {
+            canvas->endLayerCache(i);
+            c.changeCount = layer->getChangeCount();
+            c.shapeCount = layer->getShapeCount();
+            c.modelToDisplay = m2d;
+            c.valid = canvas->drawCachedLayer(i, 1.f, 0.f, 0.f);
+        }
+    }
+    
+    return n;
+}
+
 // GcGraphView
 //
 
@@ -0,0 +1,197 @@
+﻿//! \file gibatchrender.cpp
+//! \brief 实现批量显示图形文件的类 GiBatchRenderer
+// Copyright (c) 2012-2014, https://github.com/rhcad/touchvg
+
+#include "gibatchrender.h"
+#include "mgshapedoc.h"
+#include "mgjsonstorage.h"
+#include "mgstorage.h"
+#include "spfactoryimpl.h"
+#include "gigraph.h"
+#include "gilock.h"
+#include "gitick.h"
+#include "githread.h"
+#include "mglog.h"
+#include <vector>
+#include <string>
+
+struct GiBatchItem {
+    std::string file;
+    int         width;
+    int         height;
+    int         state;
+    int         shapeCount;
+    long        loadTime;
+    long        drawTime;
+};
+
+struct GiBatchRenderer::Impl {
+    GiBatchCanvasFactory*       factory;
+    MgShapeFactoryImpl          shapeFactory;   // 只在显示前注册图形类型，显示时只读
+    std::vector<GiBatchItem>    items;
+    volatile long               next;           // 下一个待显示的文件序号
+    volatile long               succeeded;
+    int                         margin;
+
+    Impl(GiBatchCanvasFactory* f) : factory(f), next(0), succeeded(0), margin(4) {}
+};
+
+GiBatchRenderer::GiBatchRenderer(GiBatchCanvasFactory* factory)
+{
+    impl = new Impl(factory);
+}
+
+GiBatchRenderer::~GiBatchRenderer()
+{
+    delete impl;
+}
+
+MgShapeFactory* GiBatchRenderer::getShapeFactory()
+{
+    return &impl->shapeFactory;
+}
+
+void GiBatchRenderer::setMargin(int margin)
+{
+    impl->margin = margin;
+}
+
+int GiBatchRenderer::addFile(const char* vgfile, int width, int height)
+{
+    GiBatchItem item;
+
+    item.file = vgfile ? vgfile : "";
+    item.width = width;
+    item.height = height;
+    item.state = 0;
+    item.shapeCount = 0;
+    item.loadTime = 0;
+    item.drawTime = 0;
+    impl->items.push_back(item);
+
+    return (int)impl->items.size() - 1;
+}
+
+int GiBatchRenderer::getCount() const
+{
+    return (int)impl->items.size();
+}
+
+void GiBatchRenderer::reset()
+{
+    for (size_t i = 0; i < impl->items.size(); i++) {
+        impl->items[i].state = 0;
+        impl->items[i].shapeCount = 0;
+        impl->items[i].loadTime = 0;
+        impl->items[i].drawTime = 0;
+    }
+    impl->next = 0;
+    impl->succeeded = 0;
+}
+
+bool GiBatchRenderer::renderNext()
+{
+    long index = giAtomicIncrement(&impl->next) - 1;
+
+    if (index >= (long)impl->items.size()) {
+        return false;
+    }
+    render((int)index);
+    return true;
+}
+
+void GiBatchRenderer::render(int index)
+{
+    GiBatchItem& item = impl->items[index];
+    unsigned tick = giGetTickCount();
+    MgShapeDoc* doc = MgShapeDoc::createDoc();
+    FILE *fp = mgopenfile(item.file.c_str(), "rt");
+    bool ret = false;
+
+    if (fp) {
+        MgJsonStorage s;
+        ret = doc->load(&impl->shapeFactory, s.storageForRead(fp), false);
+        fclose(fp);
+    }
+    item.shapeCount = doc->getShapeCount();
+    item.loadTime = (long)(giGetTickCount() - tick);
+
+    if (!ret) {
+        LOGE("Fail to load file: %s", item.file.c_str());
+        item.state = -1;
+    }
+    else {
+        GiCanvas* canvas = impl->factory ? impl->factory->createCanvas(
+            index, item.file.c_str(), item.width, item.height) : NULL;
+
+        tick = giGetTickCount();
+        if (!canvas) {
+            item.state = -2;
+        }
+        else {
+            GiGraphics gs;
+            GiTransform& xf = gs._xf();
+            Box2d rectW(doc->getExtent() * doc->modelTransform());
+            RECT_2D to;
+
+            xf.setWndSize(item.width, item.height);
+            xf.setModelTransform(doc->modelTransform());
+            if (!rectW.isEmpty()) {         // 缩略图可能远小于图形，放宽显示比例和范围的限制
+                xf.setViewScaleRange(1e-5f, 5.f);
+                xf.setWorldLimits(Box2d(xf.getWorldLimits()).unionWith(rectW));
+                Box2d(xf.getWndRect()).deflate((float)impl->margin).get(to);
+                xf.zoomTo(rectW, &to);
+            }
+            ret = gs.beginPaint(canvas);
+            if (ret) {
+                doc->draw(gs);
+                gs.endPaint();
+                giAtomicIncrement(&impl->succeeded);
+            }
+            item.state = ret ? 1 : -2;
+            impl->factory->releaseCanvas(index, canvas, ret);
+        }
+        item.drawTime = (long)(giGetTickCount() - tick);
+    }
+    doc->release();
+}
+
+static void batchTask(void* data)
+{
+    while (((GiBatchRenderer*)data)->renderNext()) {}
+}
+
+int GiBatchRenderer::run(int threads)
+{
+    long from = impl->succeeded;
+
+    if (threads > getCount())
+        threads = getCount();
+    if (threads < 1)
+        threads = 1;
+
+    // 用常驻线程池中的 threads-1 个线程，当前线程也参与显示
+    GiThreadPool::run(batchTask, this, threads);
+
+    return (int)(impl->succeeded - from);
+}
+
+int GiBatchRenderer::getState(int index) const
+{
+    return index >= 0 && index < getCount() ? impl->items[index].state : 0;
+}
+
+int GiBatchRenderer::getShapeCount(int index) const
+{
+    return index >= 0 && index < getCount() ? impl->items[index].shapeCount : 0;
+}
+
+long GiBatchRenderer::getLoadTime(int index) const
+{
+    return index >= 0 && index < getCount() ? impl->items[index].loadTime : 0;
+}
+
+long GiBatchRenderer::getDrawTime(int index) const
+{
+    return index >= 0 && index < getCount() ? impl->items[index].drawTime : 0;
+}
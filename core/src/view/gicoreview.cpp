@@ -14,14 +14,14 @@
 #include "mgpathsp.h"
 
 static volatile long _viewCount = 0;    // 总视图数
-static int _dpi = 96;                   // 屏幕分辨率，在 GiCoreView::onSize() 中应用到新视图中
-float GiCoreViewImpl::_factor = 1.0f;   // 屏幕放大系数，Android高清屏可用
+static int _defaultDpi = 96;            // 新建视图的屏幕分辨率，各视图可用 setDisplayDpi 单独设置
+static float _defaultFactor = 1.0f;     // 新建视图的屏幕放大系数
 
 // GcBaseView
 //
 
 GcBaseView::GcBaseView(MgView* mgview, GiView *view)
-    : _mgview(mgview), _view(view), _zooming(false), _zoomEnabled(true)
+    : _mgview(mgview), _view(view), _zooming(false), _zoomEnabled(true), _inkSeq(0)
 {
     mgview->document()->addView(this);
     LOGD("View %p created", this);
@@ -31,12 +31,14 @@ GcBaseView::GcBaseView(MgView* mgview, GiView *view)
 //
 
 GiCoreViewImpl::GiCoreViewImpl(GiCoreView* owner, bool useCmds)
-    : _cmds(NULL), curview(NULL), refcount(1)
+    : _factor(_defaultFactor), _dpi(_defaultDpi), _cmds(NULL), curview(NULL), refcount(1)
     , gestureHandler(0), regenPending(-1), appendPending(-1), redrawPending(-1)
-    , changeCount(0), drawCount(0), stopping(0)
+    , changeCount(0), drawCount(0), inkEnabled(false)
+    , sampleCount(0), batchDepth(0), batchLocker(NULL), stopping(0)
 {
-    memset(&gsBuf, 0, sizeof(gsBuf));
-    memset((void*)&gsUsed, 0, sizeof(gsUsed));
+    inkFront = new GiInkFrame(NULL, 0, 0, false);
+    memset((void*)&gsPool, 0, sizeof(gsPool));
+    memset((void*)&gsStats, 0, sizeof(gsStats));
     
     drawing = GiPlaying::create(NULL, GiPlaying::kDrawingTag, useCmds);
     backDoc = drawing->getBackDoc();
@@ -60,13 +62,137 @@ GiCoreViewImpl::GiCoreViewImpl(GiCoreView* owner, bool useCmds)
 
 GiCoreViewImpl::~GiCoreViewImpl()
 {
-    for (unsigned i = 0; i < sizeof(gsBuf)/sizeof(gsBuf[0]); i++) {
-        delete gsBuf[i];
+    for (GiGraphicsBlock* block = &gsPool; block; ) {
+        GiGraphicsBlock* next = block->nextBlock();
+        for (int i = 0; i < GiGraphicsBlock::kSlots; i++) {
+            delete block->slots[i].gs;
+        }
+        if (block != &gsPool) {
+            delete block;
+        }
+        block = next;
     }
     MgObject::release_pointer(_cmds);
+    inkFront->release();
     delete _gcdoc;
 }
 
+GiGraphics* GiCoreViewImpl::acquireGs(GcBaseView* aview)
+{
+    const GiGraphics* src = aview->graph();
+    const long srcVersion = src->getVersion();
+    GiGraphicsBlock::Slot* slot = NULL;
+    GiGraphicsBlock* block;
+    int i;
+    
+    // 优先复用上次复制自同一视图且坐标系未变的对象，不必再复制
+    for (block = &gsPool; block && !slot; block = block->nextBlock()) {
+        for (i = 0; i < GiGraphicsBlock::kSlots && !slot; i++) {
+            GiGraphicsBlock::Slot& s = block->slots[i];
+            if (!s.used && s.gs && s.src == src && s.srcVersion == srcVersion) {
+                if (giAtomicCompareAndSwap(&s.used, 1, 0)) {
+                    if (s.src == src && s.srcVersion == srcVersion
+                        && s.version == s.gs->getVersion()) {
+                        giAtomicIncrement(&gsStats[1]);
+                        return s.gs;
+                    }
+                    slot = &s;      // 占用前已被其他线程改用，需重新复制
+                } else {
+                    giAtomicIncrement(&gsStats[4]);
+                }
+            }
+        }
+    }
+    
+    // 其次复用任一空闲对象或空槽
+    for (block = &gsPool; block && !slot; block = block->nextBlock()) {
+        for (i = 0; i < GiGraphicsBlock::kSlots && !slot; i++) {
+            GiGraphicsBlock::Slot& s = block->slots[i];
+            if (!s.used) {
+                if (giAtomicCompareAndSwap(&s.used, 1, 0)) {
+                    slot = &s;
+                } else {
+                    giAtomicIncrement(&gsStats[4]);
+                }
+            }
+        }
+    }
+    
+    // 各块已占满则追加一块，先占用其首槽再挂到链表末尾
+    if (!slot) {
+        GiGraphicsBlock* newBlock = new GiGraphicsBlock();
+        memset((void*)newBlock, 0, sizeof(GiGraphicsBlock));
+        slot = &newBlock->slots[0];
+        slot->used = 1;
+        
+        for (block = &gsPool; ; block = block->nextBlock()) {
+            if (!block->next && giAtomicCompareAndSwap(&block->next, (long)newBlock, 0)) {
+                break;
+            }
+        }
+    }
+    
+    if (!slot->gs) {
+        slot->gs = new GiGraphics();
+        giAtomicIncrement(&gsStats[0]);
+        giAtomicIncrement(&gsStats[3]);
+    } else {
+        giAtomicIncrement(&gsStats[2]);
+    }
+    aview->copyGs(slot->gs);
+    slot->src = src;
+    slot->srcVersion = srcVersion;
+    slot->version = slot->gs->getVersion();
+    
+    return slot->gs;
+}
+
+bool GiCoreViewImpl::releaseGs(GiGraphics* gs)
+{
+    for (GiGraphicsBlock* block = &gsPool; block; block = block->nextBlock()) {
+        for (int i = 0; i < GiGraphicsBlock::kSlots; i++) {
+            if (block->slots[i].gs == gs) {
+                giAtomicCompareAndSwap(&block->slots[i].used, 0, 1);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void GiCoreViewImpl::beginBatch()
+{
+    if (batchDepth++ == 0) {
+        hideContextActions();
+        batchLocker = new DrawLocker(this);     // 各图形的区域合并为一个待显示区域
+    }
+}
+
+void GiCoreViewImpl::commitBatch()
+{
+    if (batchDepth <= 0 || --batchDepth > 0) {
+        return;
+    }
+    
+    int counts[3];
+    std::vector<int> ids;
+    
+    for (int i = 0; i < 3; i++) {
+        counts[i] = (int)batchIds[i].size();
+        ids.insert(ids.end(), batchIds[i].begin(), batchIds[i].end());
+        batchIds[i].clear();
+    }
+    if (!ids.empty()) {
+        getCmdSubject()->onShapesChanged(motion(), counts[0], counts[1], counts[2], &ids.front());
+    }
+    if (counts[2] > 0) {
+        mgvector<int> delIds(&ids[counts[0] + counts[1]], counts[2]);
+        CALL_VIEW(deviceView()->shapesDeleted(delIds));
+    }
+    delete batchLocker;
+    batchLocker = NULL;
+}
+
 void GiCoreViewImpl::calcContextButtonPosition(mgvector<float>& pos, int n, const Box2d& box)
 {
     Box2d selbox(box);
@@ -325,8 +451,7 @@ bool GiCoreView::submitBackDoc(GiView* view, bool changed)
         }
         impl->drawing->submitBackDoc();
         if (changed) {
-            static long n = 0;
-            giAtomicCompareAndSwap(&impl->changeCount, ++n, impl->changeCount);
+            giAtomicIncrement(&impl->changeCount);
         }
     }
     if (aview) {
@@ -388,20 +513,42 @@ int GiCoreView::setBkColor(GiView* view, int argb)
 
 void GiCoreView::setScreenDpi(int dpi, float factor)
 {
-    if (_dpi != dpi && dpi > 0) {
-        _dpi = dpi;
+    if (dpi > 0) {
+        _defaultDpi = dpi;
+    }
+    if (factor > 0.1f) {
+        _defaultFactor = factor;
+    }
+}
+
+void GiCoreView::setDisplayDpi(int dpi, float factor)
+{
+    DrawLocker locker(impl);
+    
+    if (dpi > 0) {
+        impl->_dpi = dpi;
+    }
+    if (factor > 0.1f) {
+        impl->_factor = factor;
     }
-    if (GiCoreViewImpl::_factor != factor && factor > 0.1f) {
-        GiCoreViewImpl::_factor = factor;
-        GiGraphics::setPenWidthFactor(factor);
+    for (int i = 0; i < impl->_gcdoc->getViewCount(); i++) {
+        GcBaseView* v = impl->_gcdoc->getView(i);
+        Box2d rect(v->xform()->getWndRect());
+        
+        v->onSize(impl->_dpi, (int)rect.width(), (int)rect.height());
+        v->graph()->setPenWidthFactor(impl->_factor);
     }
+    impl->regenAll(true);
 }
 
 bool GiCoreView::isDrawing()
 {
-    for (unsigned i = 0; i < sizeof(impl->gsBuf)/sizeof(impl->gsBuf[0]); i++) {
-        if (impl->gsUsed[i] && impl->gsBuf[i] && impl->gsBuf[i]->isDrawing())
-            return true;
+    for (GiGraphicsBlock* block = &impl->gsPool; block; block = block->nextBlock()) {
+        for (int i = 0; i < GiGraphicsBlock::kSlots; i++) {
+            GiGraphics* gs = block->slots[i].gs;
+            if (block->slots[i].used && gs && gs->isDrawing())
+                return true;
+        }
     }
     return false;
 }
@@ -416,9 +563,12 @@ bool GiCoreView::isStopping()
     if (!this || !impl || impl->stopping) {
         return true;
     }
-    for (unsigned i = 0; i < sizeof(impl->gsBuf)/sizeof(impl->gsBuf[0]); i++) {
-        if (impl->gsUsed[i] && impl->gsBuf[i] && impl->gsBuf[i]->isStopping())
-            return true;
+    for (GiGraphicsBlock* block = &impl->gsPool; block; block = block->nextBlock()) {
+        for (int i = 0; i < GiGraphicsBlock::kSlots; i++) {
+            GiGraphics* gs = block->slots[i].gs;
+            if (block->slots[i].used && gs && gs->isStopping())
+                return true;
+        }
     }
     return false;
 }
@@ -432,10 +582,12 @@ int GiCoreView::stopDrawing(bool stop)
     else while (impl->stopping > 0 && !stop)
         giAtomicDecrement(&impl->stopping);
     
-    for (unsigned i = 0; i < sizeof(impl->gsBuf)/sizeof(impl->gsBuf[0]); i++) {
-        if (impl->gsBuf[i]) {
-            impl->gsBuf[i]->stopDrawing(stop);
-            n++;
+    for (GiGraphicsBlock* block = &impl->gsPool; block; block = block->nextBlock()) {
+        for (int i = 0; i < GiGraphicsBlock::kSlots; i++) {
+            if (block->slots[i].gs) {
+                block->slots[i].gs->stopDrawing(stop);
+                n++;
+            }
         }
     }
     return n;
@@ -447,58 +599,38 @@ long GiCoreView::acquireGraphics(GiView* view)
     if (!aview)
         return 0;
     
-    GiGraphics* gs = (GiGraphics*)0;
-    int i = sizeof(impl->gsBuf)/sizeof(impl->gsBuf[0]);
-    
-    while (--i >= 0) {
-        if (!impl->gsUsed[i] && impl->gsBuf[i]) {
-            if (giAtomicIncrement(&impl->gsUsed[i]) == 1) {
-                gs = impl->gsBuf[i];
-                aview->copyGs(gs);
-                break;
-            } else {
-                giAtomicDecrement(&impl->gsUsed[i]);
-            }
-        }
-    }
-    if (!gs) {
-        gs = new GiGraphics();
-        aview->copyGs(gs);
-        for (i = 0; i < (int)(sizeof(impl->gsBuf)/sizeof(impl->gsBuf[0])); i++) {
-            if (!impl->gsBuf[i]) {
-                if (giAtomicIncrement(&impl->gsUsed[i]) == 1) {
-                    impl->gsBuf[i] = gs;
-                    break;
-                } else {
-                    giAtomicDecrement(&impl->gsUsed[i]);
-                }
-            }
-        }
-    }
-    
-    return gs->toHandle();
+    return impl->acquireGs(aview)->toHandle();
 }
 
 void GiCoreView::releaseGraphics(long hGs)
 {
     GiGraphics* gs = GiGraphics::fromHandle(hGs);
     
-    if (!gs) {
-        return;
-    }
-    for (unsigned i = 0; i < sizeof(impl->gsBuf)/sizeof(impl->gsBuf[0]); i++) {
-        if (impl->gsBuf[i] == gs) {
-            giAtomicDecrement(&impl->gsUsed[i]);
-            return;
-        }
+    if (gs && !impl->releaseGs(gs)) {
+        delete gs;
     }
-    delete gs;
+}
+
+long GiCoreView::getGraphicsStats(int type)
+{
+    return type >= 0 && type < (int)(sizeof(impl->gsStats)/sizeof(impl->gsStats[0]))
+        ? impl->gsStats[type] : 0;
 }
 
 int GiCoreView::drawAll(GiView* view, GiCanvas* canvas) {
+    GcBaseView* aview = impl->_gcdoc->findView(view);
     long doc = acquireFrontDoc();
     long hGs = acquireGraphics(view);
-    int n = drawAll(doc, hGs, canvas);
+    GiGraphics* gs = GiGraphics::fromHandle(hGs);
+    int n = -1;
+    
+    if (!aview) {
+        n = drawAll(doc, hGs, canvas);
+    }
+    else if (doc && gs && gs->beginPaint(canvas)) {     // 放缩平移时复用图层快照
+        n = aview->drawLayers(isZooming() ? 2 : 0, *gs, MgShapeDoc::fromHandle(doc));
+        gs->endPaint();
+    }
     releaseDoc(doc);
     releaseGraphics(hGs);
     return n;
@@ -513,6 +645,15 @@ int GiCoreView::drawAppend(GiView* view, GiCanvas* canvas, int sid) {
     return n;
 }
 
+int GiCoreView::drawRegion(GiView* view, GiCanvas* canvas, float x, float y, float w, float h) {
+    long doc = acquireFrontDoc();
+    long hGs = acquireGraphics(view);
+    int n = drawRegion(doc, hGs, canvas, x, y, w, h);
+    releaseDoc(doc);
+    releaseGraphics(hGs);
+    return n;
+}
+
 int GiCoreView::dynDraw(GiView* view, GiCanvas* canvas){
     long hShapes = acquireDynamicShapes();
     long hGs = acquireGraphics(view);
@@ -522,6 +663,84 @@ int GiCoreView::dynDraw(GiView* view, GiCanvas* canvas){
     return n;
 }
 
+int GiCoreView::drawNewInk(GiView* view, GiCanvas* canvas)
+{
+    GcBaseView* aview = impl->_gcdoc->findView(view);
+    
+    if (!aview) {
+        return -1;
+    }
+    
+    long ink = acquireNewInk();
+    long hGs = acquireGraphics(view);
+    int n = drawNewInk(ink, hGs, canvas, aview->drawnInkSeq());
+    
+    aview->setDrawnInkSeq(getInkSequence(ink));     // 各视图分别记录，放大镜等视图也能显示全部新笔迹
+    releaseGraphics(hGs);
+    releaseNewInk(ink);
+    
+    return n;
+}
+
+long GiCoreView::acquireNewInk()
+{
+    impl->inkFront->addRef();
+    return impl->inkFront->toHandle();
+}
+
+void GiCoreView::releaseNewInk(long ink)
+{
+    GiInkFrame* frame = GiInkFrame::fromHandle(ink);
+    if (frame) {
+        frame->release();
+    }
+}
+
+long GiCoreView::getInkSequence(long ink)
+{
+    GiInkFrame* frame = GiInkFrame::fromHandle(ink);
+    return frame ? frame->seq : 0;
+}
+
+int GiCoreView::drawNewInk(long ink, long hGs, GiCanvas* canvas, long drawnSeq)
+{
+    GiInkFrame* frame = GiInkFrame::fromHandle(ink);
+    GiGraphics* gs = GiGraphics::fromHandle(hGs);
+    int n = -1;
+    
+    if (!frame || !gs || !canvas) {
+        return n;
+    }
+    if (drawnSeq < frame->startSeq) {       // 上次显示后笔迹重新开始或已结束
+        canvas->clearRect(0, 0, (float)gs->xf().getWidth(), (float)gs->xf().getHeight());
+    }
+    if (frame->active && gs->beginPaint(canvas)) {
+        std::vector<GiInkFrame*> frames;    // 未显示的各帧，按提交顺序显示
+        
+        for (GiInkFrame* p = frame; p && p->seq > drawnSeq; p = p->prev) {
+            frames.push_back(p);
+        }
+        n = 0;
+        for (size_t i = frames.size(); i > 0; i--) {
+            n += frames[i - 1]->shapes->dyndraw(0, *gs, NULL, -1);
+        }
+        gs->endPaint();
+    }
+    
+    return n;
+}
+
+void GiCoreView::setInkLayerEnabled(bool enabled)
+{
+    if (impl->inkEnabled != enabled) {
+        impl->inkEnabled = enabled;
+        if (impl->inkFront->active) {       // 各视图在下次显示时清除笔迹层
+            long seq = impl->inkFront->seq + 1;
+            impl->submitInk(new GiInkFrame(NULL, seq, seq, false));
+        }
+    }
+}
+
 int GiCoreView::drawAll(long doc, long hGs, GiCanvas* canvas)
 {
     int n = -1;
@@ -552,6 +771,23 @@ int GiCoreView::drawAll(const mgvector<long>& docs, long hGs, GiCanvas* canvas)
     return n;
 }
 
+long GiCoreView::drawAll(long doc, long hGs, GiCanvas* canvas, long cursor, int budget)
+{
+    GiGraphics* gs = GiGraphics::fromHandle(hGs);
+    
+    if (doc && gs && gs->beginPaint(canvas)) {
+        MgShapeDoc::fromHandle(doc)->dyndraw(isZooming() ? 2 : 0, *gs, cursor, budget);
+        gs->endPaint();
+    }
+    
+    return cursor;
+}
+
+void GiCoreView::releaseDrawCursor(long cursor)
+{
+    MgShapeDoc::releaseDrawCursor(cursor);
+}
+
 int GiCoreView::drawAppend(long doc, long hGs, GiCanvas* canvas, int sid)
 {
     int n = -1;
@@ -567,6 +803,23 @@ int GiCoreView::drawAppend(long doc, long hGs, GiCanvas* canvas, int sid)
     return n;
 }
 
+int GiCoreView::drawRegion(long doc, long hGs, GiCanvas* canvas,
+                           float x, float y, float w, float h)
+{
+    int n = -1;
+    GiGraphics* gs = GiGraphics::fromHandle(hGs);
+    RECT_2D clip;
+    
+    Box2d(x, y, x + w, y + h).get(clip);
+    if (doc && gs && gs->beginPaint(canvas)) {
+        // 剪裁到局部区域，区域外的图形由 MgShapes::dyndraw 跳过
+        n = gs->setClipBox(clip) ? MgShapeDoc::fromHandle(doc)->dyndraw(isZooming() ? 2 : 0, *gs) : 0;
+        gs->endPaint();
+    }
+    
+    return n;
+}
+
 int GiCoreView::dynDraw(long hShapes, long hGs, GiCanvas* canvas)
 {
     int n = -1;
@@ -603,7 +856,8 @@ void GiCoreView::onSize(GiView* view, int w, int h)
 {
     GcBaseView* aview = impl->_gcdoc->findView(view);
     if (aview) {
-        aview->onSize(_dpi, w, h);
+        aview->onSize(impl->_dpi, w, h);
+        aview->graph()->setPenWidthFactor(impl->_factor);
     }
 }
 
@@ -675,6 +929,55 @@ bool GiCoreView::onGesture(GiView* view, GiGestureType type,
     return ret;
 }
 
+bool GiCoreView::onGestureSamples(GiView* view, GiGestureType type, GiGestureState state,
+                                  const mgvector<float>& samples, bool switchGesture)
+{
+    DrawLocker locker(impl);            // 整批点处理完后才显示
+    GcBaseView* aview = impl->_gcdoc->findView(view);
+    const int n = samples.count() / 3;
+    bool ret = false;
+    
+    if (n < 1 || !impl->setView(aview)) {
+        return false;
+    }
+    if (state <= kGiGestureBegan) {     // 不沿用上次手势的速度
+        impl->sampleCount = 0;
+        impl->motion()->velocity.set(0, 0);
+    }
+    for (int i = 0; i < n; i++) {
+        Point2d pt(samples.get(3 * i), samples.get(3 * i + 1));
+        float dt = samples.get(3 * i + 2);
+        GiGestureState st = state;
+        
+        if (state <= kGiGestureBegan && i > 0)
+            st = kGiGestureMoved;
+        if (state >= kGiGestureEnded && i + 1 < n)
+            st = kGiGestureMoved;
+        
+        // 按时间间隔估算移动速度，从第二次估算起与上次的速度平均以减小抖动
+        if (impl->sampleCount > 0 && dt > 0) {
+            Vector2d v((pt - impl->lastSample) * (1000.f / dt));
+            impl->motion()->velocity = (impl->sampleCount > 1
+                                        ? (impl->motion()->velocity + v) * 0.5f : v);
+        }
+        impl->lastSample = pt;
+        impl->sampleCount++;
+        
+        // 中间的移动点只交给需要全部点的命令，其余命令每批只处理一次
+        if (st == kGiGestureMoved && i + 1 < n) {
+            MgCommand* cmd = impl->getCommand();
+            if (impl->gestureHandler != 1 || !cmd || !cmd->isStrokeCommand())
+                continue;
+        }
+        ret = onGesture(view, type, st, pt.x, pt.y, switchGesture);
+    }
+    if (state >= kGiGestureEnded) {
+        impl->sampleCount = 0;
+    }
+    
+    return ret;
+}
+
 bool GiCoreView::twoFingersMove(GiView* view, GiGestureState state,
                                 float x1, float y1, float x2, float y2, bool switchGesture)
 {
@@ -891,7 +1194,7 @@ void GiCoreViewImpl::submitDynamicShapes(GcBaseView* v)
     MgShapes* shapes = drawing->getBackShapes(true);
     
     if (cmd) {
-        if (!cmd->gatherShapes(motion(), shapes)) {
+        if (!(inkEnabled && gatherInk(cmd, shapes)) && !cmd->gatherShapes(motion(), shapes)) {
             GiRecordCanvas canvas(shapes, v->xform(), cmd->isDrawingCommand() ? 0 : -1);
             if (v->frontGraph()->beginPaint(&canvas)) {
                 mgCopy(motion()->d2mgs, cmds()->displayMmToModel(1, v->frontGraph()));
@@ -907,6 +1210,35 @@ void GiCoreViewImpl::submitDynamicShapes(GcBaseView* v)
     }
 }
 
+bool GiCoreViewImpl::gatherInk(MgCommand* cmd, MgShapes* shapes)
+{
+    MgShapes* newInk = MgShapes::create();
+    int ret = cmd->gatherInk(motion(), newInk, shapes);
+    long seq = inkFront->seq + 1;
+    GiInkFrame* frame = NULL;
+    
+    if (ret == 2 || (!ret && inkFront->active)) {   // 重新开始笔迹或结束增量笔迹
+        frame = new GiInkFrame(NULL, seq, seq, ret != 0);
+    }
+    else if (ret && newInk->getShapeCount() > 0) {  // 接在已提交的笔迹后
+        frame = new GiInkFrame(inkFront, seq, inkFront->startSeq, true);
+    }
+    if (frame) {
+        frame->shapes->copyShapes(newInk, false, false);
+        submitInk(frame);
+    }
+    newInk->release();
+    
+    return ret != 0;
+}
+
+void GiCoreViewImpl::submitInk(GiInkFrame* frame)
+{
+    GiInkFrame* old = inkFront;
+    inkFront = frame;
+    old->release();
+}
+
 void GiCoreView::clear()
 {
     loadShapes((MgStorage*)0);
@@ -19,10 +19,29 @@
 #include "mglayer.h"
 #include "mglog.h"
 #include <map>
+#include <vector>
 
 #define CALL_VIEW(func) if (curview) curview->func
 #define CALL_VIEW2(func, v) curview ? curview->func : v
 
+class DrawLocker;
+
+//! 前端 GiGraphics 对象池的存储块，块链表只增不减，可无锁遍历
+struct GiGraphicsBlock {
+    enum { kSlots = 16 };
+    struct Slot {
+        GiGraphics*         gs;             //!< 图形显示对象，由首次占用该槽的线程创建
+        volatile long       used;           //!< 是否已被占用
+        const GiGraphics*   src;            //!< 上次复制的后端图形显示对象
+        long                srcVersion;     //!< 上次复制时来源对象的改变次数
+        long                version;        //!< 复制后本对象的改变次数
+    };
+    Slot            slots[kSlots];
+    volatile long   next;                   //!< 下一块的地址
+    
+    GiGraphicsBlock* nextBlock() const { return (GiGraphicsBlock*)next; }
+};
+
 //! 供Java等语言用的 MgShape 实现类
 class MgShapeExt : public MgShape
 {
@@ -63,11 +82,47 @@ public:
     }
 };
 
+//! 笔迹层的一帧新增笔迹，提交后不再改变，按引用计数释放
+/*! 同一笔迹的各帧按 prev 串起来，各视图记下已显示到的序号，只显示序号更大的帧。
+ */
+struct GiInkFrame {
+    volatile long   refcount;
+    GiInkFrame*     prev;           // 同一笔迹的上一帧，笔迹开始时为NULL
+    MgShapes*       shapes;         // 本帧新增的已稳定笔迹
+    long            seq;            // 本帧序号，逐帧递增
+    long            startSeq;       // 本笔迹开始的序号，已显示的序号小于它时需先清除笔迹层
+    bool            active;         // 当前命令是否使用增量笔迹
+    
+    GiInkFrame(GiInkFrame* prev_, long seq_, long startSeq_, bool active_)
+        : refcount(1), prev(prev_), shapes(MgShapes::create()), seq(seq_)
+        , startSeq(startSeq_), active(active_) {
+        if (prev) {
+            giAtomicIncrement(&prev->refcount);
+        }
+    }
+    
+    static GiInkFrame* fromHandle(long h) { GiInkFrame* p; *(long*)&p = h; return p; }
+    long toHandle() { long h; *(GiInkFrame**)&h = this; return h; }
+    
+    void addRef() { giAtomicIncrement(&refcount); }
+    
+    //! 释放本帧，不再使用的前面各帧也依次释放，以免长笔迹递归过深
+    void release() {
+        for (GiInkFrame* p = this; p && giAtomicDecrement(&p->refcount) == 0; ) {
+            GiInkFrame* prev = p->prev;
+            p->shapes->release();
+            delete p;
+            p = prev;
+        }
+    }
+};
+
 //! GiCoreView实现类
 class GiCoreViewImpl : public GiCoreViewData, public MgShapeFactory
 {
 public:
-    static float    _factor;
+    float           _factor;        // 屏幕放大系数，Android高清屏可用
+    int             _dpi;           // 屏幕分辨率，在 GiCoreView::onSize() 中应用到视图中
     GcShapeDoc*     _gcdoc;
     MgCmdManager*   _cmds;
     GcBaseView*     curview;
@@ -81,11 +136,19 @@ public:
     long            redrawPending;
     volatile long   changeCount;
     volatile long   drawCount;
+    Box2d           damageM;        // 待重新显示的区域，模型坐标，含线宽
+    GiInkFrame*     inkFront;       // 最新提交的笔迹帧，见 acquireNewInk
+    bool            inkEnabled;     // 宿主是否有笔迹层，见 setInkLayerEnabled
+    Point2d         lastSample;     // 上一个触摸采样点，显示坐标
+    int             sampleCount;    // 本次手势已传入的采样点数，用于估算移动速度
+    int             batchDepth;     // 批量修改图形的嵌套层数，见 beginBatch
+    DrawLocker*     batchLocker;    // 批量修改期间累积待显示区域
+    std::vector<int> batchIds[3];   // 批量修改中已添加、已修改、已删除的图形ID
     
     std::map<int, MgShape* (*)()>   _shapeCreators;
     
-    GiGraphics*     gsBuf[20];
-    volatile long   gsUsed[20];
+    GiGraphicsBlock gsPool;         // 前端 GiGraphics 对象池的首块
+    volatile long   gsStats[5];     // 对象池统计值，见 GiCoreView::getGraphicsStats
     volatile long   stopping;
     
 public:
@@ -94,6 +157,9 @@ public:
     
     void submitBackXform() { CALL_VIEW(submitBackXform()); }
     
+    GiGraphics* acquireGs(GcBaseView* aview);
+    bool releaseGs(GiGraphics* gs);
+    
     MgMotion* motion() { return &_motion; }
     MgCmdManager* cmds() const { return _cmds; }
     GcShapeDoc* document() const { return _gcdoc; }
@@ -139,6 +205,14 @@ public:
         return !cmds() || getCmdSubject()->onShapeCanUngroup(motion(), shape); }
     void shapeMoved(MgShape* shape, int segment) {
         getCmdSubject()->onShapeMoved(motion(), shape, segment); }
+    void shapeChanged(const MgShape* shape) {
+        regenShape(shape);
+        if (batchDepth > 0 && shape) {
+            batchIds[1].push_back(shape->getID());
+        }
+    }
+    void beginBatch();
+    void commitBatch();
     bool shapeWillChanged(MgShape* shape, const MgShape* oldsp) {
         return getCmdSubject()->onShapeWillChanged(motion(), shape, oldsp); }
     
@@ -162,12 +236,25 @@ public:
     }
     
     bool removeShape(const MgShape* shape) {
-        hideContextActions();
+        if (batchDepth == 0) {
+            hideContextActions();
+        }
         bool ret = (shape && shape->getParent()
                     && shape->getParent()->findShape(shape->getID()) == shape
                     && !shape->shapec()->getFlag(kMgShapeLocked));
         if (ret) {
             int sid = shape->getID();
+            regenShape(shape);
+            if (batchDepth > 0) {       // 批量修改时视图在 commitBatch 中统一通知
+                if (getCmdSubject()->hasObserver(kCmdEventShapeDeleted)) {
+                    getCmdSubject()->onShapeDeleted(motion(), shape);
+                }
+                ret = shape->getParent()->removeShape(sid);
+                if (ret) {
+                    batchIds[2].push_back(sid);
+                }
+                return ret;
+            }
             getCmdSubject()->onShapeDeleted(motion(), shape);
             ret = shape->getParent()->removeShape(shape->getID());
             CALL_VIEW(deviceView()->shapeDeleted(sid));
@@ -205,7 +292,14 @@ public:
     
     void shapeAdded(const MgShape* sp) {
         regenAppend(sp->getID());
-        getCmdSubject()->onShapeAdded(motion(), sp);
+        if (batchDepth > 0) {           // 逐个图形的通知照常发出，另在 commitBatch 中汇总通知
+            batchIds[0].push_back(sp->getID());
+            if (getCmdSubject()->hasObserver(kCmdEventShapeAdded)) {
+                getCmdSubject()->onShapeAdded(motion(), sp);
+            }
+        } else {
+            getCmdSubject()->onShapeAdded(motion(), sp);
+        }
     }
     
     void redraw(bool changed = true) {
@@ -250,6 +344,11 @@ public:
                 appendPending = sid;
             }
             else if (appendPending > 0 && appendPending != sid) {
+                const MgShape* sp = shapes()->findShape(sid);
+                if (sp) {
+                    regenShape(sp);     // 多个新图形时只重新显示其区域
+                    return;
+                }
                 regenAll(true);
             }
         }
@@ -264,6 +363,45 @@ public:
         }
     }
     
+    void regenShape(const MgShape* sp) {
+        if (!sp || !curview) {
+            return;
+        }
+        
+        Box2d rect(sp->shapec()->getExtent());
+        const GiContext& ctx = sp->context();
+        
+        // 与显示图形时相同，按当前视图计算半线宽的像素数，再换算为模型坐标外扩，水平线或垂直线的区域也不为空
+        float w = curview->graph()->calcPenWidth(ctx.getLineWidth(), ctx.isAutoScale());
+        w = (w + ctx.getExtraWidth()) / 2 + 2;
+        rect.inflate((Vector2d(w, 0) * xform()->displayToModel()).length());
+        regenRect(rect);
+    }
+    
+    void regenRect(const Box2d& rectM) {
+        if (regenPending >= 0) {    // 在 DrawLocker 范围内只累积，析构时统一显示
+            damageM.unionWith(rectM);
+            return;
+        }
+        
+        bool zooming = CALL_VIEW2(isZooming(), false);
+        
+        for (int i = 0; i < _gcdoc->getViewCount(); i++) {
+            GcBaseView* v = _gcdoc->getView(i);
+            if (v != curview && zooming)
+                continue;
+            
+            Box2d rect(rectM * v->xform()->modelToDisplay());
+            Box2d wnd(v->xform()->getWndRect());
+            
+            rect.inflate(1);
+            if (!rect.intersectWith(wnd).isEmpty()) {
+                v->deviceView()->regenRect(rect.xmin, rect.ymin, rect.width(), rect.height());
+            }
+        }
+        CALL_VIEW(deviceView()->contentChanged());
+    }
+    
     bool setView(GcBaseView* view) {
         if (curview != view) {
             GcBaseView* oldview = curview;
@@ -275,6 +413,8 @@ public:
     
     bool gestureToCommand();
     void submitDynamicShapes(GcBaseView* v);
+    bool gatherInk(MgCommand* cmd, MgShapes* shapes);
+    void submitInk(GiInkFrame* frame);
     
 private:
     void registerShape(int type, MgShape* (*creator)()) {
@@ -332,16 +472,23 @@ public:
         long regenPending = _impl->regenPending;
         long appendPending = _impl->appendPending;
         long redrawPending = _impl->redrawPending;
+        Box2d damageM(_impl->damageM);
         
         _impl->regenPending = -1;
         _impl->appendPending = -1;
         _impl->redrawPending = -1;
+        _impl->damageM.empty();
         
         if (regenPending > 0) {
             _impl->regenAll(regenPending >= 100);
         }
-        else if (appendPending > 0) {
-            _impl->regenAppend((int)appendPending);
+        else if (appendPending > 0 || !damageM.isEmptyMinus()) {
+            if (appendPending > 0) {
+                _impl->regenAppend((int)appendPending);
+            }
+            if (!damageM.isEmptyMinus()) {
+                _impl->regenRect(damageM);
+            }
         }
         else if (redrawPending > 0) {
             _impl->redraw(redrawPending >= 100);